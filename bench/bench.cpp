@@ -0,0 +1,31 @@
+#include "bench.h"
+
+#include <cstring>
+
+using namespace qsh::bench;
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	int repetitions = 5;
+	bool perf = false;
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-r") && i + 1 < argc)
+			repetitions = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-p"))
+			perf = true;
+		else
+			filter = argv[i];
+	}
+
+	Context ctx(QSH_TEST_DATA_DIR, repetitions, perf);
+	for(const auto& c : registry())
+	{
+		if(!filter.empty() && std::string(c.name).find(filter) == std::string::npos)
+			continue;
+		printf("%s\n", c.name);
+		c.fn(ctx);
+	}
+	return 0;
+}
@@ -0,0 +1,157 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "perf.h"
+
+namespace qsh
+{
+	namespace bench
+	{
+		class Context
+		{
+		public:
+			Context(const std::string& dataDir, int repetitions, bool perf = false) : dataDir_(dataDir),
+				repetitions_(repetitions)
+			{
+				if(perf)
+				{
+					perf_.reset(new PerfCounters());
+					if(!perf_->anyAvailable())
+					{
+						printf("perf counters unavailable (%s), reporting wall time only\n", perf_->error().c_str());
+						perf_.reset();
+					}
+					else if(!perf_->error().empty())
+					{
+						printf("some perf counters unavailable (%s)\n", perf_->error().c_str());
+					}
+				}
+			}
+
+			const std::string& dataDir() const
+			{
+				return dataDir_;
+			}
+
+			std::string sampleFile() const
+			{
+				return dataDir_ + "/OrdLog.VTBR-6.16.2016-04-26.qsh";
+			}
+
+			// Runs 'fn' several times and reports the best run. 'items' and
+			// 'bytes' are per run and are used for the rates. With perf
+			// counters enabled (-p) the counters of the best run follow on a
+			// second line, per item.
+			void measure(const std::string& name, uint64_t items, uint64_t bytes, const std::function<void()>& fn)
+			{
+				double best = 1e100;
+				PerfCounters::Values counters = {};
+				for(int i = 0; i < repetitions_; i++)
+				{
+					if(perf_)
+						perf_->start();
+					auto start = std::chrono::steady_clock::now();
+					fn();
+					auto end = std::chrono::steady_clock::now();
+					PerfCounters::Values values = {};
+					if(perf_)
+						values = perf_->stop();
+					double elapsed = std::chrono::duration<double>(end - start).count();
+					if(elapsed < best)
+					{
+						best = elapsed;
+						counters = values;
+					}
+				}
+				printf("  %-48s %10.3f ms", name.c_str(), best * 1e3);
+				if(items > 0)
+					printf(" %8.2f ns/item %8.2f Mitems/s", best * 1e9 / items, items / best / 1e6);
+				if(bytes > 0)
+					printf(" %8.1f MB/s", bytes / best / 1e6);
+				printf("\n");
+				if(perf_)
+					printCounters(counters, items);
+			}
+
+			bool perfEnabled() const
+			{
+				return perf_ != nullptr;
+			}
+
+		private:
+			void printCounters(const PerfCounters::Values& counters, uint64_t items)
+			{
+				double per = items > 0 ? items : 1;
+				printf("  %-48s", items > 0 ? "  per item:" : "  per run:");
+				for(int i = 0; i < PerfCounters::Count; i++)
+				{
+					if(counters.valid[i])
+						printf(" %s %.2f", PerfCounters::name(i), counters.value[i] / per);
+				}
+				if(counters.valid[PerfCounters::Cycles] && counters.valid[PerfCounters::Instructions] &&
+						counters.value[PerfCounters::Cycles] > 0)
+					printf(" IPC %.2f", counters.value[PerfCounters::Instructions] / counters.value[PerfCounters::Cycles]);
+				printf("\n");
+			}
+
+		private:
+			std::string dataDir_;
+			int repetitions_;
+			std::unique_ptr<PerfCounters> perf_;
+		};
+
+		struct Case
+		{
+			const char* name;
+			void (*fn)(Context&);
+		};
+
+		inline std::vector<Case>& registry()
+		{
+			static std::vector<Case> cases;
+			return cases;
+		}
+
+		struct Registrar
+		{
+			Registrar(const char* name, void (*fn)(Context&))
+			{
+				registry().push_back(Case { name, fn });
+			}
+		};
+
+		inline std::string readFile(const std::string& path)
+		{
+			std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+			if(!stream.good())
+				throw std::runtime_error("Unable to open " + path);
+			return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+		}
+
+		// Keeps the compiler from discarding a computed value
+		template <typename T>
+		inline void doNotOptimize(const T& value)
+		{
+			asm volatile("" : : "r,m"(value) : "memory");
+		}
+	}
+}
+
+#define QSH_BENCHMARK(name) \
+	static void name(qsh::bench::Context& ctx); \
+	static qsh::bench::Registrar name##_registrar(#name, name); \
+	static void name(qsh::bench::Context& ctx)
+
+#endif /* ifndef BENCH_H */
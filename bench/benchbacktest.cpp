@@ -0,0 +1,92 @@
+#include "bench.h"
+
+#include "qsh/backtest.h"
+#include "qsh/qshfile.h"
+
+#include <sstream>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	// One lot at the best bid and ask, requoted at the end of every
+	// transaction in which it was filled or the best price moved
+	class QuotingStrategy
+	{
+	public:
+		explicit QuotingStrategy(MatchingSimulator& simulator) : simulator_(simulator)
+		{
+			quotes_[0] = quotes_[1] = UINT64_MAX;
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			simulator_.orderLogFrame(entry);
+			if(!(entry.flags & OrderLogEntry::EndOfTransaction))
+				return;
+			const L3Book& book = simulator_.book();
+			for(auto side : { book::Bid, book::Ask })
+			{
+				uint64_t& quote = quotes_[side];
+				bool working = quote != UINT64_MAX && simulator_.order(quote).status == backtest::Status::Working;
+				if(book.empty(side) || (working && simulator_.order(quote).price == book.best(side)))
+					continue;
+				if(working)
+					simulator_.cancel(quote);
+				quote = simulator_.submit(side, book.best(side), 1);
+			}
+		}
+
+	private:
+		MatchingSimulator& simulator_;
+		uint64_t quotes_[2];
+	};
+}
+
+// The simulator must keep up with decoding: idle it costs the book, and
+// quoting both sides adds the virtual order bookkeeping
+QSH_BENCHMARK(matchingSimulator)
+{
+	std::string data = readFile(ctx.sampleFile());
+	uint64_t frames = 0;
+	{
+		std::istringstream stream(data);
+		L3Book book(1);
+		QshFile<L3Book> file(stream, book);
+		while(stream.peek() != std::char_traits<char>::eof())
+		{
+			file.readOneFrame();
+			frames++;
+		}
+	}
+
+	ctx.measure("full decode + L3Book", frames, data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				L3Book book(1);
+				QshFile<L3Book> file(stream, book);
+				file.readAllFrames();
+				doNotOptimize(book.orders());
+			});
+	ctx.measure("full decode + simulator, idle", frames, data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				MatchingSimulator simulator(1);
+				QshFile<MatchingSimulator> file(stream, simulator);
+				file.readAllFrames();
+				doNotOptimize(simulator.book().orders());
+			});
+	size_t fills = 0;
+	ctx.measure("full decode + simulator, quoting", frames, data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				MatchingSimulator simulator(1);
+				QuotingStrategy strategy(simulator);
+				QshFile<QuotingStrategy> file(stream, strategy);
+				file.readAllFrames();
+				fills = simulator.fills().size();
+				doNotOptimize(fills);
+			});
+	printf("  %zu virtual fills\n", fills);
+}
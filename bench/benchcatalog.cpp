@@ -0,0 +1,94 @@
+#include "bench.h"
+
+#include "qsh/qshfile.h"
+#include "qsh/synthetic.h"
+
+#include <sstream>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class NullSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			checksum += entry.orderId;
+		}
+
+		uint64_t checksum = 0;
+	};
+
+	// Reads a string in place, so the streams cost nothing per file
+	class MemoryBuffer : public std::streambuf
+	{
+	public:
+		void reset(const std::string& data)
+		{
+			char* begin = const_cast<char*>(data.data());
+			setg(begin, begin, begin + data.size());
+		}
+	};
+}
+
+// A catalog of small files with 1 to 4 streams, scanned for their headers:
+// a new QshFile per file against one instance reopened with open(). Items
+// are files.
+QSH_BENCHMARK(catalog)
+{
+	std::vector<std::string> files;
+	uint64_t bytes = 0;
+	for(int i = 0; i < 4000; i++)
+	{
+		std::ostringstream out;
+		testing::SyntheticOrdLog generator(i + 1, 1 + i % 4);
+		generator.write(out, 16);
+		files.push_back(out.str());
+		bytes += files.back().size();
+	}
+
+	MemoryBuffer buffer;
+	std::istream stream(&buffer);
+	NullSink sink;
+	ctx.measure("new instance", files.size(), bytes, [&]()
+			{
+				size_t streams = 0;
+				for(const auto& file : files)
+				{
+					buffer.reset(file);
+					stream.clear();
+					QshFile<NullSink> qsh(stream, sink);
+					streams += qsh.getMetadata().streamsNumber;
+				}
+				doNotOptimize(streams);
+			});
+
+	buffer.reset(files.front());
+	QshFile<NullSink> qsh(stream, sink);
+	ctx.measure("open()", files.size(), bytes, [&]()
+			{
+				size_t streams = 0;
+				for(const auto& file : files)
+				{
+					buffer.reset(file);
+					stream.clear();
+					qsh.open(stream);
+					streams += qsh.getMetadata().streamsNumber;
+				}
+				doNotOptimize(streams);
+			});
+
+	ctx.measure("open() and decode", files.size(), bytes, [&]()
+			{
+				for(const auto& file : files)
+				{
+					buffer.reset(file);
+					stream.clear();
+					qsh.open(stream);
+					qsh.readAllFrames();
+				}
+				doNotOptimize(sink.checksum);
+			});
+}
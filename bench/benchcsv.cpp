@@ -0,0 +1,127 @@
+#include "bench.h"
+
+#include "qsh/csv.h"
+#include "qsh/qshfile.h"
+
+#include <ctime>
+#include <sstream>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class Collector
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			entries.push_back(entry);
+		}
+
+		std::vector<OrderLogEntry> entries;
+	};
+
+	// Discards the text, counting it
+	class NullBuffer : public std::streambuf
+	{
+	public:
+		uint64_t bytes = 0;
+
+	protected:
+		std::streamsize xsputn(const char*, std::streamsize count) override
+		{
+			bytes += count;
+			return count;
+		}
+
+		int overflow(int c) override
+		{
+			bytes++;
+			return c;
+		}
+	};
+
+	// The formatting of the tests' Sink::entryToString
+	std::string formatTimestamp(datetime_t timestamp)
+	{
+		auto tp = helpers::convertGrowDatetimeToTimePoint(timestamp);
+		struct tm* t = gmtime(&tp.first);
+		char buffer[64];
+		sprintf(buffer, "%02d.%02d.%04d %02d:%02d:%02d.%03d,", t->tm_mday, t->tm_mon + 1, t->tm_year + 1900,
+				t->tm_hour, t->tm_min, t->tm_sec, tp.second / 1000);
+		return buffer;
+	}
+
+	std::string formatEntry(const OrderLogEntry& entry)
+	{
+		std::string result = formatTimestamp(entry.frameTimestamp) + formatTimestamp(entry.timestamp);
+		result += std::to_string(entry.streamNumber) + ",";
+		result += std::to_string(entry.flags) + ",";
+		result += std::to_string(entry.orderId) + ",";
+		result += std::to_string(entry.orderPrice.toDouble()) + ",";
+		result += std::to_string(entry.volume) + ",";
+		result += std::to_string(entry.remain) + ",";
+		result += std::to_string(entry.matchingOrderId) + ",";
+		result += std::to_string(entry.tradePrice.toDouble()) + ",";
+		result += std::to_string(entry.openInterest) + "\n";
+		return result;
+	}
+}
+
+// Text throughput: bytes/s counts the text written, not the input
+QSH_BENCHMARK(csvExport)
+{
+	std::string data = readFile(ctx.sampleFile());
+	Collector collector;
+	{
+		std::istringstream stream(data);
+		QshFile<Collector> file(stream, collector);
+		file.readAllFrames();
+	}
+	const auto& entries = collector.entries;
+
+	uint64_t textSize = 0;
+	{
+		NullBuffer buffer;
+		std::ostream output(&buffer);
+		CsvExporter exporter(output);
+		for(const auto& entry : entries)
+			exporter.orderLogFrame(entry);
+		exporter.flush();
+		textSize = exporter.bytes();
+	}
+
+	ctx.measure("gmtime + sprintf + to_string", entries.size(), textSize, [&]()
+			{
+				NullBuffer buffer;
+				std::ostream output(&buffer);
+				for(const auto& entry : entries)
+				{
+					std::string line = formatEntry(entry);
+					output.write(line.data(), line.size());
+				}
+				doNotOptimize(buffer.bytes);
+			});
+	ctx.measure("CsvExporter", entries.size(), textSize, [&]()
+			{
+				NullBuffer buffer;
+				std::ostream output(&buffer);
+				CsvExporter exporter(output);
+				for(const auto& entry : entries)
+					exporter.orderLogFrame(entry);
+				exporter.flush();
+				doNotOptimize(buffer.bytes);
+			});
+	ctx.measure("full decode + CsvExporter", entries.size(), textSize, [&]()
+			{
+				NullBuffer buffer;
+				std::ostream output(&buffer);
+				CsvExporter exporter(output);
+				std::istringstream stream(data);
+				QshFile<CsvExporter> file(stream, exporter);
+				file.readAllFrames();
+				exporter.flush();
+				doNotOptimize(buffer.bytes);
+			});
+}
@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#include "qsh/datetime.h"
+
+#include <ctime>
+#include <random>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+// A day of exchange timestamps, a few per millisecond
+QSH_BENCHMARK(datetime)
+{
+	const size_t count = 1 << 20;
+	std::vector<datetime_t> timestamps(count);
+	std::mt19937_64 rng(1);
+	datetime_t timestamp = (TimeDeltaInSeconds + 1461628800ll) * 1000;
+	for(auto& value : timestamps)
+	{
+		timestamp += rng() % 80;
+		value = timestamp;
+	}
+	std::vector<int64_t> nanos(count);
+
+	ctx.measure("convertGrowDatetimeToTimePoint + gmtime_r", count, 0, [&]()
+			{
+				int64_t sum = 0;
+				for(auto value : timestamps)
+				{
+					auto tp = helpers::convertGrowDatetimeToTimePoint(value);
+					struct tm t;
+					gmtime_r(&tp.first, &t);
+					sum += t.tm_hour + t.tm_min + t.tm_sec + t.tm_mday;
+				}
+				doNotOptimize(sum);
+			});
+	ctx.measure("CalendarCache", count, 0, [&]()
+			{
+				CalendarCache cache;
+				int64_t sum = 0;
+				for(auto value : timestamps)
+				{
+					const Calendar& calendar = cache.fromGrowDatetime(value);
+					sum += calendar.hour + calendar.minute + calendar.second + calendar.day;
+				}
+				doNotOptimize(sum);
+			});
+	ctx.measure("epoch nanos, scalar", count, count * 8, [&]()
+			{
+				helpers::batch::affineScalar(timestamps.data(), nanos.data(), count, helpers::GrowNanos,
+						helpers::EpochOffsetNanos);
+				doNotOptimize(nanos[count - 1]);
+			});
+#ifdef QSH_SIMD_X86
+	if(simd::hasAvx2())
+	{
+		ctx.measure("epoch nanos, AVX2", count, count * 8, [&]()
+				{
+					helpers::batch::affineAvx2(timestamps.data(), nanos.data(), count, helpers::GrowNanos,
+							helpers::EpochOffsetNanos);
+					doNotOptimize(nanos[count - 1]);
+				});
+	}
+#endif
+}
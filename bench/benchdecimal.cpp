@@ -0,0 +1,154 @@
+#include "bench.h"
+
+#include "qsh/decimal.h"
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	// Columns of 16K rows stay in L2, as a batch handed to a sink would; each
+	// measurement makes 64 passes
+	const size_t Rows = 1 << 14;
+	const size_t Passes = 64;
+
+	template<typename Kernel>
+	std::function<void()> passes(Kernel kernel)
+	{
+		return [kernel]()
+		{
+			for(size_t pass = 0; pass < Passes; pass++)
+				kernel();
+		};
+	}
+}
+
+// Ticks around 100000, decimal prices with 5 digits
+QSH_BENCHMARK(decimalKernels)
+{
+	std::mt19937_64 rng(2);
+	std::vector<int64_t> bids(Rows), asks(Rows);
+	std::vector<decimal_fixed> prices(Rows);
+	int64_t price = 100000;
+	for(size_t i = 0; i < Rows; i++)
+	{
+		price += (int64_t)(rng() % 5) - 2;
+		bids[i] = price;
+		asks[i] = price + 1 + rng() % 3;
+		prices[i] = decimal_fixed(price / 100000, (price % 100000) * 10000);
+	}
+	std::vector<int8_t> signs(Rows);
+	std::vector<int64_t> nanos(Rows);
+	const size_t items = Rows * Passes;
+
+	ctx.measure("sum, scalar", items, items * 8, passes([&]() { doNotOptimize(decimal::sumScalar(bids.data(), Rows)); }));
+	ctx.measure("min + max, scalar", items, items * 8, passes([&]()
+			{
+				doNotOptimize(decimal::minScalar(bids.data(), Rows));
+				doNotOptimize(decimal::maxScalar(bids.data(), Rows));
+			}));
+	ctx.measure("compare, scalar", items, items * 16, passes([&]()
+			{
+				decimal::compareScalar(bids.data(), asks.data(), signs.data(), Rows);
+				doNotOptimize(signs[Rows - 1]);
+			}));
+	ctx.measure("decimal_fixed sum, toDouble", items, items * 16, passes([&]()
+			{
+				double total = 0;
+				for(const auto& value : prices)
+					total += value.toDouble();
+				doNotOptimize(total);
+			}));
+	ctx.measure("decimal_fixed sum, scalar", items, items * 16, passes([&]()
+			{
+				doNotOptimize(decimal::sumScalar(prices.data(), Rows).value);
+			}));
+	ctx.measure("decimal_fixed toNanos, scalar", items, items * 16, passes([&]()
+			{
+				decimal::toNanosScalar(prices.data(), nanos.data(), Rows);
+				doNotOptimize(nanos[Rows - 1]);
+			}));
+	ctx.measure("mid price, double", items, items * 16, passes([&]()
+			{
+				double total = 0;
+				for(size_t i = 1; i < Rows; i++)
+					total += (prices[i - 1].toDouble() + prices[i].toDouble()) / 2;
+				doNotOptimize(total);
+			}));
+	ctx.measure("mid price, exact", items, items * 16, passes([&]()
+			{
+				decimal_fixed total;
+				for(size_t i = 1; i < Rows; i++)
+					total += (prices[i - 1] + prices[i]).mulDiv(1, 2, Rounding::HalfEven);
+				doNotOptimize(total.value);
+			}));
+#ifdef QSH_SIMD_X86
+	if(simd::hasAvx2())
+	{
+		ctx.measure("sum, AVX2", items, items * 8, passes([&]() { doNotOptimize(decimal::sumAvx2(bids.data(), Rows)); }));
+		ctx.measure("min + max, AVX2", items, items * 8, passes([&]()
+				{
+					doNotOptimize(decimal::extremeAvx2<false>(bids.data(), Rows));
+					doNotOptimize(decimal::extremeAvx2<true>(bids.data(), Rows));
+				}));
+		ctx.measure("compare, AVX2", items, items * 16, passes([&]()
+				{
+					decimal::compareAvx2(bids.data(), asks.data(), signs.data(), Rows);
+					doNotOptimize(signs[Rows - 1]);
+				}));
+		ctx.measure("decimal_fixed sum, AVX2", items, items * 16, passes([&]()
+				{
+					doNotOptimize(decimal::sumAvx2(prices.data(), Rows).value);
+				}));
+		ctx.measure("decimal_fixed toNanos, AVX2", items, items * 16, passes([&]()
+				{
+					decimal::toNanosAvx2(prices.data(), nanos.data(), Rows);
+					doNotOptimize(nanos[Rows - 1]);
+				}));
+	}
+#endif
+}
+
+// 1M prices of 5 digits around 1.0, sorted and deduplicated as either type
+QSH_BENCHMARK(fixedPoint)
+{
+	const size_t count = 1 << 20;
+	std::mt19937_64 rng(3);
+	std::vector<decimal_fixed> prices(count);
+	for(auto& price : prices)
+	{
+		int64_t ticks = 100000 + (int64_t)(rng() % 20000) - 10000;
+		price = decimal_fixed(ticks / 100000, (ticks % 100000) * 10000);
+	}
+	std::vector<fixed_nanos> compact(count);
+	for(size_t i = 0; i < count; i++)
+		compact[i] = fixed_nanos(prices[i]);
+
+	ctx.measure("sort decimal_fixed", count, count * sizeof(decimal_fixed), [&]()
+			{
+				auto copy = prices;
+				std::sort(copy.begin(), copy.end());
+				doNotOptimize(copy[count / 2].value);
+			});
+	ctx.measure("sort fixed_nanos", count, count * sizeof(fixed_nanos), [&]()
+			{
+				auto copy = compact;
+				std::sort(copy.begin(), copy.end());
+				doNotOptimize(copy[count / 2].raw);
+			});
+	ctx.measure("unordered_set<fixed_nanos>", count, count * sizeof(fixed_nanos), [&]()
+			{
+				std::unordered_set<fixed_nanos> set(compact.begin(), compact.end());
+				doNotOptimize(set.size());
+			});
+	ctx.measure("decimal_fixed -> fixed_nanos", count, count * sizeof(decimal_fixed), [&]()
+			{
+				for(size_t i = 0; i < count; i++)
+					compact[i] = fixed_nanos(prices[i]);
+				doNotOptimize(compact[count - 1].raw);
+			});
+}
@@ -0,0 +1,179 @@
+#include "bench.h"
+
+#include "qsh/book.h"
+#include "qsh/qshfile.h"
+
+#include <map>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class NullSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			checksum += entry.orderId;
+		}
+
+		uint64_t checksum = 0;
+	};
+
+	// A plain order book on standard containers, for comparison with
+	// L3Book
+	class BookSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			if(entry.flags & (OrderLogEntry::NonZeroReplAct | OrderLogEntry::Counter))
+				return;
+			int64_t price = entry.orderPrice.toNanos();
+			auto& levels = (entry.flags & OrderLogEntry::Buy) ? bids : asks;
+			if(entry.flags & OrderLogEntry::Add)
+			{
+				if(!(entry.flags & OrderLogEntry::Quote))
+					return;
+				orders[entry.orderId] = Order { price, entry.volume };
+				levels[price] += entry.volume;
+				return;
+			}
+
+			auto it = orders.find(entry.orderId);
+			if(it == orders.end())
+				return;
+			int64_t volume = std::min<int64_t>(entry.volume, it->second.volume);
+			it->second.volume -= volume;
+			auto level = levels.find(it->second.price);
+			if(level != levels.end() && (level->second -= volume) <= 0)
+				levels.erase(level);
+			if(it->second.volume <= 0)
+				orders.erase(it);
+		}
+
+		struct Order
+		{
+			int64_t price;
+			int64_t volume;
+		};
+
+		std::unordered_map<int64_t, Order> orders;
+		std::map<int64_t, int64_t> bids;
+		std::map<int64_t, int64_t> asks;
+	};
+
+	std::string varints(size_t count, bool growing)
+	{
+		// Mostly one and two byte values, as in real order logs
+		std::mt19937_64 rng(1);
+		std::geometric_distribution<int64_t> magnitude(0.02);
+		std::ostringstream out;
+		for(size_t i = 0; i < count; i++)
+		{
+			int64_t value = magnitude(rng);
+			if(growing)
+				helpers::writeGrowing(out, value);
+			else
+				helpers::writeLeb128(out, (rng() & 1) ? value : -value);
+		}
+		return out.str();
+	}
+}
+
+// The decoder layer by layer, for use with -p
+QSH_BENCHMARK(hotPaths)
+{
+	const size_t count = 1000000;
+	std::string leb = varints(count, false);
+	std::string growing = varints(count, true);
+
+	ctx.measure("readLeb128", count, leb.size(), [&]()
+			{
+				std::istringstream stream(leb);
+				int64_t sum = 0;
+				for(size_t i = 0; i < count; i++)
+					sum += helpers::readLeb128(stream);
+				doNotOptimize(sum);
+			});
+	ctx.measure("readGrowing", count, growing.size(), [&]()
+			{
+				std::istringstream stream(growing);
+				int64_t sum = 0;
+				for(size_t i = 0; i < count; i++)
+					sum += helpers::readGrowing(stream);
+				doNotOptimize(sum);
+			});
+
+	std::string data = readFile(ctx.sampleFile());
+	uint64_t frames = 0;
+	size_t headerSize = 0;
+	{
+		std::istringstream stream(data);
+		NullSink sink;
+		QshFile<NullSink> file(stream, sink);
+		headerSize = stream.tellg();
+		while(stream.peek() != std::char_traits<char>::eof())
+		{
+			file.readOneFrame();
+			frames++;
+		}
+	}
+
+	// Parts decoding alone: no entry is built, no sink is called
+	ctx.measure("decodePartsTable", frames, data.size() - headerSize, [&]()
+			{
+				std::istringstream stream(data);
+				stream.seekg(headerSize);
+				OrdLogState state = {};
+				while(stream.peek() != std::char_traits<char>::eof())
+				{
+					helpers::readGrowing(stream);
+					int parts = stream.get();
+					uint16_t flags = stream.get();
+					flags |= ((uint16_t)stream.get() << 8);
+					ordlog::decodePartsTable(stream, parts, flags, state);
+				}
+				doNotOptimize(state);
+			});
+	ctx.measure("parseOrdLogEntry", frames, data.size() - headerSize, [&]()
+			{
+				std::istringstream stream(data);
+				NullSink sink;
+				QshFile<NullSink> file(stream, sink);
+				while(stream.peek() != std::char_traits<char>::eof())
+				{
+					helpers::readGrowing(stream);
+					file.parseOrdLogEntry(0);
+				}
+				doNotOptimize(sink.checksum);
+			});
+	ctx.measure("full decode", frames, data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				NullSink sink;
+				QshFile<NullSink> file(stream, sink);
+				file.readAllFrames();
+				doNotOptimize(sink.checksum);
+			});
+	ctx.measure("full decode + book sink", frames, data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				BookSink sink;
+				QshFile<BookSink> file(stream, sink);
+				file.readAllFrames();
+				doNotOptimize(sink.orders.size());
+			});
+	ctx.measure("full decode + L3Book", frames, data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				L3Book book(1);
+				QshFile<L3Book> file(stream, book);
+				file.readAllFrames();
+				doNotOptimize(book.orders());
+			});
+}
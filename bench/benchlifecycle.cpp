@@ -0,0 +1,72 @@
+#include "bench.h"
+
+#include "qsh/lifecycle.h"
+#include "qsh/qshfile.h"
+
+#include <sstream>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class Collector
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			entries.push_back(entry);
+		}
+
+		std::vector<OrderLogEntry> entries;
+	};
+
+	class NullSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			checksum += entry.orderId;
+		}
+
+		uint64_t checksum = 0;
+	};
+}
+
+// The tracker should cost a fraction of decoding: one id lookup per entry
+// and a row per finished order
+QSH_BENCHMARK(lifecycle)
+{
+	std::string data = readFile(ctx.sampleFile());
+	Collector collector;
+	{
+		std::istringstream stream(data);
+		QshFile<Collector> file(stream, collector);
+		file.readAllFrames();
+	}
+	const auto& entries = collector.entries;
+
+	ctx.measure("LifecycleTracker", entries.size(), 0, [&]()
+			{
+				LifecycleTracker tracker;
+				for(const auto& entry : entries)
+					tracker.orderLogFrame(entry);
+				doNotOptimize(tracker.completed().size());
+			});
+	ctx.measure("full decode", entries.size(), data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				NullSink sink;
+				QshFile<NullSink> file(stream, sink);
+				file.readAllFrames();
+				doNotOptimize(sink.checksum);
+			});
+	ctx.measure("full decode + LifecycleTracker", entries.size(), data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				LifecycleTracker tracker;
+				QshFile<LifecycleTracker> file(stream, tracker);
+				file.readAllFrames();
+				doNotOptimize(tracker.completed().size());
+			});
+}
@@ -0,0 +1,110 @@
+#include "bench.h"
+
+#include "qsh/qshfile.h"
+#include "qsh/synthetic.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class CountingSink
+	{
+	public:
+		template <typename Entry>
+		void orderLogFrame(const Entry& entry)
+		{
+			count++;
+			checksum += entry.orderId ^ entry.volume;
+		}
+
+		uint64_t count = 0;
+		uint64_t checksum = 0;
+	};
+
+	std::array<uint64_t, ordlog::PartsKeys> partsHistogram(const std::string& data)
+	{
+		std::array<uint64_t, ordlog::PartsKeys> histogram = {};
+		std::istringstream stream(data);
+		CountingSink sink;
+		QshFile<CountingSink> file(stream, sink);
+		size_t streams = file.streams().size();
+		std::vector<OrdLogState> states(streams, OrdLogState());
+
+		while(stream.peek() != std::char_traits<char>::eof())
+		{
+			helpers::readGrowing(stream);
+			int streamNumber = (streams > 1) ? stream.get() : 0;
+			int parts = stream.get();
+			uint16_t flags = stream.get();
+			flags |= ((uint16_t)stream.get() << 8);
+			histogram[ordlog::partsKey(parts, flags)]++;
+			ordlog::decodePartsSequential(stream, parts, flags, states[streamNumber]);
+		}
+		return histogram;
+	}
+
+	void printHistogram(const std::array<uint64_t, ordlog::PartsKeys>& histogram)
+	{
+		uint64_t total = 0;
+		std::vector<std::pair<uint64_t, unsigned>> patterns;
+		for(unsigned key = 0; key < histogram.size(); key++)
+		{
+			total += histogram[key];
+			if(histogram[key] > 0)
+				patterns.emplace_back(histogram[key], key);
+		}
+		std::sort(patterns.rbegin(), patterns.rend());
+
+		printf("  %zu distinct parts patterns in %lu frames\n", patterns.size(), (unsigned long)total);
+		uint64_t cumulative = 0;
+		for(size_t i = 0; i < patterns.size() && i < 10; i++)
+		{
+			cumulative += patterns[i].first;
+			printf("    parts 0x%02x%s %10lu %6.2f%% (cumulative %6.2f%%)\n", patterns[i].second & 0xff,
+					(patterns[i].second & 0x100) ? " +Add" : "     ",
+					(unsigned long)patterns[i].first, 100.0 * patterns[i].first / total, 100.0 * cumulative / total);
+		}
+	}
+
+	void decode(Context& ctx, const std::string& label, const std::string& data)
+	{
+		printf(" %s (%zu bytes)\n", label.c_str(), data.size());
+		auto histogram = partsHistogram(data);
+		printHistogram(histogram);
+
+		uint64_t frames = 0;
+		for(auto count : histogram)
+			frames += count;
+		for(auto decoding : { ordlog::PartsDecoding::Sequential, ordlog::PartsDecoding::Table })
+		{
+			ctx.measure(decoding == ordlog::PartsDecoding::Table ? "table" : "sequential", frames, data.size(), [&]()
+					{
+						std::istringstream stream(data);
+						CountingSink sink;
+						QshFile<CountingSink> file(stream, sink);
+						file.setPartsDecoding(decoding);
+						file.readAllFrames();
+						doNotOptimize(sink.checksum);
+					});
+		}
+	}
+
+	std::string synthetic(uint64_t seed, int streams, bool randomParts, size_t frames)
+	{
+		std::ostringstream out;
+		testing::SyntheticOrdLog generator(seed, streams, randomParts);
+		generator.write(out, frames);
+		return out.str();
+	}
+}
+
+QSH_BENCHMARK(partsDecoding)
+{
+	decode(ctx, "VTBR sample", readFile(ctx.sampleFile()));
+	decode(ctx, "synthetic market, 4 streams", synthetic(1, 4, false, 1000000));
+	decode(ctx, "synthetic random parts", synthetic(2, 1, true, 1000000));
+}
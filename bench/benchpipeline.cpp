@@ -0,0 +1,69 @@
+#include "bench.h"
+
+#include "qsh/pipeline.h"
+#include "qsh/synthetic.h"
+
+#include <sstream>
+#include <thread>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	// Stands in for a book plus feature computation
+	class HeavySink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			uint64_t value = entry.orderId;
+			for(int i = 0; i < 40; i++)
+				value = value * 6364136223846793005ull + entry.volume;
+			checksum += value;
+		}
+
+		uint64_t checksum = 0;
+	};
+}
+
+QSH_BENCHMARK(pipelinedDecode)
+{
+	std::ostringstream out;
+	testing::SyntheticOrdLog generator(4, 1);
+	generator.write(out, 1000000);
+	const std::string data = out.str();
+	printf(" %u hardware threads\n", std::thread::hardware_concurrency());
+
+	ctx.measure("serial", 1000000, data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				HeavySink sink;
+				QshFile<HeavySink> file(stream, sink);
+				file.readAllFrames();
+				doNotOptimize(sink.checksum);
+			});
+
+	const struct
+	{
+		const char* name;
+		Backpressure backpressure;
+	} modes[] = {
+		{ "pipelined spin", Backpressure::Spin },
+		{ "pipelined yield", Backpressure::Yield },
+		{ "pipelined block", Backpressure::Block },
+	};
+	for(const auto& mode : modes)
+	{
+		if(mode.backpressure == Backpressure::Spin && std::thread::hardware_concurrency() < 2)
+			continue;
+		ctx.measure(mode.name, 1000000, data.size(), [&]()
+				{
+					std::istringstream stream(data);
+					HeavySink sink;
+					PipelinedReader<HeavySink> reader(stream, sink, mode.backpressure);
+					reader.readAllFrames();
+					doNotOptimize(sink.checksum);
+				});
+	}
+}
@@ -0,0 +1,116 @@
+#include "bench.h"
+
+#include "qsh/qshfile.h"
+#include "qsh/readahead.h"
+#include "qsh/synthetic.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class CountingSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			count++;
+			checksum += entry.orderId ^ entry.volume;
+		}
+
+		uint64_t count = 0;
+		uint64_t checksum = 0;
+	};
+
+	// Asks the kernel to drop the file from the page cache. Only clean pages
+	// are dropped, which is all of them for a file we only read.
+	void dropCache(const std::string& path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd >= 0)
+		{
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			::close(fd);
+		}
+	}
+
+	uint64_t decode(std::streambuf* buffer)
+	{
+		std::istream stream(buffer);
+		CountingSink sink;
+		QshFile<CountingSink> file(stream, sink);
+		file.readAllFrames();
+		doNotOptimize(sink.checksum);
+		return sink.count;
+	}
+
+	void compare(Context& ctx, const std::string& path, bool cold)
+	{
+		uint64_t frames;
+		uint64_t bytes;
+		{
+			std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+			frames = decode(stream.rdbuf());
+			std::ifstream size(path, std::ios_base::binary | std::ios_base::ate);
+			bytes = size.tellg();
+		}
+		printf(" %s, %s cache\n", path.c_str(), cold ? "cold" : "warm");
+
+		auto run = [&](const std::string& name, const std::function<void()>& fn)
+		{
+			ctx.measure(name, frames, bytes, [&]()
+					{
+						if(cold)
+							dropCache(path);
+						fn();
+					});
+		};
+
+		run("ifstream", [&]()
+				{
+					std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+					decode(stream.rdbuf());
+				});
+		run("mmap", [&]()
+				{
+					MmapStreambuf buffer(path);
+					decode(&buffer);
+				});
+		for(auto backend : { ReadAheadStreambuf::Backend::IoUring, ReadAheadStreambuf::Backend::Thread })
+		{
+			std::unique_ptr<ReadAheadStreambuf> probe;
+			try
+			{
+				probe.reset(new ReadAheadStreambuf(path, 1 << 20, 8, backend));
+			}
+			catch(const std::runtime_error& e)
+			{
+				printf("  read-ahead backend unavailable: %s\n", e.what());
+				continue;
+			}
+			run(std::string("read-ahead ") + probe->backendName() + " 8 x 1 MiB", [&]()
+					{
+						ReadAheadStreambuf buffer(path, 1 << 20, 8, backend);
+						decode(&buffer);
+					});
+		}
+	}
+}
+
+QSH_BENCHMARK(readAhead)
+{
+	const std::string path = "/tmp/libqsh-bench-readahead.qsh";
+	{
+		std::ofstream out(path, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+		testing::SyntheticOrdLog generator(3, 4);
+		generator.write(out, 3000000);
+	}
+
+	compare(ctx, path, true);
+	compare(ctx, path, false);
+	std::remove(path.c_str());
+}
@@ -0,0 +1,68 @@
+#include "bench.h"
+
+#include "qsh/qshfile.h"
+#include "qsh/stats.h"
+
+#include <sstream>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class CountingSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			count++;
+			checksum += entry.orderId ^ entry.volume;
+		}
+
+		uint64_t count = 0;
+		uint64_t checksum = 0;
+	};
+
+	template <typename Stats>
+	uint64_t decode(const std::string& data)
+	{
+		std::istringstream stream(data);
+		CountingSink sink;
+		QshFile<CountingSink, Stats> file(stream, sink);
+		file.readAllFrames();
+		doNotOptimize(sink.checksum);
+		return sink.count;
+	}
+
+	void printSnapshot(const DecoderStats::Snapshot& snapshot)
+	{
+		printf("  %lu frames, %lu bytes, %.0f events/s, sink share %.1f%%\n",
+				(unsigned long)snapshot.totalFrames(), (unsigned long)snapshot.totalBytes(),
+				snapshot.eventsPerSecond(), 100.0 * snapshot.sinkShare());
+		printf("  varint sizes:");
+		for(size_t i = 1; i < snapshot.varintSize.size(); i++)
+		{
+			if(snapshot.varintSize[i])
+				printf(" %zu:%lu", i, (unsigned long)snapshot.varintSize[i]);
+		}
+		printf("\n");
+	}
+}
+
+// Overhead of the counters; "none" must match plain decoding
+QSH_BENCHMARK(decoderStats)
+{
+	std::string data = readFile(ctx.sampleFile());
+	uint64_t frames = decode<NoStats>(data);
+
+	{
+		std::istringstream stream(data);
+		CountingSink sink;
+		QshFile<CountingSink, DecoderStats> file(stream, sink);
+		file.readAllFrames();
+		printSnapshot(file.stats().snapshot());
+	}
+
+	ctx.measure("none", frames, data.size(), [&]() { decode<NoStats>(data); });
+	ctx.measure("counters", frames, data.size(), [&]() { decode<DecoderStats>(data); });
+}
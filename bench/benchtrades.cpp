@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include "qsh/trades.h"
+#include "qsh/qshfile.h"
+
+#include <sstream>
+#include <unordered_map>
+
+using namespace qsh;
+using namespace qsh::bench;
+
+namespace
+{
+	class Collector
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			entries.push_back(entry);
+		}
+
+		std::vector<OrderLogEntry> entries;
+	};
+
+	class Tape
+	{
+	public:
+		void dealFrame(const Deal& deal)
+		{
+			checksum += deal.id + deal.type;
+		}
+
+		uint64_t checksum = 0;
+	};
+}
+
+// Items are order log entries; the sample day has about 9000 trades
+QSH_BENCHMARK(tradeReconstruction)
+{
+	std::string data = readFile(ctx.sampleFile());
+	Collector collector;
+	{
+		std::istringstream stream(data);
+		QshFile<Collector> file(stream, collector);
+		file.readAllFrames();
+	}
+	const auto& entries = collector.entries;
+
+	ctx.measure("group by trade id afterwards", entries.size(), 0, [&]()
+			{
+				std::unordered_map<long long, std::vector<OrderLogEntry>> byTrade;
+				for(const auto& entry : entries)
+				{
+					if(entry.flags & OrderLogEntry::Fill)
+						byTrade[entry.matchingOrderId].push_back(entry);
+				}
+				Tape tape;
+				for(const auto& trade : byTrade)
+				{
+					Deal deal = {};
+					deal.id = trade.first;
+					deal.type = (trade.second[0].flags & OrderLogEntry::Buy) ? Deal::Buy : Deal::Sell;
+					tape.dealFrame(deal);
+				}
+				doNotOptimize(tape.checksum);
+			});
+	ctx.measure("TradeReconstructor", entries.size(), 0, [&]()
+			{
+				Tape tape;
+				TradeReconstructor<Tape> trades(tape);
+				for(const auto& entry : entries)
+					trades.orderLogFrame(entry);
+				doNotOptimize(tape.checksum);
+			});
+	ctx.measure("full decode + TradeReconstructor", entries.size(), data.size(), [&]()
+			{
+				std::istringstream stream(data);
+				Tape tape;
+				TradeReconstructor<Tape> trades(tape);
+				QshFile<TradeReconstructor<Tape>> file(stream, trades);
+				file.readAllFrames();
+				doNotOptimize(tape.checksum);
+			});
+}
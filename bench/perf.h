@@ -0,0 +1,171 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace qsh
+{
+	namespace bench
+	{
+		// Hardware and software counters of the calling thread through
+		// perf_event_open. Each counter is opened on its own, so whatever the
+		// kernel allows is still reported when some are missing (no PMU in a
+		// VM or container, perf_event_paranoid, seccomp). Counts are scaled
+		// when the kernel multiplexes counters.
+		class PerfCounters
+		{
+		public:
+			enum Counter
+			{
+				Cycles,
+				Instructions,
+				BranchMisses,
+				L1dMisses,
+				LlcMisses,
+				TaskClock,	// nanoseconds
+				PageFaults,
+				Count
+			};
+
+			struct Values
+			{
+				std::array<double, Count> value;
+				std::array<bool, Count> valid;
+			};
+
+			PerfCounters()
+			{
+				fds_.fill(-1);
+#ifdef __linux__
+				open(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+				open(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+				open(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+				open(L1dMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+						(PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+				open(LlcMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+				open(TaskClock, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+				open(PageFaults, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+#else
+				error_ = "perf_event_open is Linux only";
+#endif
+			}
+
+			~PerfCounters()
+			{
+#ifdef __linux__
+				for(int fd : fds_)
+				{
+					if(fd >= 0)
+						::close(fd);
+				}
+#endif
+			}
+
+			PerfCounters(const PerfCounters&) = delete;
+			PerfCounters& operator=(const PerfCounters&) = delete;
+
+			static const char* name(int counter)
+			{
+				static const char* names[] = { "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses",
+					"task-clock", "page-faults" };
+				return names[counter];
+			}
+
+			bool available(int counter) const
+			{
+				return fds_[counter] >= 0;
+			}
+
+			bool anyAvailable() const
+			{
+				for(int fd : fds_)
+				{
+					if(fd >= 0)
+						return true;
+				}
+				return false;
+			}
+
+			// Why the first unavailable counter could not be opened
+			const std::string& error() const
+			{
+				return error_;
+			}
+
+			void start()
+			{
+#ifdef __linux__
+				for(int fd : fds_)
+				{
+					if(fd >= 0)
+					{
+						ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+						ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+					}
+				}
+#endif
+			}
+
+			Values stop()
+			{
+				Values result;
+				result.value.fill(0);
+				result.valid.fill(false);
+#ifdef __linux__
+				for(int fd : fds_)
+				{
+					if(fd >= 0)
+						ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+				}
+				for(int i = 0; i < Count; i++)
+				{
+					// value, time enabled, time running
+					uint64_t data[3];
+					if(fds_[i] < 0 || ::read(fds_[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+						continue;
+					result.value[i] = (double)data[0] * data[1] / data[2];
+					result.valid[i] = true;
+				}
+#endif
+				return result;
+			}
+
+		private:
+#ifdef __linux__
+			void open(Counter counter, uint32_t type, uint64_t config)
+			{
+				perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = type;
+				attr.config = config;
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				fds_[counter] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+				if(fds_[counter] < 0 && error_.empty())
+					error_ = std::string(name(counter)) + ": " + strerror(errno);
+			}
+#endif
+
+		private:
+			std::array<int, Count> fds_;
+			std::string error_;
+		};
+	}
+}
+
+#endif /* ifndef PERF_H */
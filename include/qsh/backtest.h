@@ -0,0 +1,444 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "types.h"
+#include "book.h"
+
+namespace qsh
+{
+	namespace backtest
+	{
+		enum class Status
+		{
+			Working,
+			Filled,
+			Cancelled,
+			Expired	// dropped by a session change
+		};
+
+		// A virtual order; prices are in ticks
+		struct Order
+		{
+			uint64_t id;
+			book::Side side;
+			int64_t price;
+			int64_t volume;
+			int64_t filled;
+			int64_t ahead;	// real volume queued in front at the same price
+			uint64_t sequence;	// book sequence at submission
+			datetime_t submitTime;
+			Status status;
+			uint32_t prev;	// virtual orders at the same level, in time order
+			uint32_t next;
+
+			int64_t remaining() const
+			{
+				return volume - filled;
+			}
+		};
+
+		// Working virtual orders at one price
+		struct Queue
+		{
+			uint32_t head;
+			uint32_t tail;
+		};
+
+		struct Fill
+		{
+			uint64_t orderId;
+			datetime_t time;	// exchange time of the entry that caused it
+			int64_t price;	// in ticks
+			int64_t volume;
+			bool passive;	// false if taken from the book on submission
+		};
+	}
+
+	// Replays an order log into an L3Book and matches virtual orders
+	// against it, for backtesting passive strategies. A virtual order joins
+	// the back of the queue at its price and only sees the real volume ahead
+	// of it shrink as those orders are filled or cancelled. It is filled:
+	//
+	// - by a real fill at its own price against an order queued behind it,
+	//   since the aggressor had to get through the virtual order first;
+	// - by a real fill at a worse price on its side (the level was traded
+	//   through);
+	// - by real orders left resting on the other side at or through its
+	//   price at the end of a transaction, e.g. the rest of an aggressor
+	//   that took the real volume in front of it. Aggressors are logged as
+	//   an Add before their fills, so only the residual book counts;
+	// - on submission, from the levels it crosses.
+	//
+	// The replay itself is never altered: virtual orders take no volume
+	// from real ones. The volume that reaches virtual orders in one entry is
+	// shared among them by price, then time priority, and a resting real
+	// lot is matched with virtual orders only once. Everything depends on
+	// the entries alone, so a replay always produces the same fills.
+	//
+	// Drive it as the sink of QshFile (one instrument, see L3Book) and call
+	// submit()/cancel() between entries, e.g. from a wrapping sink. While no
+	// virtual order is working, each entry costs no more than the book.
+	// Working orders sit in per-price queues kept in price order, so a fill
+	// or cancel looks up one level, a trade-through visits only the levels
+	// it crosses, and nothing scans all working orders.
+	class MatchingSimulator
+	{
+	public:
+		using Order = backtest::Order;
+		using Fill = backtest::Fill;
+		using Status = backtest::Status;
+
+		static uint32_t none()
+		{
+			return UINT32_MAX;
+		}
+
+		MatchingSimulator(double step, size_t capacity = 1 << 16) : book_(step, capacity),
+			working_(0),
+			time_(0)
+		{
+		}
+
+		MatchingSimulator(const MatchingSimulator&) = delete;
+		MatchingSimulator& operator=(const MatchingSimulator&) = delete;
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			uint16_t flags = entry.flags;
+			time_ = entry.timestamp;
+			if(flags & OrderLogEntry::SessIdChanged)
+				expireAll();
+			replay(entry);
+			if((flags & OrderLogEntry::EndOfTransaction) && working_ > 0)
+				matchResting();
+		}
+
+		// Places a limit order and returns its id. The part that crosses the
+		// book is filled at once, the rest joins the queue at 'price'.
+		uint64_t submit(book::Side side, int64_t price, int64_t volume)
+		{
+			if(volume <= 0)
+				throw std::runtime_error("Invalid volume");
+			if(orders_.size() >= none())
+				throw std::runtime_error("Too many orders");
+
+			Order order = {};
+			order.id = orders_.size();
+			order.side = side;
+			order.price = price;
+			order.volume = volume;
+			order.sequence = book_.sequence();
+			order.submitTime = time_;
+			order.status = Status::Working;
+			order.prev = none();
+			order.next = none();
+			orders_.push_back(order);
+			Order& placed = orders_.back();
+
+			// Only the levels between the other side's best price and the limit
+			book::Side other = opposite(side);
+			if(!book_.empty(other))
+			{
+				for(int64_t level = book_.best(other); crosses(side, price, level, true);)
+				{
+					for(const book::Order* real = book_.level(other, level)->head; real && placed.remaining() > 0;
+							real = real->next)
+					{
+						int64_t volume = std::min(placed.remaining(), untaken(*real));
+						execute(placed, level, volume, false);
+						take(*real, volume);
+					}
+					if(placed.remaining() == 0 || !book_.nextLevel(other, level, level))
+						break;
+				}
+			}
+			if(placed.remaining() == 0)
+			{
+				placed.status = Status::Filled;
+				return placed.id;
+			}
+
+			const book::Level* level = book_.level(side, price);
+			placed.ahead = level ? level->volume : 0;
+			link(placed);
+			return placed.id;
+		}
+
+		// Returns false if the order is not working
+		bool cancel(uint64_t id)
+		{
+			if(id >= orders_.size() || orders_[id].status != Status::Working)
+				return false;
+			stop(orders_[id], Status::Cancelled);
+			return true;
+		}
+
+		const Order& order(uint64_t id) const
+		{
+			if(id >= orders_.size())
+				throw std::runtime_error("Unknown order");
+			return orders_[id];
+		}
+
+		size_t working() const
+		{
+			return working_;
+		}
+
+		// Fills since the last clearFills(), in the order they happened
+		const std::vector<Fill>& fills() const
+		{
+			return fills_;
+		}
+
+		void clearFills()
+		{
+			fills_.clear();
+		}
+
+		const L3Book& book() const
+		{
+			return book_;
+		}
+
+		// Exchange time of the last entry
+		datetime_t time() const
+		{
+			return time_;
+		}
+
+	private:
+		static book::Side opposite(book::Side side)
+		{
+			return side == book::Bid ? book::Ask : book::Bid;
+		}
+
+		// Whether 'price' is through the limit of an order on 'side' (below a
+		// bid, above an ask), or at it if inclusive
+		static bool crosses(book::Side side, int64_t limit, int64_t price, bool inclusive)
+		{
+			if(price == limit)
+				return inclusive;
+			return side == book::Bid ? price < limit : price > limit;
+		}
+
+		// Most aggressive working price of a side, which must have one
+		int64_t bestWorking(book::Side side) const
+		{
+			return side == book::Bid ? queues_[side].rbegin()->first : queues_[side].begin()->first;
+		}
+
+		// Feeds the book and updates the virtual orders at the level of the
+		// real order an entry fills or removes
+		void replay(const OrderLogEntry& entry)
+		{
+			uint16_t flags = entry.flags;
+			if((flags & OrderLogEntry::Counter) || !(flags & OrderLogEntry::Quote) || (flags & OrderLogEntry::Add) ||
+					(working_ == 0 && taken_.size() == 0))
+			{
+				book_.orderLogFrame(entry);
+				return;
+			}
+
+			// The real order leaves or shrinks; look at it before the book does
+			const book::Order* real = book_.find(entry.orderId);
+			if(!real)
+			{
+				book_.orderLogFrame(entry);
+				return;
+			}
+			book::Side side = real->side;
+			int64_t price = real->price;
+			uint64_t sequence = real->sequence;
+			bool fill = (flags & OrderLogEntry::Fill) != 0;
+			int64_t amount = 0;
+			if(fill)
+				amount = std::min<int64_t>(entry.volume, real->volume);
+			else if(flags & (OrderLogEntry::Cancelled | OrderLogEntry::CancelledGroup | OrderLogEntry::Moved))
+				amount = real->volume;
+			book_.orderLogFrame(entry);
+			if(taken_.size() > 0 && !book_.find(entry.orderId))
+				taken_.erase(entry.orderId);
+			if(amount <= 0 || working_ == 0)
+				return;
+
+			// One budget for both: the aggressor reached the better priced
+			// virtual orders first, then those queued ahead at this price
+			int64_t left = fill ? tradeThrough(side, price, amount, false) : 0;
+			queueChanged(side, price, sequence, amount, left);
+		}
+
+		// A real order at (side, price) lost 'amount', by a fill or a cancel.
+		// Virtual orders behind it get closer to the front; those ahead of it
+		// share 'left', what the aggressor had left when it got to it.
+		void queueChanged(book::Side side, int64_t price, uint64_t sequence, int64_t amount, int64_t left)
+		{
+			auto queue = queues_[side].find(price);
+			if(queue == queues_[side].end())
+				return;
+			for(uint32_t index = queue->second.head; index != none();)
+			{
+				Order& order = orders_[index];
+				index = order.next;
+				if(sequence < order.sequence)
+				{
+					order.ahead = std::max<int64_t>(order.ahead - amount, 0);
+				}
+				else if(left > 0)
+				{
+					int64_t volume = std::min(order.remaining(), left);
+					left -= volume;
+					execute(order, order.price, volume, true);
+					if(order.remaining() == 0)
+						stop(order, Status::Filled);
+				}
+			}
+		}
+
+		// 'volume' traded at 'price' on 'side', or rests on the other side
+		// at 'price' if inclusive. Fills the virtual orders of 'side' it went
+		// through, best price and then the front of its queue first, and
+		// returns the volume left over. Only the levels crossed are visited.
+		int64_t tradeThrough(book::Side side, int64_t price, int64_t volume, bool inclusive)
+		{
+			auto& queues = queues_[side];
+			while(volume > 0 && !queues.empty())
+			{
+				auto best = (side == book::Bid) ? std::prev(queues.end()) : queues.begin();
+				if(!crosses(side, best->first, price, inclusive))
+					break;
+				Order& order = orders_[best->second.head];
+				int64_t filled = std::min(order.remaining(), volume);
+				volume -= filled;
+				execute(order, order.price, filled, true);
+				if(order.remaining() == 0)
+					stop(order, Status::Filled);
+			}
+			return volume;
+		}
+
+		// At the end of a transaction, real orders resting at or through the
+		// best working price of the other side fill those virtual orders
+		void matchResting()
+		{
+			for(auto side : { book::Bid, book::Ask })
+			{
+				book::Side other = opposite(side);
+				if(queues_[side].empty() || book_.empty(other))
+					continue;
+				for(int64_t level = book_.best(other); crosses(side, bestWorking(side), level, true);)
+				{
+					for(const book::Order* real = book_.level(other, level)->head; real && !queues_[side].empty();
+							real = real->next)
+					{
+						int64_t available = untaken(*real);
+						take(*real, available - tradeThrough(side, level, available, true));
+					}
+					if(queues_[side].empty() || !book_.nextLevel(other, level, level))
+						break;
+				}
+			}
+		}
+
+		// Lots of a resting real order no virtual order has met yet
+		int64_t untaken(const book::Order& real) const
+		{
+			const int64_t* taken = taken_.find(real.orderId);
+			return std::max<int64_t>(real.volume - (taken ? *taken : 0), 0);
+		}
+
+		void take(const book::Order& real, int64_t volume)
+		{
+			if(volume <= 0)
+				return;
+			if(int64_t* taken = taken_.find(real.orderId))
+				*taken += volume;
+			else
+				taken_.insert(real.orderId, volume);
+		}
+
+		void execute(Order& order, int64_t price, int64_t volume, bool passive)
+		{
+			if(volume <= 0)
+				return;
+			fills_.push_back(Fill { order.id, time_, price, volume, passive });
+			order.filled += volume;
+		}
+
+		// Appends a working order to the queue at its price
+		void link(Order& order)
+		{
+			uint32_t index = (uint32_t)order.id;
+			auto& queues = queues_[order.side];
+			auto found = queues.find(order.price);
+			if(found == queues.end())
+			{
+				queues.emplace(order.price, backtest::Queue { index, index });
+			}
+			else
+			{
+				orders_[found->second.tail].next = index;
+				order.prev = found->second.tail;
+				found->second.tail = index;
+			}
+			working_++;
+		}
+
+		void stop(Order& order, Status status)
+		{
+			auto& queues = queues_[order.side];
+			auto queue = queues.find(order.price);
+			if(order.prev == none())
+				queue->second.head = order.next;
+			else
+				orders_[order.prev].next = order.next;
+			if(order.next == none())
+				queue->second.tail = order.prev;
+			else
+				orders_[order.next].prev = order.prev;
+			if(queue->second.head == none())
+				queues.erase(queue);
+			order.prev = order.next = none();
+			order.status = status;
+			working_--;
+		}
+
+		void expireAll()
+		{
+			for(auto& queues : queues_)
+			{
+				for(const auto& queue : queues)
+				{
+					for(uint32_t index = queue.second.head; index != none();)
+					{
+						Order& order = orders_[index];
+						index = order.next;
+						order.status = Status::Expired;
+						order.prev = order.next = none();
+					}
+				}
+				queues.clear();
+			}
+			working_ = 0;
+			taken_.clear();
+		}
+
+	private:
+		L3Book book_;
+		std::vector<Order> orders_;	// indexed by id
+		std::map<int64_t, backtest::Queue> queues_[2];	// working orders by side and price
+		size_t working_;
+		book::IdTable<int64_t> taken_;	// lots of resting real orders that met virtual ones
+		datetime_t time_;
+		std::vector<Fill> fills_;
+	};
+}
+
+#endif /* ifndef BACKTEST_H */
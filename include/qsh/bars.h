@@ -0,0 +1,260 @@
+#ifndef BARS_H
+#define BARS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "types.h"
+
+namespace qsh
+{
+	// Which timestamp time bars are bucketed by
+	enum class BarClock
+	{
+		Exchange,	// OrderLogEntry::timestamp
+		Frame		// OrderLogEntry::frameTimestamp
+	};
+
+	struct BarSpec
+	{
+		enum Type
+		{
+			Time,	// 'size' milliseconds
+			Volume,	// 'size' contracts; trades crossing the boundary are split
+			Ticks	// 'size' trades
+		};
+
+		Type type;
+		int64_t size;
+	};
+
+	// Completed bars of all specs, one row per bar. Prices are in ticks of
+	// the instrument's step; times are in the same units as OrderLogEntry.
+	struct BarColumns
+	{
+		std::vector<uint32_t> spec;	// index into the aggregator's specs
+		std::vector<datetime_t> openTime;	// bucket start for time bars, first trade otherwise
+		std::vector<datetime_t> closeTime;	// last trade
+		std::vector<int64_t> open;
+		std::vector<int64_t> high;
+		std::vector<int64_t> low;
+		std::vector<int64_t> close;
+		std::vector<int64_t> volume;
+		std::vector<uint32_t> trades;
+
+		size_t size() const
+		{
+			return spec.size();
+		}
+
+		void reserve(size_t capacity)
+		{
+			spec.reserve(capacity);
+			openTime.reserve(capacity);
+			closeTime.reserve(capacity);
+			open.reserve(capacity);
+			high.reserve(capacity);
+			low.reserve(capacity);
+			close.reserve(capacity);
+			volume.reserve(capacity);
+			trades.reserve(capacity);
+		}
+
+		// Keeps the capacity
+		void clear()
+		{
+			spec.clear();
+			openTime.clear();
+			closeTime.clear();
+			open.clear();
+			high.clear();
+			low.clear();
+			close.clear();
+			volume.clear();
+			trades.clear();
+		}
+	};
+
+	// Builds bars for several specs in one pass over the Fill entries of one
+	// instrument (combine with sinks::filter(sinks::Stream(n), ...) for
+	// multi-stream files). Each trade appears in the order log as a pair of
+	// Fill entries with the same trade id in one transaction, not always
+	// next to each other; only the first one is counted. The trade ids
+	// waiting for their second entry are kept per stream until the end of
+	// the transaction.
+	template <BarClock Clock = BarClock::Exchange>
+	class BarAggregator
+	{
+	public:
+		BarAggregator(const std::vector<BarSpec>& specs, double step, size_t capacity = 1 << 16) : specs_(specs),
+			state_(specs.size()),
+			stepNanos_(llround(step * 1e9))
+		{
+			if(stepNanos_ <= 0)
+				throw std::runtime_error("Invalid price step");
+			for(const auto& spec : specs_)
+			{
+				if(spec.size <= 0)
+					throw std::runtime_error("Invalid bar size");
+			}
+			for(auto& state : state_)
+				state.active = false;
+			bars_.reserve(capacity);
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			if(entry.flags & OrderLogEntry::Fill)
+			{
+				if(firstOfPair(entry.streamNumber, entry.matchingOrderId))
+				{
+					datetime_t time = (Clock == BarClock::Exchange) ? entry.timestamp : entry.frameTimestamp;
+					int64_t nanos = entry.tradePrice.toNanos();
+					int64_t price = (nanos + (nanos >= 0 ? stepNanos_ / 2 : -stepNanos_ / 2)) / stepNanos_;
+					trade(time, price, entry.volume);
+				}
+			}
+			if((entry.flags & OrderLogEntry::EndOfTransaction) && (size_t)entry.streamNumber < pending_.size())
+				pending_[entry.streamNumber].clear();
+		}
+
+		// Adds one trade directly, e.g. from a deals feed
+		void trade(datetime_t time, int64_t price, int64_t volume)
+		{
+			for(size_t i = 0; i < specs_.size(); i++)
+			{
+				const BarSpec& spec = specs_[i];
+				State& state = state_[i];
+				switch(spec.type)
+				{
+					case BarSpec::Time:
+					{
+						datetime_t bucket = time - (time % spec.size + spec.size) % spec.size;
+						if(state.active && bucket != state.openTime)
+							emit(i);
+						add(state, bucket, time, price, volume);
+						break;
+					}
+					case BarSpec::Volume:
+					{
+						int64_t remaining = volume;
+						while(remaining > 0)
+						{
+							int64_t part = std::min(remaining, spec.size - (state.active ? state.volume : 0));
+							add(state, time, time, price, part);
+							remaining -= part;
+							if(state.volume >= spec.size)
+								emit(i);
+						}
+						break;
+					}
+					case BarSpec::Ticks:
+						add(state, time, time, price, volume);
+						if(state.trades >= spec.size)
+							emit(i);
+						break;
+				}
+			}
+		}
+
+		// Emits the bars that are still open, e.g. at the end of a file
+		void flush()
+		{
+			for(size_t i = 0; i < specs_.size(); i++)
+			{
+				if(state_[i].active)
+					emit(i);
+			}
+		}
+
+		const std::vector<BarSpec>& specs() const
+		{
+			return specs_;
+		}
+
+		BarColumns& bars()
+		{
+			return bars_;
+		}
+
+	private:
+		static const size_t MaxPending = 64;
+
+		struct State
+		{
+			bool active;
+			datetime_t openTime;
+			datetime_t closeTime;
+			int64_t open;
+			int64_t high;
+			int64_t low;
+			int64_t close;
+			int64_t volume;
+			uint32_t trades;
+		};
+
+		// A transaction holds a handful of trades, so a linear search wins
+		bool firstOfPair(size_t stream, long long tradeId)
+		{
+			if(stream >= pending_.size())
+				pending_.resize(stream + 1);
+			std::vector<long long>& pending = pending_[stream];
+			auto found = std::find(pending.begin(), pending.end(), tradeId);
+			if(found != pending.end())
+			{
+				pending.erase(found);
+				return false;
+			}
+			// Without EndOfTransaction flags unpaired fills would pile up
+			if(pending.size() >= MaxPending)
+				pending.erase(pending.begin());
+			pending.push_back(tradeId);
+			return true;
+		}
+
+		static void add(State& state, datetime_t openTime, datetime_t time, int64_t price, int64_t volume)
+		{
+			if(!state.active)
+			{
+				state.active = true;
+				state.openTime = openTime;
+				state.open = state.high = state.low = price;
+				state.volume = 0;
+				state.trades = 0;
+			}
+			state.closeTime = time;
+			state.high = std::max(state.high, price);
+			state.low = std::min(state.low, price);
+			state.close = price;
+			state.volume += volume;
+			state.trades++;
+		}
+
+		void emit(size_t index)
+		{
+			State& state = state_[index];
+			bars_.spec.push_back(index);
+			bars_.openTime.push_back(state.openTime);
+			bars_.closeTime.push_back(state.closeTime);
+			bars_.open.push_back(state.open);
+			bars_.high.push_back(state.high);
+			bars_.low.push_back(state.low);
+			bars_.close.push_back(state.close);
+			bars_.volume.push_back(state.volume);
+			bars_.trades.push_back(state.trades);
+			state.active = false;
+		}
+
+	private:
+		std::vector<BarSpec> specs_;
+		std::vector<State> state_;
+		int64_t stepNanos_;
+		std::vector<std::vector<long long>> pending_;	// by stream number
+		BarColumns bars_;
+	};
+}
+
+#endif /* ifndef BARS_H */
@@ -0,0 +1,826 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "types.h"
+
+namespace qsh
+{
+	namespace book
+	{
+		enum Side
+		{
+			Bid = 0,
+			Ask = 1
+		};
+
+		inline Side sideOf(const OrderLogEntry& entry)
+		{
+			return (entry.flags & OrderLogEntry::Sell) ? Ask : Bid;
+		}
+
+		// Fixed-size objects carved out of slabs of 'slabSize'. Released
+		// objects go to a free list and are handed out again before a new
+		// slab is allocated, and addresses never change.
+		template <typename T>
+		class SlabPool
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "SlabPool holds trivial types only");
+
+		public:
+			explicit SlabPool(size_t reserve = 0, size_t slabSize = 4096) : slabSize_(slabSize),
+				free_(nullptr),
+				used_(0)
+			{
+				if(slabSize_ == 0)
+					throw std::runtime_error("Invalid slab size");
+				while(capacity() < reserve)
+					grow();
+			}
+
+			SlabPool(const SlabPool&) = delete;
+			SlabPool& operator=(const SlabPool&) = delete;
+
+			T* acquire()
+			{
+				if(!free_)
+					grow();
+				Node* node = free_;
+				free_ = node->next;
+				used_++;
+				return new(&node->value) T();
+			}
+
+			void release(T* value)
+			{
+				Node* node = reinterpret_cast<Node*>(value);
+				node->next = free_;
+				free_ = node;
+				used_--;
+			}
+
+			// Releases every object at once; the slabs are kept
+			void clear()
+			{
+				free_ = nullptr;
+				for(auto& slab : slabs_)
+					thread(slab.get());
+				used_ = 0;
+			}
+
+			size_t used() const
+			{
+				return used_;
+			}
+
+			size_t capacity() const
+			{
+				return slabs_.size() * slabSize_;
+			}
+
+			size_t slabs() const
+			{
+				return slabs_.size();
+			}
+
+		private:
+			union Node
+			{
+				Node* next;
+				T value;
+
+				Node()
+				{
+				}
+			};
+
+			void grow()
+			{
+				slabs_.emplace_back(new Node[slabSize_]);
+				thread(slabs_.back().get());
+			}
+
+			// Puts every node of 'slab' on the free list, lowest address first
+			void thread(Node* slab)
+			{
+				for(size_t i = slabSize_; i > 0; i--)
+				{
+					slab[i - 1].next = free_;
+					free_ = &slab[i - 1];
+				}
+			}
+
+		private:
+			size_t slabSize_;
+			std::vector<std::unique_ptr<Node[]>> slabs_;
+			Node* free_;
+			size_t used_;
+		};
+
+		// Open-addressing map from 64-bit ids to small values: linear probing
+		// over one array, Fibonacci hashing, and backward-shift deletion, so
+		// there are no tombstones and lookups never slow down with churn.
+		// Grows at half load. INT64_MIN is reserved as the empty marker.
+		template <typename Value>
+		class IdTable
+		{
+		public:
+			static int64_t emptyKey()
+			{
+				return std::numeric_limits<int64_t>::min();
+			}
+
+			explicit IdTable(size_t capacity = 1024) : size_(0)
+			{
+				rehash(capacity * 2);
+			}
+
+			Value* find(int64_t key)
+			{
+				for(size_t i = home(key);; i = (i + 1) & mask_)
+				{
+					if(slots_[i].key == key)
+						return &slots_[i].value;
+					if(slots_[i].key == emptyKey())
+						return nullptr;
+				}
+			}
+
+			const Value* find(int64_t key) const
+			{
+				return const_cast<IdTable*>(this)->find(key);
+			}
+
+			// Returns false if the key is already present
+			bool insert(int64_t key, const Value& value)
+			{
+				if(key == emptyKey())
+					throw std::runtime_error("Reserved id");
+				if((size_ + 1) * 2 > slots_.size())
+					rehash(slots_.size() * 2);
+				size_t i = home(key);
+				for(; slots_[i].key != emptyKey(); i = (i + 1) & mask_)
+				{
+					if(slots_[i].key == key)
+						return false;
+				}
+				slots_[i].key = key;
+				slots_[i].value = value;
+				size_++;
+				return true;
+			}
+
+			bool erase(int64_t key)
+			{
+				size_t i = home(key);
+				for(; slots_[i].key != key; i = (i + 1) & mask_)
+				{
+					if(slots_[i].key == emptyKey())
+						return false;
+				}
+
+				// Move back every entry of the following run that would become
+				// unreachable through the hole
+				for(size_t j = (i + 1) & mask_; slots_[j].key != emptyKey(); j = (j + 1) & mask_)
+				{
+					size_t k = home(slots_[j].key);
+					bool between = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+					if(!between)
+					{
+						slots_[i] = slots_[j];
+						i = j;
+					}
+				}
+				slots_[i].key = emptyKey();
+				size_--;
+				return true;
+			}
+
+			void clear()
+			{
+				for(auto& slot : slots_)
+					slot.key = emptyKey();
+				size_ = 0;
+			}
+
+			size_t size() const
+			{
+				return size_;
+			}
+
+			size_t buckets() const
+			{
+				return slots_.size();
+			}
+
+			template <typename Function>
+			void forEach(Function function) const
+			{
+				for(const auto& slot : slots_)
+				{
+					if(slot.key != emptyKey())
+						function(slot.key, slot.value);
+				}
+			}
+
+		private:
+			struct Slot
+			{
+				int64_t key;
+				Value value;
+			};
+
+			size_t home(int64_t key) const
+			{
+				return ((uint64_t)key * 0x9e3779b97f4a7c15ull) >> shift_;
+			}
+
+			void rehash(size_t buckets)
+			{
+				size_t size = 16;
+				int bits = 4;
+				while(size < buckets)
+				{
+					size <<= 1;
+					bits++;
+				}
+
+				std::vector<Slot> old;
+				old.swap(slots_);
+				slots_.assign(size, Slot { emptyKey(), Value() });
+				mask_ = size - 1;
+				shift_ = 64 - bits;
+				size_ = 0;
+				for(const auto& slot : old)
+				{
+					if(slot.key != emptyKey())
+						insert(slot.key, slot.value);
+				}
+			}
+
+		private:
+			std::vector<Slot> slots_;
+			size_t mask_;
+			int shift_;
+			size_t size_;
+		};
+
+		// One bit per index, plus one summary bit per 64-bit word that has any
+		// bit set. The nearest set bit above or below an index is found with
+		// find-first-set on at most two words, unless the gap spans more than
+		// 4096 indexes; then the summary words are scanned, 4096 indexes each.
+		class LevelBitmap
+		{
+		public:
+			// Clears every bit
+			void resize(size_t bits)
+			{
+				words_.assign((bits + 63) / 64, 0);
+				summary_.assign((words_.size() + 63) / 64, 0);
+			}
+
+			void set(size_t index)
+			{
+				words_[index >> 6] |= 1ull << (index & 63);
+				summary_[index >> 12] |= 1ull << ((index >> 6) & 63);
+			}
+
+			void reset(size_t index)
+			{
+				uint64_t& word = words_[index >> 6];
+				word &= ~(1ull << (index & 63));
+				if(word == 0)
+					summary_[index >> 12] &= ~(1ull << ((index >> 6) & 63));
+			}
+
+			// Lowest set index, -1 if none
+			int64_t first() const
+			{
+				return (!words_.empty() && (words_[0] & 1)) ? 0 : above(0);
+			}
+
+			// Highest set index of the first 'bits', -1 if none
+			int64_t last(size_t bits) const
+			{
+				size_t index = bits - 1;
+				return (words_[index >> 6] >> (index & 63)) & 1 ? (int64_t)index : below(index);
+			}
+
+			// Lowest set index above 'index', -1 if none
+			int64_t above(size_t index) const
+			{
+				size_t word = index >> 6;
+				uint64_t bits = (index & 63) == 63 ? 0 : words_[word] & (~0ull << ((index & 63) + 1));
+				if(bits)
+					return (int64_t)((word << 6) + __builtin_ctzll(bits));
+				int64_t next = wordAbove(word);
+				return next < 0 ? -1 : (next << 6) + __builtin_ctzll(words_[next]);
+			}
+
+			// Highest set index below 'index', -1 if none
+			int64_t below(size_t index) const
+			{
+				size_t word = index >> 6;
+				uint64_t bits = words_[word] & ((1ull << (index & 63)) - 1);
+				if(bits)
+					return (int64_t)((word << 6) + 63 - __builtin_clzll(bits));
+				int64_t next = wordBelow(word);
+				return next < 0 ? -1 : (next << 6) + 63 - __builtin_clzll(words_[next]);
+			}
+
+		private:
+			int64_t wordAbove(size_t word) const
+			{
+				size_t group = word >> 6;
+				uint64_t bits = (word & 63) == 63 ? 0 : summary_[group] & (~0ull << ((word & 63) + 1));
+				while(!bits)
+				{
+					if(++group >= summary_.size())
+						return -1;
+					bits = summary_[group];
+				}
+				return (int64_t)((group << 6) + __builtin_ctzll(bits));
+			}
+
+			int64_t wordBelow(size_t word) const
+			{
+				size_t group = word >> 6;
+				uint64_t bits = summary_[group] & ((1ull << (word & 63)) - 1);
+				while(!bits)
+				{
+					if(group == 0)
+						return -1;
+					bits = summary_[--group];
+				}
+				return (int64_t)((group << 6) + 63 - __builtin_clzll(bits));
+			}
+
+		private:
+			std::vector<uint64_t> words_;
+			std::vector<uint64_t> summary_;
+		};
+
+		// A resting order; prices are in ticks
+		struct Order
+		{
+			int64_t orderId;
+			int64_t price;
+			int64_t volume;
+			uint64_t sequence;	// arrival number; lower is ahead at the same price
+			Order* prev;	// towards the front of the queue
+			Order* next;
+			Side side;
+		};
+
+		// FIFO queue of the orders at one price
+		struct Level
+		{
+			int64_t volume;
+			uint32_t orders;
+			Order* head;
+			Order* tail;
+		};
+	}
+
+	// Order-by-order book of one instrument, built from OrderLogEntry
+	// frames (use sinks::filter(sinks::Stream(n), book) for multi-stream
+	// files). Only quotes rest in the book: Add|Quote inserts an order at
+	// the back of its level, Fill reduces it, Cancelled and Moved remove it,
+	// and Moved|Add inserts the replacement. Counter entries describe the
+	// aggressor and entries without Quote orders that never rest (e.g.
+	// fill-or-kill), both are skipped. A session change clears the book.
+	//
+	// Orders come from a slab pool, sit in intrusive lists per level and
+	// are found through an open-addressing id table; levels live in a price
+	// ladder indexed by tick, with a bitmap of the non-empty ones. Fill and
+	// Cancel never allocate, and when the best level empties the
+	// next one is found with find-first-set instead of a walk over the
+	// empty ticks. Add allocates only when the pool or the id table fills
+	// up, or when a price falls outside the ladder: the ladder then doubles
+	// its range, so this is rare after warm-up. The ladder spans at most
+	// 2^18 ticks per side; levels of stray prices beyond it are kept in a
+	// small sorted map.
+	class L3Book
+	{
+	public:
+		using Order = book::Order;
+		using Level = book::Level;
+		using Side = book::Side;
+
+		L3Book(double step, size_t capacity = 1 << 16) : stepNanos_(llround(step * 1e9)),
+			pool_(capacity),
+			orders_(capacity),
+			sequence_(0),
+			unknown_(0)
+		{
+			if(stepNanos_ <= 0)
+				throw std::runtime_error("Invalid price step");
+		}
+
+		L3Book(const L3Book&) = delete;
+		L3Book& operator=(const L3Book&) = delete;
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			uint16_t flags = entry.flags;
+			// Orders of the previous session are never referenced again
+			if(flags & OrderLogEntry::SessIdChanged)
+				clear();
+			if((flags & OrderLogEntry::Counter) || !(flags & OrderLogEntry::Quote))
+				return;
+
+			bool known = true;
+			if(flags & OrderLogEntry::Add)
+			{
+				known = add(entry.orderId, book::sideOf(entry), priceTicks(entry.orderPrice), entry.volume);
+			}
+			else if(flags & OrderLogEntry::Fill)
+			{
+				known = reduce(entry.orderId, entry.volume);
+			}
+			else if(flags & (OrderLogEntry::Cancelled | OrderLogEntry::CancelledGroup | OrderLogEntry::Moved))
+			{
+				known = remove(entry.orderId);
+			}
+			if(!known)
+				unknown_++;
+		}
+
+		// Returns false if the id is already in the book
+		bool add(int64_t orderId, Side side, int64_t price, int64_t volume)
+		{
+			if(orders_.find(orderId))
+				return false;
+			Ladder& ladder = ladders_[side];
+			Level& level = ladder.at(price);
+			Order* order = pool_.acquire();
+			order->orderId = orderId;
+			order->price = price;
+			order->volume = volume;
+			order->sequence = sequence_++;
+			order->side = side;
+			order->next = nullptr;
+			orders_.insert(orderId, order);
+
+			order->prev = level.tail;
+			if(level.tail)
+				level.tail->next = order;
+			else
+				level.head = order;
+			level.tail = order;
+			if(level.orders++ == 0)
+				ladder.levelAdded(price, side);
+			level.volume += volume;
+			return true;
+		}
+
+		// Removes the order once nothing is left. Returns false for an
+		// unknown id.
+		bool reduce(int64_t orderId, int64_t volume)
+		{
+			Order** found = orders_.find(orderId);
+			if(!found)
+				return false;
+			Order* order = *found;
+			if(volume >= order->volume)
+			{
+				unlink(order);
+				return true;
+			}
+			order->volume -= volume;
+			ladders_[order->side].at(order->price).volume -= volume;
+			return true;
+		}
+
+		bool remove(int64_t orderId)
+		{
+			Order** found = orders_.find(orderId);
+			if(!found)
+				return false;
+			unlink(*found);
+			return true;
+		}
+
+		void clear()
+		{
+			orders_.clear();
+			pool_.clear();
+			for(auto& ladder : ladders_)
+				ladder.clear();
+		}
+
+		// Replaces the contents with saved orders, e.g. from a checkpoint,
+		// keeping their arrival numbers. The orders of a level must come
+		// front to back; 'sequence' is the saved sequence().
+		void restore(const std::vector<Order>& orders, uint64_t sequence)
+		{
+			clear();
+			for(const auto& saved : orders)
+			{
+				if(!add(saved.orderId, saved.side, saved.price, saved.volume))
+					throw std::runtime_error("Duplicate order id");
+				(*orders_.find(saved.orderId))->sequence = saved.sequence;
+			}
+			sequence_ = sequence;
+		}
+
+		const Order* find(int64_t orderId) const
+		{
+			Order* const* found = orders_.find(orderId);
+			return found ? *found : nullptr;
+		}
+
+		// Volume queued in front of a live order at its price, -1 if the
+		// order is not in the book. Walks the orders ahead.
+		int64_t queueAhead(int64_t orderId) const
+		{
+			const Order* order = find(orderId);
+			if(!order)
+				return -1;
+			int64_t volume = 0;
+			for(const Order* ahead = order->prev; ahead; ahead = ahead->prev)
+				volume += ahead->volume;
+			return volume;
+		}
+
+		bool empty(Side side) const
+		{
+			return ladders_[side].nonEmpty == 0;
+		}
+
+		// Best price in ticks; the side must not be empty
+		int64_t best(Side side) const
+		{
+			return ladders_[side].best;
+		}
+
+		// nullptr if nothing rests at 'price'
+		const Level* level(Side side, int64_t price) const
+		{
+			const Level* result = ladders_[side].find(price);
+			return (result && result->orders > 0) ? result : nullptr;
+		}
+
+		// Calls function(price, level) for up to 'depth' non-empty levels
+		// from the best price outwards and returns how many were visited
+		template <typename Function>
+		size_t forEachLevel(Side side, size_t depth, Function function) const
+		{
+			const Ladder& ladder = ladders_[side];
+			size_t visited = 0;
+			if(ladder.nonEmpty == 0)
+				return 0;
+			int64_t price = ladder.best;
+			while(visited < depth)
+			{
+				function(price, *ladder.find(price));
+				visited++;
+				if(!ladder.next(price, side, price))
+					break;
+			}
+			return visited;
+		}
+
+		// The next non-empty level after 'price' away from the spread;
+		// false if there is none
+		bool nextLevel(Side side, int64_t price, int64_t& result) const
+		{
+			return ladders_[side].next(price, side, result);
+		}
+
+		size_t orders() const
+		{
+			return orders_.size();
+		}
+
+		size_t levels(Side side) const
+		{
+			return ladders_[side].nonEmpty;
+		}
+
+		// Sequence number the next added order will get
+		uint64_t sequence() const
+		{
+			return sequence_;
+		}
+
+		// Fill, cancel and move entries for orders that were not in the book,
+		// e.g. placed before the file starts
+		uint64_t unknownOrders() const
+		{
+			return unknown_;
+		}
+
+		int64_t priceTicks(const decimal_fixed& price) const
+		{
+			int64_t nanos = price.toNanos();
+			return (nanos + (nanos >= 0 ? stepNanos_ / 2 : -stepNanos_ / 2)) / stepNanos_;
+		}
+
+		const book::SlabPool<Order>& pool() const
+		{
+			return pool_;
+		}
+
+	private:
+		// Levels of one side indexed by price - base. Grows (rarely) when a
+		// price falls outside, up to MaxLevels; the levels of prices beyond
+		// that go to 'overflow', which never holds a price inside the ladder
+		// and only holds non-empty levels. The best price is tracked
+		// incrementally and only searched for, in 'occupied' and 'overflow',
+		// when the best level empties.
+		struct Ladder
+		{
+			static constexpr int64_t MaxLevels = 1 << 18;
+
+			std::vector<Level> levels;
+			book::LevelBitmap occupied;	// levels with orders
+			std::map<int64_t, Level> overflow;
+			int64_t base = 0;
+			int64_t best = 0;
+			size_t nonEmpty = 0;	// in both
+
+			bool dense(int64_t price) const
+			{
+				return (uint64_t)(price - base) < levels.size();
+			}
+
+			Level* find(int64_t price)
+			{
+				if(dense(price))
+					return &levels[price - base];
+				if(overflow.empty())
+					return nullptr;
+				auto found = overflow.find(price);
+				return found != overflow.end() ? &found->second : nullptr;
+			}
+
+			const Level* find(int64_t price) const
+			{
+				return const_cast<Ladder*>(this)->find(price);
+			}
+
+			Level& at(int64_t price)
+			{
+				if(Level* level = find(price))
+					return *level;
+				if(grow(price))
+					return levels[price - base];
+				return overflow[price];
+			}
+
+			// Makes the ladder cover 'price' unless that takes more than
+			// MaxLevels; an empty ladder is simply moved
+			bool grow(int64_t price)
+			{
+				if(levels.empty() || nonEmpty == overflow.size())
+				{
+					levels.assign(std::max<size_t>(levels.size(), 1024), Level());
+					base = price - (int64_t)levels.size() / 2;
+				}
+				else
+				{
+					int64_t low = std::min(base, price);
+					int64_t high = std::max(base + (int64_t)levels.size(), price + 1);
+					if(high - low > MaxLevels)
+						return false;
+					int64_t size = std::min(2 * (high - low), MaxLevels);
+					int64_t newBase = low - (size - (high - low)) / 2;
+					std::vector<Level> grown(size, Level());
+					std::copy(levels.begin(), levels.end(), grown.begin() + (base - newBase));
+					levels.swap(grown);
+					base = newBase;
+				}
+
+				// Overflow levels the ladder now covers move into it
+				for(auto it = overflow.lower_bound(base); it != overflow.end() && dense(it->first);)
+				{
+					levels[it->first - base] = it->second;
+					it = overflow.erase(it);
+				}
+				occupied.resize(levels.size());
+				for(size_t i = 0; i < levels.size(); i++)
+				{
+					if(levels[i].orders > 0)
+						occupied.set(i);
+				}
+				return true;
+			}
+
+			// The next non-empty level after 'price' away from the spread
+			bool next(int64_t price, Side side, int64_t& result) const
+			{
+				bool found = false;
+				int64_t index = price - base;
+				int64_t size = levels.size();
+				int64_t bit = -1;
+				if(side == book::Bid && index > 0 && size > 0)
+					bit = index >= size ? occupied.last(size) : occupied.below(index);
+				else if(side == book::Ask && size > 0 && index < size - 1)
+					bit = index < 0 ? occupied.first() : occupied.above(index);
+				if(bit >= 0)
+				{
+					result = base + bit;
+					found = true;
+				}
+				if(overflow.empty())
+					return found;
+
+				if(side == book::Bid)
+				{
+					auto it = overflow.lower_bound(price);
+					if(it != overflow.begin() && (!found || std::prev(it)->first > result))
+					{
+						result = std::prev(it)->first;
+						found = true;
+					}
+				}
+				else
+				{
+					auto it = overflow.upper_bound(price);
+					if(it != overflow.end() && (!found || it->first < result))
+					{
+						result = it->first;
+						found = true;
+					}
+				}
+				return found;
+			}
+
+			void levelAdded(int64_t price, Side side)
+			{
+				if(dense(price))
+					occupied.set(price - base);
+				if(nonEmpty++ == 0 || (side == book::Bid ? price > best : price < best))
+					best = price;
+			}
+
+			// Empties every level, keeping the ladder's range
+			void clear()
+			{
+				if(!levels.empty())
+				{
+					for(int64_t i = occupied.first(); i >= 0; i = occupied.above(i))
+					{
+						levels[i] = Level();
+						occupied.reset(i);
+					}
+				}
+				overflow.clear();
+				nonEmpty = 0;
+			}
+
+			// Invalidates the level of an overflow price
+			void levelRemoved(int64_t price, Side side)
+			{
+				if(dense(price))
+					occupied.reset(price - base);
+				else
+					overflow.erase(price);
+				if(--nonEmpty == 0 || price != best)
+					return;
+				next(price, side, best);
+			}
+		};
+
+		void unlink(Order* order)
+		{
+			Ladder& ladder = ladders_[order->side];
+			Level& level = ladder.at(order->price);
+			if(order->prev)
+				order->prev->next = order->next;
+			else
+				level.head = order->next;
+			if(order->next)
+				order->next->prev = order->prev;
+			else
+				level.tail = order->prev;
+			level.volume -= order->volume;
+			if(--level.orders == 0)
+				ladder.levelRemoved(order->price, order->side);
+			orders_.erase(order->orderId);
+			pool_.release(order);
+		}
+
+	private:
+		int64_t stepNanos_;
+		book::SlabPool<Order> pool_;
+		book::IdTable<Order*> orders_;
+		Ladder ladders_[2];
+		uint64_t sequence_;
+		uint64_t unknown_;
+	};
+}
+
+#endif /* ifndef BOOK_H */
@@ -0,0 +1,307 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "book.h"
+#include "qshfile.h"
+
+namespace qsh
+{
+	// Book checkpoints in a sidecar file next to a .qsh file, so a replay
+	// can start mid-day without decoding everything before it. Each
+	// checkpoint holds the decoder state (see DecoderState) and the live
+	// orders of one stream's L3Book, in queue order.
+	//
+	// Layout, all integers LEB128 as in the .qsh format:
+	//
+	//     "QSHCKPT" version
+	//     source file size, number of streams, book stream
+	//     checkpoints:
+	//         frame, offset, last timestamp, per stream the OrdLogState fields,
+	//         book sequence, per side: order count, then per order
+	//         id, price, volume, sequence (best level first, front to back)
+	//     index: count, per checkpoint: frame, offset, time, sidecar position
+	//     footer: index position (8 bytes, little endian), "QSHCKIDX"
+	namespace checkpoint
+	{
+		static const int Version = 1;
+
+		inline std::string sidecarPath(const std::string& path)
+		{
+			return path + ".ckpt";
+		}
+
+		struct Entry
+		{
+			uint64_t frame;	// frames decoded before the checkpoint
+			int64_t offset;	// of the next frame in the .qsh file
+			datetime_t time;	// frame timestamp of the last decoded frame
+			int64_t position;	// of the checkpoint in the sidecar
+		};
+
+		inline void writeBook(std::ostream& stream, const L3Book& book)
+		{
+			helpers::writeLeb128(stream, book.sequence());
+			for(auto side : { book::Bid, book::Ask })
+			{
+				size_t count = 0;
+				book.forEachLevel(side, book.levels(side), [&](int64_t, const book::Level& level) { count += level.orders; });
+				helpers::writeLeb128(stream, count);
+				book.forEachLevel(side, book.levels(side), [&](int64_t, const book::Level& level)
+						{
+							for(const book::Order* order = level.head; order; order = order->next)
+							{
+								helpers::writeLeb128(stream, order->orderId);
+								helpers::writeLeb128(stream, order->price);
+								helpers::writeLeb128(stream, order->volume);
+								helpers::writeLeb128(stream, order->sequence);
+							}
+						});
+			}
+		}
+
+		inline void readBook(std::istream& stream, L3Book& book)
+		{
+			uint64_t sequence = helpers::readLeb128(stream);
+			std::vector<book::Order> orders;
+			for(auto side : { book::Bid, book::Ask })
+			{
+				int64_t count = helpers::readLeb128(stream);
+				if(!stream.good() || count < 0)
+					throw std::runtime_error("Corrupted checkpoint");
+				for(int64_t i = 0; i < count; i++)
+				{
+					book::Order order = {};
+					order.side = side;
+					order.orderId = helpers::readLeb128(stream);
+					order.price = helpers::readLeb128(stream);
+					order.volume = helpers::readLeb128(stream);
+					order.sequence = helpers::readLeb128(stream);
+					if(!stream.good())
+						throw std::runtime_error("Corrupted checkpoint");
+					orders.push_back(order);
+				}
+			}
+			book.restore(orders, sequence);
+		}
+
+		// Sink of the builder: keeps the book of one stream and notes the
+		// transaction boundaries a checkpoint may follow
+		class BookFeeder
+		{
+		public:
+			BookFeeder(int streamNumber) : streamNumber_(streamNumber),
+				boundary(false),
+				time(0)
+			{
+			}
+
+			void orderLogFrame(const OrderLogEntry& entry)
+			{
+				if(entry.streamNumber != streamNumber_)
+					return;
+				book->orderLogFrame(entry);
+				boundary = (entry.flags & OrderLogEntry::EndOfTransaction) != 0;
+				time = entry.frameTimestamp;
+			}
+
+		private:
+			int streamNumber_;
+
+		public:
+			std::unique_ptr<L3Book> book;
+			bool boundary;
+			datetime_t time;
+		};
+	}
+
+	// Decodes 'path' once and writes a checkpoint of the book of stream
+	// 'streamNumber' at the first transaction boundary of every
+	// 'intervalMs' bucket of frame time, plus one before the first frame.
+	// Returns the number of checkpoints.
+	inline size_t buildCheckpoints(const std::string& path, const std::string& sidecar, int64_t intervalMs,
+			int streamNumber = 0)
+	{
+		if(intervalMs <= 0)
+			throw std::runtime_error("Invalid interval");
+		std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+		checkpoint::BookFeeder feeder(streamNumber);
+		QshFile<checkpoint::BookFeeder> file(stream, feeder);
+		const auto& streams = file.streams();
+		if(streamNumber < 0 || (size_t)streamNumber >= streams.size())
+			throw std::runtime_error("Invalid stream number");
+		feeder.book.reset(new L3Book(streams[streamNumber].step));
+
+		std::ofstream out(sidecar, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+		if(!out.good())
+			throw std::runtime_error("Unable to open " + sidecar);
+		out.write("QSHCKPT", 7);
+		out.put(checkpoint::Version);
+		{
+			std::ifstream size(path, std::ios_base::binary | std::ios_base::ate);
+			helpers::writeLeb128(out, size.tellg());
+		}
+		helpers::writeLeb128(out, streams.size());
+		helpers::writeLeb128(out, streamNumber);
+
+		std::vector<checkpoint::Entry> index;
+		uint64_t frame = 0;
+		datetime_t lastBucket = 0;
+		auto save = [&]()
+		{
+			DecoderState state = file.decoderState();
+			checkpoint::Entry entry = { frame, state.offset, state.lastTimestamp, (int64_t)out.tellp() };
+			helpers::writeLeb128(out, entry.frame);
+			helpers::writeLeb128(out, entry.offset);
+			helpers::writeLeb128(out, entry.time);
+			for(const auto& ordLogState : state.ordLogStates)
+				ordlog::writeState(out, ordLogState);
+			checkpoint::writeBook(out, *feeder.book);
+			index.push_back(entry);
+			lastBucket = entry.time - (entry.time % intervalMs + intervalMs) % intervalMs;
+		};
+
+		save();
+		while(stream.peek() != std::char_traits<char>::eof())
+		{
+			feeder.boundary = false;
+			file.readOneFrame();
+			frame++;
+			datetime_t time = feeder.time;
+			if(feeder.boundary && time - (time % intervalMs + intervalMs) % intervalMs != lastBucket)
+				save();
+		}
+
+		int64_t indexPosition = out.tellp();
+		helpers::writeLeb128(out, index.size());
+		for(const auto& entry : index)
+		{
+			helpers::writeLeb128(out, entry.frame);
+			helpers::writeLeb128(out, entry.offset);
+			helpers::writeLeb128(out, entry.time);
+			helpers::writeLeb128(out, entry.position);
+		}
+		for(int i = 0; i < 8; i++)
+			out.put((char)((uint64_t)indexPosition >> (8 * i)));
+		out.write("QSHCKIDX", 8);
+		if(!out.good())
+			throw std::runtime_error("Unable to write " + sidecar);
+		return index.size();
+	}
+
+	// Reads the index of a sidecar and restores its checkpoints
+	class CheckpointFile
+	{
+	public:
+		explicit CheckpointFile(const std::string& sidecar) : stream_(sidecar, std::ios_base::binary | std::ios_base::in)
+		{
+			if(!stream_.good())
+				throw std::runtime_error("Unable to open " + sidecar);
+			char magic[8];
+			stream_.read(magic, sizeof(magic));
+			if(!stream_.good() || memcmp(magic, "QSHCKPT", 7) != 0)
+				throw std::runtime_error("Invalid checkpoint file");
+			if(magic[7] != checkpoint::Version)
+				throw std::runtime_error("Unsupported checkpoint version");
+			sourceSize_ = helpers::readLeb128(stream_);
+			streams_ = helpers::readLeb128(stream_);
+			streamNumber_ = helpers::readLeb128(stream_);
+
+			unsigned char footer[16];
+			stream_.seekg(-16, std::ios_base::end);
+			stream_.read((char*)footer, sizeof(footer));
+			if(!stream_.good() || memcmp(footer + 8, "QSHCKIDX", 8) != 0)
+				throw std::runtime_error("Truncated checkpoint file");
+			uint64_t indexPosition = 0;
+			for(int i = 0; i < 8; i++)
+				indexPosition |= (uint64_t)footer[i] << (8 * i);
+
+			stream_.seekg(indexPosition);
+			int64_t count = helpers::readLeb128(stream_);
+			if(!stream_.good() || count < 0)
+				throw std::runtime_error("Corrupted checkpoint index");
+			for(int64_t i = 0; i < count; i++)
+			{
+				checkpoint::Entry entry;
+				entry.frame = helpers::readLeb128(stream_);
+				entry.offset = helpers::readLeb128(stream_);
+				entry.time = helpers::readLeb128(stream_);
+				entry.position = helpers::readLeb128(stream_);
+				if(!stream_.good())
+					throw std::runtime_error("Corrupted checkpoint index");
+				entries_.push_back(entry);
+			}
+		}
+
+		const std::vector<checkpoint::Entry>& entries() const
+		{
+			return entries_;
+		}
+
+		// Size of the .qsh file the checkpoints were built from
+		int64_t sourceSize() const
+		{
+			return sourceSize_;
+		}
+
+		int streamNumber() const
+		{
+			return streamNumber_;
+		}
+
+		// Latest checkpoint at or before frame time 'time', nullptr if none
+		const checkpoint::Entry* before(datetime_t time) const
+		{
+			const checkpoint::Entry* result = nullptr;
+			for(const auto& entry : entries_)
+			{
+				if(entry.time > time)
+					break;
+				result = &entry;
+			}
+			return result;
+		}
+
+		// Positions 'file' (opened on the source file) right after the
+		// checkpoint and loads its book into 'book'. Throws if 'file' is not
+		// the file the checkpoints were built from.
+		template <typename Sink, typename Stats>
+		void restore(const checkpoint::Entry& entry, QshFile<Sink, Stats>& file, L3Book& book)
+		{
+			if(file.size() != sourceSize_ || (int64_t)file.streams().size() != streams_)
+				throw std::runtime_error("Checkpoint does not match the file");
+			stream_.clear();
+			stream_.seekg(entry.position);
+			if(helpers::readLeb128(stream_) != (int64_t)entry.frame || helpers::readLeb128(stream_) != entry.offset ||
+					helpers::readLeb128(stream_) != entry.time)
+				throw std::runtime_error("Corrupted checkpoint");
+
+			DecoderState state;
+			state.offset = entry.offset;
+			state.lastTimestamp = entry.time;
+			for(int64_t i = 0; i < streams_; i++)
+				state.ordLogStates.push_back(ordlog::readState(stream_));
+			if(!stream_.good())
+				throw std::runtime_error("Corrupted checkpoint");
+			checkpoint::readBook(stream_, book);
+			file.restoreDecoderState(state);
+		}
+
+	private:
+		std::ifstream stream_;
+		int64_t sourceSize_;
+		int64_t streams_;
+		int streamNumber_;
+		std::vector<checkpoint::Entry> entries_;
+	};
+}
+
+#endif /* ifndef CHECKPOINT_H */
@@ -0,0 +1,299 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "types.h"
+#include "datetime.h"
+
+namespace qsh
+{
+	// Text formatting without printf, gmtime or temporaries: every writer
+	// takes the output position and returns the position after the text.
+	namespace csv
+	{
+		inline const char* digitPairs()
+		{
+			return "00010203040506070809"
+				"10111213141516171819"
+				"20212223242526272829"
+				"30313233343536373839"
+				"40414243444546474849"
+				"50515253545556575859"
+				"60616263646566676869"
+				"70717273747576777879"
+				"80818283848586878889"
+				"90919293949596979899";
+		}
+
+		inline int digitCount(uint64_t value)
+		{
+			int count = 1;
+			while(value >= 10000)
+			{
+				value /= 10000;
+				count += 4;
+			}
+			if(value >= 1000)
+				return count + 3;
+			if(value >= 100)
+				return count + 2;
+			if(value >= 10)
+				return count + 1;
+			return count;
+		}
+
+		inline char* writeUnsigned(char* out, uint64_t value)
+		{
+			int count = digitCount(value);
+			char* end = out + count;
+			char* position = end;
+			while(value >= 100)
+			{
+				const char* pair = digitPairs() + (value % 100) * 2;
+				value /= 100;
+				*--position = pair[1];
+				*--position = pair[0];
+			}
+			if(value >= 10)
+			{
+				const char* pair = digitPairs() + value * 2;
+				*--position = pair[1];
+				*--position = pair[0];
+			}
+			else
+			{
+				*--position = '0' + value;
+			}
+			return end;
+		}
+
+		inline char* writeSigned(char* out, int64_t value)
+		{
+			if(value < 0)
+			{
+				*out++ = '-';
+				return writeUnsigned(out, 0 - (uint64_t)value);
+			}
+			return writeUnsigned(out, value);
+		}
+
+		// Exactly 'width' digits, zero padded; value < 10^width
+		inline char* writeFixed(char* out, uint32_t value, int width)
+		{
+			for(int i = width - 1; i >= 0; i--)
+			{
+				out[i] = '0' + value % 10;
+				value /= 10;
+			}
+			return out + width;
+		}
+
+		inline char* writeTwoDigits(char* out, uint32_t value)
+		{
+			const char* pair = digitPairs() + value * 2;
+			out[0] = pair[0];
+			out[1] = pair[1];
+			return out + 2;
+		}
+
+		// Shortest exact decimal: no trailing zeros, no point for integers
+		inline char* writeDecimal(char* out, const decimal_fixed& value)
+		{
+			if(value.fractional == 0)
+				return writeSigned(out, value.value);
+			int64_t nanos = value.toNanos();
+			uint64_t magnitude = nanos < 0 ? 0 - (uint64_t)nanos : nanos;
+			if(nanos < 0)
+				*out++ = '-';
+			out = writeUnsigned(out, magnitude / 1000000000);
+			uint32_t fraction = magnitude % 1000000000;
+			if(fraction == 0)
+				return out;
+			int width = 9;
+			while(fraction % 10 == 0)
+			{
+				fraction /= 10;
+				width--;
+			}
+			*out++ = '.';
+			return writeFixed(out, fraction, width);
+		}
+
+		// Formats millisecond timestamps of OrderLogEntry (see
+		// helpers::convertGrowDatetimeToTimePoint) as "DD.MM.YYYY HH:MM:SS.mmm".
+		// The text up to the seconds is kept and only rebuilt when the second
+		// changes, the date part only when the day changes.
+		class TimestampFormatter
+		{
+		public:
+			static const int Size = 23;
+
+			TimestampFormatter() : second_(INT64_MIN),
+				day_(INT64_MIN)
+			{
+			}
+
+			char* write(char* out, datetime_t timestamp)
+			{
+				int64_t second = helpers::floorDiv(timestamp, 1000);
+				if(second != second_)
+					update(timestamp, second);
+				uint32_t millis = timestamp - second * 1000;
+				memcpy(out, text_, 19);
+				out[19] = '.';
+				out[20] = '0' + millis / 100;
+				writeTwoDigits(out + 21, millis % 100);
+				return out + Size;
+			}
+
+		private:
+			void update(datetime_t timestamp, int64_t second)
+			{
+				second_ = second;
+				const Calendar& calendar = calendar_.fromGrowDatetime(timestamp);
+				if(calendar_.day() != day_)
+				{
+					day_ = calendar_.day();
+					writeTwoDigits(text_, calendar.day);
+					text_[2] = '.';
+					writeTwoDigits(text_ + 3, calendar.month);
+					text_[5] = '.';
+					writeFixed(text_ + 6, calendar.year, 4);
+					text_[10] = ' ';
+				}
+				writeTwoDigits(text_ + 11, calendar.hour);
+				text_[13] = ':';
+				writeTwoDigits(text_ + 14, calendar.minute);
+				text_[16] = ':';
+				writeTwoDigits(text_ + 17, calendar.second);
+			}
+
+		private:
+			int64_t second_;
+			int64_t day_;
+			CalendarCache calendar_;
+			char text_[19];
+		};
+	}
+
+	// Writes order log entries as CSV (or TSV, with separator '\t') into a
+	// large buffer that is handed to 'stream' whenever it fills up. The
+	// destructor flushes what is left. Columns:
+	//
+	//     frame_time, exchange_time, stream, flags, order_id, order_price,
+	//     volume, remain, matching_order_id, trade_price, open_interest
+	//
+	// Times are "DD.MM.YYYY HH:MM:SS.mmm" UTC, prices exact decimals and
+	// flags the raw bit mask.
+	class CsvExporter
+	{
+	public:
+		// Longest line: two timestamps and nine fields of at most 31
+		// characters (sign, 20 digits, point and 9 decimals), each followed
+		// by a separator
+		static const size_t MaxLine = 2 * (csv::TimestampFormatter::Size + 1) + 9 * 32;
+
+		CsvExporter(std::ostream& stream, char separator = ',', bool header = true, size_t bufferSize = 1 << 20) :
+			stream_(stream),
+			separator_(separator),
+			buffer_(bufferSize < 2 * MaxLine ? 2 * MaxLine : bufferSize),
+			position_(buffer_.data()),
+			limit_(buffer_.data() + buffer_.size() - MaxLine),
+			bytes_(0)
+		{
+			if(header)
+			{
+				static const char* columns[] = { "frame_time", "exchange_time", "stream", "flags", "order_id", "order_price",
+					"volume", "remain", "matching_order_id", "trade_price", "open_interest" };
+				for(auto column : columns)
+				{
+					size_t length = strlen(column);
+					memcpy(position_, column, length);
+					position_ += length;
+					*position_++ = separator_;
+				}
+				position_[-1] = '\n';
+			}
+		}
+
+		~CsvExporter()
+		{
+			try
+			{
+				flush();
+			}
+			catch(...)
+			{
+			}
+		}
+
+		CsvExporter(const CsvExporter&) = delete;
+		CsvExporter& operator=(const CsvExporter&) = delete;
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			char* out = position_;
+			char separator = separator_;
+			out = frameTime_.write(out, entry.frameTimestamp);
+			*out++ = separator;
+			out = exchangeTime_.write(out, entry.timestamp);
+			*out++ = separator;
+			out = csv::writeUnsigned(out, entry.streamNumber);
+			*out++ = separator;
+			out = csv::writeUnsigned(out, entry.flags);
+			*out++ = separator;
+			out = csv::writeSigned(out, entry.orderId);
+			*out++ = separator;
+			out = csv::writeDecimal(out, entry.orderPrice);
+			*out++ = separator;
+			out = csv::writeSigned(out, entry.volume);
+			*out++ = separator;
+			out = csv::writeSigned(out, entry.remain);
+			*out++ = separator;
+			out = csv::writeSigned(out, entry.matchingOrderId);
+			*out++ = separator;
+			out = csv::writeDecimal(out, entry.tradePrice);
+			*out++ = separator;
+			out = csv::writeSigned(out, entry.openInterest);
+			*out++ = '\n';
+			position_ = out;
+			if(position_ >= limit_)
+				flush();
+		}
+
+		void flush()
+		{
+			size_t size = position_ - buffer_.data();
+			if(size == 0)
+				return;
+			stream_.write(buffer_.data(), size);
+			bytes_ += size;
+			position_ = buffer_.data();
+			if(!stream_.good())
+				throw std::runtime_error("Unable to write");
+		}
+
+		// Bytes handed to the stream so far
+		uint64_t bytes() const
+		{
+			return bytes_;
+		}
+
+	private:
+		std::ostream& stream_;
+		char separator_;
+		std::vector<char> buffer_;
+		char* position_;
+		char* limit_;
+		uint64_t bytes_;
+		csv::TimestampFormatter frameTime_;
+		csv::TimestampFormatter exchangeTime_;
+	};
+}
+
+#endif /* ifndef CSV_H */
@@ -0,0 +1,214 @@
+#ifndef DATETIME_H
+#define DATETIME_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+#include "simd.h"
+
+namespace qsh
+{
+	// Nanoseconds since the Unix epoch as a std::chrono time point
+	using SysTime = std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds>;
+
+	namespace helpers
+	{
+		// The two encodings of datetime_t in QSH files, see
+		// convertDatetimeToTimePoint (100 ns ticks since 0001-01-01, used in
+		// the header) and convertGrowDatetimeToTimePoint (milliseconds since
+		// 0001-01-01, used by frames and OrderLogEntry)
+		static const int64_t TickNanos = 100;
+		static const int64_t GrowNanos = 1000000;
+
+		// Year 1 in nanoseconds before the Unix epoch does not fit in int64,
+		// so it is kept modulo 2^64: (uint64_t)t * unit - EpochOffsetNanos is
+		// exact whenever the result fits
+		static const uint64_t EpochOffsetNanos = (uint64_t)TimeDeltaInSeconds * 1000000000u;
+
+		// Valid for instants between 1677 and 2262, like int64 nanoseconds
+		inline int64_t datetimeToEpochNanos(datetime_t t)
+		{
+			return (t - TimeDeltaInSeconds * (1000000000 / TickNanos)) * TickNanos;
+		}
+
+		inline int64_t growDatetimeToEpochNanos(datetime_t t)
+		{
+			return (t - TimeDeltaInSeconds * (1000000000 / GrowNanos)) * GrowNanos;
+		}
+
+		inline SysTime datetimeToSysTime(datetime_t t)
+		{
+			return SysTime(std::chrono::nanoseconds(datetimeToEpochNanos(t)));
+		}
+
+		inline SysTime growDatetimeToSysTime(datetime_t t)
+		{
+			return SysTime(std::chrono::nanoseconds(growDatetimeToEpochNanos(t)));
+		}
+
+		inline int64_t floorDiv(int64_t value, int64_t divisor)
+		{
+			return value / divisor - (value % divisor < 0 ? 1 : 0);
+		}
+
+		// Civil date of a day counted from 1970-01-01, proleptic Gregorian
+		// (H. Hinnant's algorithm, no tables and no time zone lookups)
+		inline void civilFromDays(int64_t days, int& year, int& month, int& day)
+		{
+			days += 719468;
+			int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+			int64_t dayOfEra = days - era * 146097;
+			int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+			int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+			int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+			day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+			month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+			year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+		}
+
+		inline int64_t daysFromCivil(int year, int month, int day)
+		{
+			year -= month <= 2 ? 1 : 0;
+			int64_t era = (year >= 0 ? year : year - 399) / 400;
+			int64_t yearOfEra = year - era * 400;
+			int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+			int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+			return era * 146097 + dayOfEra - 719468;
+		}
+
+		// Whole columns at once: out[i] = datetimeToEpochNanos(in[i]) and
+		// growDatetimeToEpochNanos(in[i]). 'in' and 'out' may be the same
+		// array. AVX2 when the CPU has it, scalar otherwise. The kernels
+		// compute in * scale - offset modulo 2^64, which is exact whenever
+		// the result fits.
+		namespace batch
+		{
+			inline void affineScalar(const int64_t* in, int64_t* out, size_t count, uint32_t scale, uint64_t offset)
+			{
+				for(size_t i = 0; i < count; i++)
+					out[i] = (int64_t)((uint64_t)in[i] * scale - offset);
+			}
+
+#ifdef QSH_SIMD_X86
+			QSH_TARGET_AVX2 inline void affineAvx2(const int64_t* in, int64_t* out, size_t count, uint32_t scale,
+					uint64_t offset)
+			{
+				__m256i subtrahend = _mm256_set1_epi64x((int64_t)offset);
+				size_t i = 0;
+				for(; i + 8 <= count; i += 8)
+				{
+					__m256i a = _mm256_loadu_si256((const __m256i*)(in + i));
+					__m256i b = _mm256_loadu_si256((const __m256i*)(in + i + 4));
+					a = _mm256_sub_epi64(simd::mul64by32(a, scale), subtrahend);
+					b = _mm256_sub_epi64(simd::mul64by32(b, scale), subtrahend);
+					_mm256_storeu_si256((__m256i*)(out + i), a);
+					_mm256_storeu_si256((__m256i*)(out + i + 4), b);
+				}
+				affineScalar(in + i, out + i, count - i, scale, offset);
+			}
+#endif
+
+			inline void affine(const int64_t* in, int64_t* out, size_t count, uint32_t scale, uint64_t offset)
+			{
+#ifdef QSH_SIMD_X86
+				if(simd::hasAvx2())
+					return affineAvx2(in, out, count, scale, offset);
+#endif
+				affineScalar(in, out, count, scale, offset);
+			}
+
+			inline void datetimeToEpochNanos(const datetime_t* in, int64_t* out, size_t count)
+			{
+				affine(in, out, count, TickNanos, EpochOffsetNanos);
+			}
+
+			inline void growDatetimeToEpochNanos(const datetime_t* in, int64_t* out, size_t count)
+			{
+				affine(in, out, count, GrowNanos, EpochOffsetNanos);
+			}
+		}
+	}
+
+	// Calendar fields of a UTC instant, as struct tm counts them except for
+	// month (1-12) and year (full year)
+	struct Calendar
+	{
+		int year;
+		int month;
+		int day;
+		int hour;
+		int minute;
+		int second;
+		int nanosecond;
+		int weekday;	// 0 is Sunday
+		int yearDay;	// 0 is January 1st
+	};
+
+	// Replaces gmtime for timestamps that mostly move forward: the date part
+	// is computed once per day, the time of day with a few divisions.
+	class CalendarCache
+	{
+	public:
+		CalendarCache() : day_(INT64_MIN)
+		{
+			calendar_ = Calendar();
+		}
+
+		// 'nanosecond' is the fraction of 'seconds', 0 to 999999999
+		const Calendar& fromEpochSeconds(int64_t seconds, int nanosecond = 0)
+		{
+			int64_t day = helpers::floorDiv(seconds, 86400);
+			if(day != day_)
+				setDay(day);
+			int64_t secondOfDay = seconds - day * 86400;
+			calendar_.hour = secondOfDay / 3600;
+			calendar_.minute = secondOfDay / 60 % 60;
+			calendar_.second = secondOfDay % 60;
+			calendar_.nanosecond = nanosecond;
+			return calendar_;
+		}
+
+		const Calendar& fromEpochNanos(int64_t nanos)
+		{
+			int64_t seconds = helpers::floorDiv(nanos, 1000000000);
+			return fromEpochSeconds(seconds, nanos - seconds * 1000000000);
+		}
+
+		// Both encodings are split into seconds first, so any year 1-9999
+		// is accepted
+		const Calendar& fromDatetime(datetime_t t)
+		{
+			int64_t seconds = helpers::floorDiv(t, 10000000);
+			return fromEpochSeconds(seconds - TimeDeltaInSeconds, (t - seconds * 10000000) * helpers::TickNanos);
+		}
+
+		const Calendar& fromGrowDatetime(datetime_t t)
+		{
+			int64_t seconds = helpers::floorDiv(t, 1000);
+			return fromEpochSeconds(seconds - TimeDeltaInSeconds, (t - seconds * 1000) * helpers::GrowNanos);
+		}
+
+		// Days since 1970-01-01 of the last conversion
+		int64_t day() const
+		{
+			return day_;
+		}
+
+	private:
+		void setDay(int64_t day)
+		{
+			day_ = day;
+			helpers::civilFromDays(day, calendar_.year, calendar_.month, calendar_.day);
+			calendar_.weekday = (int)(((day + 4) % 7 + 7) % 7);
+			calendar_.yearDay = (int)(day - helpers::daysFromCivil(calendar_.year, 1, 1));
+		}
+
+	private:
+		int64_t day_;
+		Calendar calendar_;
+	};
+}
+
+#endif /* ifndef DATETIME_H */
@@ -0,0 +1,240 @@
+#ifndef DECIMAL_H
+#define DECIMAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "types.h"
+#include "simd.h"
+
+namespace qsh
+{
+	// Column kernels over prices: raw ticks (or billionths, see
+	// decimal_fixed::toNanos) as int64 arrays and decimal_fixed arrays. Each
+	// kernel has a scalar and an AVX2 version and a dispatcher that picks
+	// one at run time; sums wrap around like int64 arithmetic.
+	namespace decimal
+	{
+		inline int64_t sumScalar(const int64_t* values, size_t count)
+		{
+			int64_t result = 0;
+			for(size_t i = 0; i < count; i++)
+				result += values[i];
+			return result;
+		}
+
+		// 'count' must not be 0 for min and max
+		inline int64_t minScalar(const int64_t* values, size_t count)
+		{
+			int64_t result = values[0];
+			for(size_t i = 1; i < count; i++)
+				result = values[i] < result ? values[i] : result;
+			return result;
+		}
+
+		inline int64_t maxScalar(const int64_t* values, size_t count)
+		{
+			int64_t result = values[0];
+			for(size_t i = 1; i < count; i++)
+				result = values[i] > result ? values[i] : result;
+			return result;
+		}
+
+		// out[i] = -1, 0 or 1 as a[i] is below, equal to or above b[i]
+		inline void compareScalar(const int64_t* a, const int64_t* b, int8_t* out, size_t count)
+		{
+			for(size_t i = 0; i < count; i++)
+				out[i] = (a[i] > b[i]) - (a[i] < b[i]);
+		}
+
+		// Exact sum; integral parts wrap like int64
+		inline decimal_fixed sumScalar(const decimal_fixed* values, size_t count)
+		{
+			int64_t integral = 0;
+			int64_t fractional = 0;
+			for(size_t i = 0; i < count; i++)
+			{
+				integral += values[i].value;
+				fractional += values[i].fractional;
+			}
+			return decimal_fixed(integral + fractional / decimal_fixed::Scale, fractional % decimal_fixed::Scale);
+		}
+
+		inline void toNanosScalar(const decimal_fixed* values, int64_t* out, size_t count)
+		{
+			for(size_t i = 0; i < count; i++)
+				out[i] = values[i].toNanos();
+		}
+
+#ifdef QSH_SIMD_X86
+		QSH_TARGET_AVX2 inline int64_t horizontalSum(__m256i value)
+		{
+			__m128i sum = _mm_add_epi64(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+			return _mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1);
+		}
+
+		QSH_TARGET_AVX2 inline int64_t sumAvx2(const int64_t* values, size_t count)
+		{
+			__m256i a = _mm256_setzero_si256();
+			__m256i b = _mm256_setzero_si256();
+			size_t i = 0;
+			for(; i + 8 <= count; i += 8)
+			{
+				a = _mm256_add_epi64(a, _mm256_loadu_si256((const __m256i*)(values + i)));
+				b = _mm256_add_epi64(b, _mm256_loadu_si256((const __m256i*)(values + i + 4)));
+			}
+			return horizontalSum(_mm256_add_epi64(a, b)) + sumScalar(values + i, count - i);
+		}
+
+		// AVX2 has no 64-bit min and max, they are a compare and a blend
+		template<bool Max>
+		QSH_TARGET_AVX2 inline int64_t extremeAvx2(const int64_t* values, size_t count)
+		{
+			if(count < 8)
+				return Max ? maxScalar(values, count) : minScalar(values, count);
+			// Two chains, the blends would otherwise wait on each other
+			__m256i a = _mm256_loadu_si256((const __m256i*)values);
+			__m256i b = _mm256_loadu_si256((const __m256i*)(values + 4));
+			size_t i = 8;
+			for(; i + 8 <= count; i += 8)
+			{
+				__m256i x = _mm256_loadu_si256((const __m256i*)(values + i));
+				__m256i y = _mm256_loadu_si256((const __m256i*)(values + i + 4));
+				a = _mm256_blendv_epi8(a, x, Max ? _mm256_cmpgt_epi64(x, a) : _mm256_cmpgt_epi64(a, x));
+				b = _mm256_blendv_epi8(b, y, Max ? _mm256_cmpgt_epi64(y, b) : _mm256_cmpgt_epi64(b, y));
+			}
+			int64_t lanes[8];
+			_mm256_storeu_si256((__m256i*)lanes, a);
+			_mm256_storeu_si256((__m256i*)(lanes + 4), b);
+			int64_t extreme = Max ? maxScalar(lanes, 8) : minScalar(lanes, 8);
+			if(i < count)
+			{
+				int64_t rest = Max ? maxScalar(values + i, count - i) : minScalar(values + i, count - i);
+				extreme = (Max ? rest > extreme : rest < extreme) ? rest : extreme;
+			}
+			return extreme;
+		}
+
+		QSH_TARGET_AVX2 inline void compareAvx2(const int64_t* a, const int64_t* b, int8_t* out, size_t count)
+		{
+			// Low byte of every 64-bit lane into the first 2 bytes of each half
+			const __m256i gather = _mm256_setr_epi8(0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+					0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+			size_t i = 0;
+			for(; i + 4 <= count; i += 4)
+			{
+				__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+				__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+				// All-ones masks are -1, so less - greater is the sign of x - y
+				__m256i sign = _mm256_sub_epi64(_mm256_cmpgt_epi64(y, x), _mm256_cmpgt_epi64(x, y));
+				sign = _mm256_shuffle_epi8(sign, gather);
+				uint32_t packed = (uint32_t)_mm256_extract_epi16(sign, 0) | ((uint32_t)_mm256_extract_epi16(sign, 8) << 16);
+				memcpy(out + i, &packed, 4);
+			}
+			compareScalar(a + i, b + i, out + i, count - i);
+		}
+
+		// Two decimal_fixed per register: the integral parts and the
+		// fractional parts (with padding above them, masked off) are summed in
+		// separate lanes
+		QSH_TARGET_AVX2 inline decimal_fixed sumAvx2(const decimal_fixed* values, size_t count)
+		{
+			static_assert(sizeof(decimal_fixed) == 16, "decimal_fixed layout");
+			const __m256i mask = _mm256_setr_epi64x(-1, 0xffffffff, -1, 0xffffffff);
+			__m256i a = _mm256_setzero_si256();
+			__m256i b = _mm256_setzero_si256();
+			size_t i = 0;
+			for(; i + 4 <= count; i += 4)
+			{
+				a = _mm256_add_epi64(a, _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(values + i)), mask));
+				b = _mm256_add_epi64(b, _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(values + i + 2)), mask));
+			}
+			int64_t lanes[4];
+			_mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(a, b));
+			int64_t integral = lanes[0] + lanes[2];
+			int64_t fractional = lanes[1] + lanes[3];
+			decimal_fixed rest = sumScalar(values + i, count - i);
+			integral += rest.value;
+			fractional += rest.fractional;
+			return decimal_fixed(integral + fractional / decimal_fixed::Scale, fractional % decimal_fixed::Scale);
+		}
+
+		QSH_TARGET_AVX2 inline void toNanosAvx2(const decimal_fixed* values, int64_t* out, size_t count)
+		{
+			const __m256i mask = _mm256_set1_epi64x(0xffffffff);
+			size_t i = 0;
+			for(; i + 4 <= count; i += 4)
+			{
+				// [value0, fractional0, value1, fractional1] and the next two
+				__m256i first = _mm256_loadu_si256((const __m256i*)(values + i));
+				__m256i second = _mm256_loadu_si256((const __m256i*)(values + i + 2));
+				__m256i integral = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(first, second), 0xd8);
+				__m256i fractional = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(first, second), 0xd8);
+				__m256i nanos = _mm256_add_epi64(simd::mul64by32(integral, decimal_fixed::Scale),
+						_mm256_and_si256(fractional, mask));
+				_mm256_storeu_si256((__m256i*)(out + i), nanos);
+			}
+			toNanosScalar(values + i, out + i, count - i);
+		}
+#endif
+
+		inline int64_t sum(const int64_t* values, size_t count)
+		{
+#ifdef QSH_SIMD_X86
+			if(simd::hasAvx2())
+				return sumAvx2(values, count);
+#endif
+			return sumScalar(values, count);
+		}
+
+		inline int64_t min(const int64_t* values, size_t count)
+		{
+#ifdef QSH_SIMD_X86
+			if(simd::hasAvx2())
+				return extremeAvx2<false>(values, count);
+#endif
+			return minScalar(values, count);
+		}
+
+		inline int64_t max(const int64_t* values, size_t count)
+		{
+#ifdef QSH_SIMD_X86
+			if(simd::hasAvx2())
+				return extremeAvx2<true>(values, count);
+#endif
+			return maxScalar(values, count);
+		}
+
+		inline void compare(const int64_t* a, const int64_t* b, int8_t* out, size_t count)
+		{
+#ifdef QSH_SIMD_X86
+			if(simd::hasAvx2())
+				return compareAvx2(a, b, out, count);
+#endif
+			compareScalar(a, b, out, count);
+		}
+
+		inline decimal_fixed sum(const decimal_fixed* values, size_t count)
+		{
+#ifdef QSH_SIMD_X86
+			if(simd::hasAvx2())
+				return sumAvx2(values, count);
+#endif
+			return sumScalar(values, count);
+		}
+
+		// Billionths of every value, so that decimal_fixed columns can go
+		// through the int64 kernels above; |value| must stay below 9.2e9
+		inline void toNanos(const decimal_fixed* values, int64_t* out, size_t count)
+		{
+#ifdef QSH_SIMD_X86
+			if(simd::hasAvx2())
+				return toNanosAvx2(values, out, count);
+#endif
+			toNanosScalar(values, out, count);
+		}
+	}
+}
+
+#endif /* ifndef DECIMAL_H */
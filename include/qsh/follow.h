@@ -0,0 +1,154 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "qshfile.h"
+
+namespace qsh
+{
+	// Decodes a QSH file that is still being appended to. The file is opened
+	// once; decoder state and offset are kept between polls, and truncated
+	// frames at the tail are re-read when the rest of them arrives. On Linux
+	// growth is detected with inotify, elsewhere by polling.
+	template <typename Sink>
+	class QshFollower
+	{
+	public:
+		QshFollower(const std::string& path, Sink& sink,
+				std::chrono::milliseconds pollInterval = std::chrono::milliseconds(100)) : path_(path),
+			stream_(path, std::ios_base::binary | std::ios_base::in),
+			pollInterval_(pollInterval),
+			stopped_(false),
+			watch_(-1)
+		{
+			// Watch before the header is read, so no write can be missed
+			openWatch();
+			try
+			{
+				file_.reset(new QshFile<Sink>(stream_, sink));
+			}
+			catch(...)
+			{
+				closeWatch();
+				throw;
+			}
+		}
+
+		~QshFollower()
+		{
+			closeWatch();
+		}
+
+		QshFollower(const QshFollower&) = delete;
+		QshFollower& operator=(const QshFollower&) = delete;
+
+		QshFile<Sink>& file()
+		{
+			return *file_;
+		}
+
+		// Decodes whatever complete frames have been appended since the last call
+		size_t poll()
+		{
+			return file_->readAvailableFrames();
+		}
+
+		// Decodes frames as they are appended until stop() is called or no new
+		// frame arrives for 'idleTimeout'. Returns the number of frames read.
+		size_t follow(std::chrono::milliseconds idleTimeout = std::chrono::milliseconds::max())
+		{
+			size_t total = 0;
+			auto lastProgress = std::chrono::steady_clock::now();
+			while(!stopped_.load(std::memory_order_acquire))
+			{
+				size_t frames = poll();
+				total += frames;
+
+				auto now = std::chrono::steady_clock::now();
+				if(frames > 0)
+				{
+					lastProgress = now;
+					continue;
+				}
+
+				auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastProgress);
+				if(idle >= idleTimeout)
+					break;
+				waitForGrowth(std::min(pollInterval_, idleTimeout - idle));
+			}
+			return total;
+		}
+
+		// May be called from another thread
+		void stop()
+		{
+			stopped_.store(true, std::memory_order_release);
+		}
+
+	private:
+		void openWatch()
+		{
+#ifdef __linux__
+			watch_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if(watch_ >= 0 && inotify_add_watch(watch_, path_.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0)
+			{
+				::close(watch_);
+				watch_ = -1;
+			}
+#endif
+		}
+
+		void closeWatch()
+		{
+#ifdef __linux__
+			if(watch_ >= 0)
+				::close(watch_);
+#endif
+			watch_ = -1;
+		}
+
+		// Returns early when the file is modified; the timeout bounds the
+		// latency of stop()
+		void waitForGrowth(std::chrono::milliseconds timeout)
+		{
+#ifdef __linux__
+			if(watch_ >= 0)
+			{
+				struct pollfd fd = { watch_, POLLIN, 0 };
+				if(::poll(&fd, 1, (int)timeout.count()) > 0)
+				{
+					char events[4096];
+					while(::read(watch_, events, sizeof(events)) > 0)
+					{
+					}
+				}
+				return;
+			}
+#endif
+			std::this_thread::sleep_for(timeout);
+		}
+
+	private:
+		std::string path_;
+		std::ifstream stream_;
+		std::unique_ptr<QshFile<Sink>> file_;
+		std::chrono::milliseconds pollInterval_;
+		std::atomic<bool> stopped_;
+		int watch_;
+	};
+}
+
+#endif /* ifndef FOLLOW_H */
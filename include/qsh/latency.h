@@ -0,0 +1,308 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace qsh
+{
+	// Log-linear histogram of non-negative integers, as in HdrHistogram:
+	// values below 2^SubBucketBits are exact, above that each power of two
+	// is split into 2^SubBucketBits buckets (6% relative error for 4 bits).
+	// Fixed size, O(1) record.
+	template <int SubBucketBits = 4>
+	class LogHistogram
+	{
+	public:
+		static const int SubBuckets = 1 << SubBucketBits;
+		static const int Buckets = (64 - SubBucketBits) * SubBuckets;
+
+		LogHistogram()
+		{
+			reset();
+		}
+
+		void reset()
+		{
+			counts_.fill(0);
+			count_ = 0;
+			negative_ = 0;
+			sum_ = 0;
+			min_ = std::numeric_limits<int64_t>::max();
+			max_ = std::numeric_limits<int64_t>::min();
+		}
+
+		// Negative values are counted separately and in min/max/mean
+		void record(int64_t value)
+		{
+			count_++;
+			sum_ += value;
+			min_ = std::min(min_, value);
+			max_ = std::max(max_, value);
+			if(value < 0)
+				negative_++;
+			else
+				counts_[index(value)]++;
+		}
+
+		static int index(uint64_t value)
+		{
+			if(value < (uint64_t)SubBuckets)
+				return value;
+			int msb = 63 - __builtin_clzll(value);
+			int shift = msb - SubBucketBits;
+			return (shift + 1) * SubBuckets + (int)((value >> shift) - SubBuckets);
+		}
+
+		// Smallest value that falls into bucket 'index'
+		static uint64_t lowerBound(int index)
+		{
+			if(index < SubBuckets)
+				return index;
+			int shift = index / SubBuckets - 1;
+			return (uint64_t)(index % SubBuckets + SubBuckets) << shift;
+		}
+
+		// Largest value that falls into bucket 'index'
+		static uint64_t upperBound(int index)
+		{
+			if(index + 1 >= Buckets)
+				return std::numeric_limits<int64_t>::max();
+			return lowerBound(index + 1) - 1;
+		}
+
+		// Upper bound of the bucket holding the q-th quantile (0 <= q <= 1),
+		// clamped to the exact maximum. Negative values count as below every
+		// bucket.
+		int64_t quantile(double q) const
+		{
+			if(count_ == 0)
+				return 0;
+			uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * count_ + 0.5));
+			if(rank <= negative_)
+				return min_;
+			uint64_t seen = negative_;
+			for(int i = 0; i < Buckets; i++)
+			{
+				seen += counts_[i];
+				if(seen >= rank)
+					return std::min<int64_t>(upperBound(i), max_);
+			}
+			return max_;
+		}
+
+		uint64_t count() const
+		{
+			return count_;
+		}
+
+		uint64_t negative() const
+		{
+			return negative_;
+		}
+
+		int64_t min() const
+		{
+			return count_ ? min_ : 0;
+		}
+
+		int64_t max() const
+		{
+			return count_ ? max_ : 0;
+		}
+
+		double mean() const
+		{
+			return count_ ? (double)sum_ / count_ : 0.0;
+		}
+
+		uint64_t bucketCount(int index) const
+		{
+			return counts_[index];
+		}
+
+	private:
+		std::array<uint64_t, Buckets> counts_;
+		uint64_t count_;
+		uint64_t negative_;
+		int64_t sum_;
+		int64_t min_;
+		int64_t max_;
+	};
+
+	// Histograms of capture latency, frameTimestamp - timestamp in
+	// milliseconds, per stream over the whole run and per time window. The
+	// windows form a ring of 'windows' slots, so memory does not depend on
+	// the length of the data; the default covers a day in 5-minute windows.
+	class LatencySink
+	{
+	public:
+		using Histogram = LogHistogram<4>;
+
+		LatencySink(datetime_t windowMs = 5 * 60 * 1000, size_t windows = 288) : windowMs_(windowMs),
+			windows_(windows)
+		{
+			if(windowMs_ <= 0 || windows_ == 0)
+				throw std::runtime_error("Invalid latency window");
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			Stream& stream = streamFor(entry.streamNumber);
+			int64_t latency = entry.frameTimestamp - entry.timestamp;
+			stream.total.record(latency);
+
+			int64_t id = entry.frameTimestamp / windowMs_;
+			Window& window = stream.windows[id % windows_];
+			if(window.id != id)
+			{
+				window.id = id;
+				window.histogram.reset();
+			}
+			window.histogram.record(latency);
+		}
+
+		size_t streams() const
+		{
+			return streams_.size();
+		}
+
+		const Histogram& total(int streamNumber) const
+		{
+			return streams_.at(streamNumber).total;
+		}
+
+		// Windows still in the ring, oldest first: (start in frame time, histogram)
+		std::vector<std::pair<datetime_t, const Histogram*>> windows(int streamNumber) const
+		{
+			std::vector<std::pair<datetime_t, const Histogram*>> result;
+			for(const auto& window : streams_.at(streamNumber).windows)
+			{
+				if(window.id >= 0 && window.histogram.count() > 0)
+					result.emplace_back(window.id * windowMs_, &window.histogram);
+			}
+			std::sort(result.begin(), result.end(),
+					[](const std::pair<datetime_t, const Histogram*>& a, const std::pair<datetime_t, const Histogram*>& b)
+					{
+						return a.first < b.first;
+					});
+			return result;
+		}
+
+		// One object per stream with the overall summary and one per window.
+		// Times are Unix milliseconds, latencies milliseconds.
+		std::string toJson() const
+		{
+			std::string result = "{\"windowMs\":" + std::to_string(windowMs_) + ",\"streams\":[";
+			for(size_t i = 0; i < streams_.size(); i++)
+			{
+				if(i > 0)
+					result += ',';
+				result += "{\"stream\":" + std::to_string(i) + ",\"total\":" + summaryJson(streams_[i].total) + ",\"windows\":[";
+				bool first = true;
+				for(const auto& window : windows(i))
+				{
+					if(!first)
+						result += ',';
+					first = false;
+					result += "{\"start\":" + std::to_string(unixMs(window.first)) + "," + summaryJson(*window.second).substr(1);
+				}
+				result += "]}";
+			}
+			result += "]}";
+			return result;
+		}
+
+		// Fixed-width table, one line per stream and window
+		std::string toText() const
+		{
+			std::string result;
+			char line[256];
+			snprintf(line, sizeof(line), "%-6s %-19s %10s %6s %6s %6s %6s %6s %8s %8s\n",
+					"stream", "window", "count", "min", "p50", "p90", "p99", "p99.9", "max", "negative");
+			result += line;
+			for(size_t i = 0; i < streams_.size(); i++)
+			{
+				result += summaryText(line, sizeof(line), i, "total", streams_[i].total);
+				for(const auto& window : windows(i))
+				{
+					auto tp = helpers::convertGrowDatetimeToTimePoint(window.first);
+					struct tm t;
+					gmtime_r(&tp.first, &t);
+					char start[64];
+					snprintf(start, sizeof(start), "%04d-%02d-%02d %02d:%02d:%02d",
+							t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+					result += summaryText(line, sizeof(line), i, start, *window.second);
+				}
+			}
+			return result;
+		}
+
+	private:
+		struct Window
+		{
+			int64_t id = -1;
+			Histogram histogram;
+		};
+
+		struct Stream
+		{
+			Histogram total;
+			std::vector<Window> windows;
+		};
+
+		Stream& streamFor(int streamNumber)
+		{
+			if((size_t)streamNumber >= streams_.size())
+			{
+				size_t first = streams_.size();
+				streams_.resize(streamNumber + 1);
+				for(size_t i = first; i < streams_.size(); i++)
+					streams_[i].windows.resize(windows_);
+			}
+			return streams_[streamNumber];
+		}
+
+		static int64_t unixMs(datetime_t t)
+		{
+			auto tp = helpers::convertGrowDatetimeToTimePoint(t);
+			return (int64_t)tp.first * 1000 + tp.second / 1000;
+		}
+
+		static std::string summaryJson(const Histogram& h)
+		{
+			char buffer[256];
+			snprintf(buffer, sizeof(buffer),
+					"{\"count\":%llu,\"min\":%lld,\"mean\":%.3f,\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"p999\":%lld,\"max\":%lld,\"negative\":%llu}",
+					(unsigned long long)h.count(), (long long)h.min(), h.mean(), (long long)h.quantile(0.5),
+					(long long)h.quantile(0.9), (long long)h.quantile(0.99), (long long)h.quantile(0.999),
+					(long long)h.max(), (unsigned long long)h.negative());
+			return buffer;
+		}
+
+		static std::string summaryText(char* line, size_t size, size_t stream, const char* window, const Histogram& h)
+		{
+			snprintf(line, size, "%-6zu %-19s %10llu %6lld %6lld %6lld %6lld %6lld %8lld %8llu\n",
+					stream, window, (unsigned long long)h.count(), (long long)h.min(), (long long)h.quantile(0.5),
+					(long long)h.quantile(0.9), (long long)h.quantile(0.99), (long long)h.quantile(0.999),
+					(long long)h.max(), (unsigned long long)h.negative());
+			return line;
+		}
+
+	private:
+		datetime_t windowMs_;
+		size_t windows_;
+		std::vector<Stream> streams_;
+	};
+}
+
+#endif /* ifndef LATENCY_H */
@@ -0,0 +1,288 @@
+#ifndef LIFECYCLE_H
+#define LIFECYCLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+#include "book.h"
+
+namespace qsh
+{
+	// Orders whose life ended, one row each. A moved order keeps its row:
+	// orderId is the id it was added with, lastOrderId the id after the
+	// last move. Times are exchange times; firstFillTime is 0 for orders
+	// that never traded.
+	struct LifecycleColumns
+	{
+		enum End : uint8_t
+		{
+			Filled,
+			Cancelled,	// Cancelled, CancelledGroup, or a move without replacement
+			SessionEnd,	// cleared by a session change
+			Open		// still live when closeAll() was called
+		};
+
+		std::vector<int64_t> orderId;
+		std::vector<int64_t> lastOrderId;
+		std::vector<uint8_t> side;	// book::Side
+		std::vector<uint8_t> end;	// End
+		std::vector<fixed_nanos> price;	// last price
+		std::vector<datetime_t> addTime;
+		std::vector<datetime_t> firstFillTime;
+		std::vector<datetime_t> endTime;
+		std::vector<int64_t> volume;	// at the first add
+		std::vector<int64_t> filled;	// over all moves
+		std::vector<uint32_t> fills;
+		std::vector<uint32_t> moves;
+
+		size_t size() const
+		{
+			return orderId.size();
+		}
+
+		datetime_t lifetime(size_t row) const
+		{
+			return endTime[row] - addTime[row];
+		}
+
+		void reserve(size_t capacity)
+		{
+			forEachColumn([&](auto& column) { column.reserve(capacity); });
+		}
+
+		// Keeps the capacity
+		void clear()
+		{
+			forEachColumn([&](auto& column) { column.clear(); });
+		}
+
+	private:
+		template <typename Function>
+		void forEachColumn(Function function)
+		{
+			function(orderId);
+			function(lastOrderId);
+			function(side);
+			function(end);
+			function(price);
+			function(addTime);
+			function(firstFillTime);
+			function(endTime);
+			function(volume);
+			function(filled);
+			function(fills);
+			function(moves);
+		}
+	};
+
+	// Follows every resting (Quote) order from its add to its last fill or
+	// cancel and appends a row to completed() when it ends. A Moved removal
+	// directly followed by Moved|Add is one order that moved: the row carries
+	// over to the new id. Counter and non-Quote entries are skipped, as in
+	// L3Book, and fills or cancels of orders added before the data started
+	// are only counted in unknown().
+	//
+	// Live orders sit in a slot array with a free list, found through a
+	// book::IdTable; both are sized by the most orders live at once, never
+	// by the orders seen. 'capacity' is the expected number of live orders,
+	// a few thousand even for liquid futures; keeping the table that small
+	// keeps it in cache. completed() grows until the caller drains it with
+	// completed().clear().
+	class LifecycleTracker
+	{
+	public:
+		explicit LifecycleTracker(size_t capacity = 1 << 12) : ids_(capacity),
+			moving_(NoSlot),
+			movedAt_(0),
+			unknown_(0)
+		{
+			live_.reserve(capacity);
+			completed_.reserve(capacity);
+		}
+
+		LifecycleTracker(const LifecycleTracker&) = delete;
+		LifecycleTracker& operator=(const LifecycleTracker&) = delete;
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			uint16_t flags = entry.flags;
+			if(flags & OrderLogEntry::SessIdChanged)
+				closeAll(LifecycleColumns::SessionEnd, entry.timestamp);
+			if((flags & OrderLogEntry::Counter) || !(flags & OrderLogEntry::Quote))
+				return;
+
+			bool replacement = (flags & OrderLogEntry::Moved) && (flags & OrderLogEntry::Add);
+			if(moving_ != NoSlot && !replacement)
+			{
+				finish(moving_, LifecycleColumns::Cancelled, movedAt_);
+				moving_ = NoSlot;
+			}
+
+			if(flags & OrderLogEntry::Add)
+			{
+				add(entry, replacement);
+				return;
+			}
+
+			uint32_t* found = ids_.find(entry.orderId);
+			if(!found)
+			{
+				unknown_++;
+				return;
+			}
+			uint32_t slot = *found;
+			Live& order = live_[slot];
+			if(flags & OrderLogEntry::Fill)
+			{
+				if(order.fills++ == 0)
+					order.firstFillTime = entry.timestamp;
+				order.filled += entry.volume;
+				order.remaining -= entry.volume;
+				if(order.remaining <= 0)
+				{
+					ids_.erase(entry.orderId);
+					finish(slot, LifecycleColumns::Filled, entry.timestamp);
+				}
+			}
+			else if(flags & OrderLogEntry::Moved)
+			{
+				// Decided by the next entry: Moved|Add continues the order
+				ids_.erase(entry.orderId);
+				moving_ = slot;
+				movedAt_ = entry.timestamp;
+			}
+			else if(flags & (OrderLogEntry::Cancelled | OrderLogEntry::CancelledGroup))
+			{
+				ids_.erase(entry.orderId);
+				finish(slot, LifecycleColumns::Cancelled, entry.timestamp);
+			}
+		}
+
+		// Ends every live order with 'end', e.g. Open at the end of the data
+		void closeAll(LifecycleColumns::End end, datetime_t time)
+		{
+			if(moving_ != NoSlot)
+			{
+				finish(moving_, LifecycleColumns::Cancelled, movedAt_);
+				moving_ = NoSlot;
+			}
+			// finish() does not touch the id table, so no copy of the slots
+			ids_.forEach([&](int64_t, uint32_t slot) { finish(slot, end, time); });
+			ids_.clear();
+		}
+
+		LifecycleColumns& completed()
+		{
+			return completed_;
+		}
+
+		size_t liveOrders() const
+		{
+			return ids_.size();
+		}
+
+		// Slots ever allocated: the most orders live at once
+		size_t capacity() const
+		{
+			return live_.size();
+		}
+
+		// Entries for orders added before the data started
+		uint64_t unknown() const
+		{
+			return unknown_;
+		}
+
+	private:
+		static const uint32_t NoSlot = UINT32_MAX;
+
+		struct Live
+		{
+			int64_t orderId;
+			int64_t lastOrderId;
+			int64_t price;
+			datetime_t addTime;
+			datetime_t firstFillTime;
+			int64_t volume;
+			int64_t remaining;
+			int64_t filled;
+			uint32_t fills;
+			uint32_t moves;
+			uint8_t side;
+		};
+
+		void add(const OrderLogEntry& entry, bool replacement)
+		{
+			uint32_t slot;
+			if(replacement && moving_ != NoSlot)
+			{
+				slot = moving_;
+				moving_ = NoSlot;
+				live_[slot].moves++;
+			}
+			else
+			{
+				if(free_.empty())
+				{
+					slot = live_.size();
+					live_.emplace_back();
+				}
+				else
+				{
+					slot = free_.back();
+					free_.pop_back();
+				}
+				Live& order = live_[slot];
+				order.orderId = entry.orderId;
+				order.addTime = entry.timestamp;
+				order.firstFillTime = 0;
+				order.volume = entry.volume;
+				order.filled = 0;
+				order.fills = 0;
+				order.moves = 0;
+			}
+			Live& order = live_[slot];
+			order.lastOrderId = entry.orderId;
+			order.price = entry.orderPrice.toNanos();
+			order.remaining = entry.volume;
+			order.side = book::sideOf(entry);
+			if(!ids_.insert(entry.orderId, slot))
+			{
+				// The id is live already; the data is inconsistent
+				unknown_++;
+				finish(slot, LifecycleColumns::Cancelled, entry.timestamp);
+			}
+		}
+
+		void finish(uint32_t slot, LifecycleColumns::End end, datetime_t time)
+		{
+			const Live& order = live_[slot];
+			completed_.orderId.push_back(order.orderId);
+			completed_.lastOrderId.push_back(order.lastOrderId);
+			completed_.side.push_back(order.side);
+			completed_.end.push_back(end);
+			completed_.price.push_back(fixed_nanos::fromRaw(order.price));
+			completed_.addTime.push_back(order.addTime);
+			completed_.firstFillTime.push_back(order.firstFillTime);
+			completed_.endTime.push_back(time);
+			completed_.volume.push_back(order.volume);
+			completed_.filled.push_back(order.filled);
+			completed_.fills.push_back(order.fills);
+			completed_.moves.push_back(order.moves);
+			free_.push_back(slot);
+		}
+
+	private:
+		book::IdTable<uint32_t> ids_;
+		std::vector<Live> live_;
+		std::vector<uint32_t> free_;
+		uint32_t moving_;
+		datetime_t movedAt_;
+		LifecycleColumns completed_;
+		uint64_t unknown_;
+	};
+}
+
+#endif /* ifndef LIFECYCLE_H */
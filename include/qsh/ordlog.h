@@ -0,0 +1,153 @@
+#ifndef ORDLOG_H
+#define ORDLOG_H
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <utility>
+
+#include "types.h"
+
+namespace qsh
+{
+	// Running values of an OrdLog stream. Every frame carries deltas (or
+	// absolute values) only for the fields selected by its 'parts' byte.
+	struct OrdLogState
+	{
+		datetime_t exchangeTime;
+		int64_t orderId;
+		int64_t addOrderId;	// id of the last Add frame, the base of all order ids
+		int64_t orderPrice;
+		int64_t volume;
+		int64_t volumeLeft;
+		int64_t tradeId;
+		int64_t tradePrice;
+		int64_t openInterest;
+	};
+
+	namespace ordlog
+	{
+		enum Parts
+		{
+			ExchangeTime = (1 << 0),
+			OrderId = (1 << 1),
+			OrderPrice = (1 << 2),
+			Volume = (1 << 3),
+			VolumeLeft = (1 << 4),
+			TradeId = (1 << 5),
+			TradePrice = (1 << 6),
+			OpenInterest = (1 << 7)
+		};
+
+		// Selects the orderId encoding. Order ids are relative to the id of
+		// the last Add frame: Add frames carry a growing delta and become the
+		// new base, other frames a signed delta. Without the OrderId part the
+		// delta is zero, i.e. the frame refers to the last added order.
+		static const uint16_t AddFlag = OrderLogEntry::Add;
+
+		enum class PartsDecoding
+		{
+			Table,
+			Sequential
+		};
+
+		// The one body of both decoders. decodeParts<Key> passes constants,
+		// and since this is always inlined each instantiation folds into a
+		// straight sequence of reads; the sequential path tests at run time.
+		__attribute__((always_inline)) inline void decodeFields(std::istream& stream, unsigned parts, bool add,
+				OrdLogState& state)
+		{
+			if(parts & ExchangeTime)
+				state.exchangeTime += helpers::readGrowing(stream);
+			if(parts & OrderId)
+			{
+				if(add)
+				{
+					state.addOrderId += helpers::readGrowing(stream);
+					state.orderId = state.addOrderId;
+				}
+				else
+				{
+					state.orderId = state.addOrderId + helpers::readLeb128(stream);
+				}
+			}
+			else
+			{
+				state.orderId = state.addOrderId;
+			}
+			if(parts & OrderPrice)
+				state.orderPrice += helpers::readLeb128(stream);
+			if(parts & Volume)
+				state.volume = helpers::readLeb128(stream);
+			if(parts & VolumeLeft)
+				state.volumeLeft = helpers::readLeb128(stream);
+			if(parts & TradeId)
+				state.tradeId += helpers::readGrowing(stream);
+			if(parts & TradePrice)
+				state.tradePrice += helpers::readLeb128(stream);
+			if(parts & OpenInterest)
+				state.openInterest += helpers::readLeb128(stream);
+		}
+
+		inline void decodePartsSequential(std::istream& stream, int parts, uint16_t flags, OrdLogState& state)
+		{
+			decodeFields(stream, parts, (flags & AddFlag) != 0, state);
+		}
+
+		// Key layout: bits 0-7 are the parts byte, bit 8 is the Add flag
+		template <unsigned Key>
+		void decodeParts(std::istream& stream, OrdLogState& state)
+		{
+			decodeFields(stream, Key & 0xff, (Key & 0x100) != 0, state);
+		}
+
+		using PartsDecoder = void (*)(std::istream&, OrdLogState&);
+
+		static const unsigned PartsKeys = 512;
+
+		template <size_t... Keys>
+		constexpr std::array<PartsDecoder, sizeof...(Keys)> makePartsDecoders(std::index_sequence<Keys...>)
+		{
+			return {{ &decodeParts<Keys>... }};
+		}
+
+		inline unsigned partsKey(int parts, uint16_t flags)
+		{
+			return (parts & 0xff) | ((flags & AddFlag) ? 0x100 : 0);
+		}
+
+		inline PartsDecoder partsDecoder(int parts, uint16_t flags)
+		{
+			static constexpr std::array<PartsDecoder, PartsKeys> decoders =
+				makePartsDecoders(std::make_index_sequence<PartsKeys>());
+			return decoders[partsKey(parts, flags)];
+		}
+
+		inline void decodePartsTable(std::istream& stream, int parts, uint16_t flags, OrdLogState& state)
+		{
+			partsDecoder(parts, flags)(stream, state);
+		}
+
+		// All fields as LEB128, for saved decoder states and checkpoints
+		inline void writeState(std::ostream& stream, const OrdLogState& state)
+		{
+			int64_t fields[] = { state.exchangeTime, state.orderId, state.addOrderId, state.orderPrice, state.volume,
+				state.volumeLeft, state.tradeId, state.tradePrice, state.openInterest };
+			for(auto field : fields)
+				helpers::writeLeb128(stream, field);
+		}
+
+		inline OrdLogState readState(std::istream& stream)
+		{
+			OrdLogState state;
+			int64_t* fields[] = { &state.exchangeTime, &state.orderId, &state.addOrderId, &state.orderPrice,
+				&state.volume, &state.volumeLeft, &state.tradeId, &state.tradePrice, &state.openInterest };
+			for(auto field : fields)
+				*field = helpers::readLeb128(stream);
+			return state;
+		}
+	}
+}
+
+#endif /* ifndef ORDLOG_H */
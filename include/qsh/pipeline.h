@@ -0,0 +1,328 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "qshfile.h"
+
+namespace qsh
+{
+	// What a pipeline side does while the other one has to catch up
+	enum class Backpressure
+	{
+		Spin,	// busy-wait; lowest latency, burns a core
+		Yield,	// busy-wait with sched_yield
+		Block	// sleep on a condition variable
+	};
+
+	namespace pipeline
+	{
+		static const size_t CacheLineSize = 64;
+
+		inline void cpuRelax()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+		}
+
+		// Single-producer/single-consumer ring of preallocated slots. The
+		// producer fills a slot in place and publishes it; the consumer uses
+		// it in place and releases it. Head and tail live on separate cache
+		// lines, each side also keeps a private copy of the other's index.
+		template <typename T>
+		class SpscRing
+		{
+		public:
+			SpscRing(size_t capacity, Backpressure backpressure) : backpressure_(backpressure),
+				head_(0),
+				tail_(0),
+				producerWaiting_(false),
+				consumerWaiting_(false),
+				closed_(false),
+				cancelled_(false),
+				cachedTail_(0),
+				cachedHead_(0)
+			{
+				size_t size = 1;
+				while(size < capacity)
+					size <<= 1;
+				slots_.resize(size);
+				mask_ = size - 1;
+			}
+
+			std::vector<T>& slots()
+			{
+				return slots_;
+			}
+
+			// Returns nullptr if the consumer has cancelled
+			T* beginPush()
+			{
+				size_t head = head_.load(std::memory_order_relaxed);
+				if(head - cachedTail_ > mask_)
+				{
+					if(!wait(producerWaiting_, [&]() { return head - (cachedTail_ = tail_.load(std::memory_order_acquire)) <= mask_; }))
+						return nullptr;
+				}
+				return &slots_[head & mask_];
+			}
+
+			void endPush()
+			{
+				head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+				wake(consumerWaiting_);
+			}
+
+			// Returns nullptr once the producer has closed and the ring is empty,
+			// or after cancel()
+			T* beginPop()
+			{
+				size_t tail = tail_.load(std::memory_order_relaxed);
+				if(tail == cachedHead_)
+				{
+					if(!wait(consumerWaiting_, [&]() { return tail != (cachedHead_ = head_.load(std::memory_order_acquire)); }))
+					{
+						// Items published before close() must still be seen
+						if(cancelled_.load() || tail == (cachedHead_ = head_.load(std::memory_order_acquire)))
+							return nullptr;
+					}
+				}
+				return &slots_[tail & mask_];
+			}
+
+			void endPop()
+			{
+				tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+				wake(producerWaiting_);
+			}
+
+			// Producer side: no more items
+			void close()
+			{
+				closed_.store(true);
+				wake(consumerWaiting_, true);
+			}
+
+			// Either side: stop both
+			void cancel()
+			{
+				cancelled_.store(true);
+				wake(producerWaiting_, true);
+				wake(consumerWaiting_, true);
+			}
+
+		private:
+			// Returns false if the ring was closed or cancelled before 'ready'
+			template <typename Predicate>
+			bool wait(std::atomic<bool>& waiting, Predicate ready)
+			{
+				while(true)
+				{
+					if(ready())
+						return true;
+					if(cancelled_.load() || closed_.load())
+						return ready();
+
+					switch(backpressure_)
+					{
+						case Backpressure::Spin:
+							cpuRelax();
+							break;
+						case Backpressure::Yield:
+							std::this_thread::yield();
+							break;
+						case Backpressure::Block:
+						{
+							std::unique_lock<std::mutex> lock(mutex_);
+							waiting.store(true);
+							// Pairs with the index store and flag load in wake()
+							std::atomic_thread_fence(std::memory_order_seq_cst);
+							cond_.wait(lock, [&]() { return ready() || cancelled_.load() || closed_.load(); });
+							waiting.store(false);
+							break;
+						}
+					}
+				}
+			}
+
+			void wake(std::atomic<bool>& waiting, bool always = false)
+			{
+				if(backpressure_ == Backpressure::Block && (always || waiting.load()))
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					cond_.notify_all();
+				}
+			}
+
+		private:
+			Backpressure backpressure_;
+			std::vector<T> slots_;
+			size_t mask_;
+
+			char pad0_[CacheLineSize];
+			std::atomic<size_t> head_;
+			char pad1_[CacheLineSize - sizeof(std::atomic<size_t>)];
+			std::atomic<size_t> tail_;
+			char pad2_[CacheLineSize - sizeof(std::atomic<size_t>)];
+			std::atomic<bool> producerWaiting_;
+			std::atomic<bool> consumerWaiting_;
+			std::atomic<bool> closed_;
+			std::atomic<bool> cancelled_;
+			char pad3_[CacheLineSize];
+			size_t cachedTail_; // producer only
+			char pad4_[CacheLineSize - sizeof(size_t)];
+			size_t cachedHead_; // consumer only
+			char pad5_[CacheLineSize - sizeof(size_t)];
+
+			std::mutex mutex_;
+			std::condition_variable cond_;
+		};
+
+		struct Batch
+		{
+			size_t count;
+			std::vector<OrderLogEntry> entries;
+		};
+
+		struct Cancelled
+		{
+		};
+
+		// Runs on the decoder thread and packs entries into ring slots
+		class BatchProducer
+		{
+		public:
+			BatchProducer(SpscRing<Batch>& ring) : ring_(ring),
+				current_(nullptr)
+			{
+			}
+
+			void orderLogFrame(const OrderLogEntry& entry)
+			{
+				if(!current_)
+				{
+					current_ = ring_.beginPush();
+					if(!current_)
+						throw Cancelled();
+					current_->count = 0;
+				}
+				current_->entries[current_->count++] = entry;
+				if(current_->count == current_->entries.size())
+					flush();
+			}
+
+			void flush()
+			{
+				if(current_)
+				{
+					current_ = nullptr;
+					ring_.endPush();
+				}
+			}
+
+		private:
+			SpscRing<Batch>& ring_;
+			Batch* current_;
+		};
+	}
+
+	// Decodes on a separate thread and runs the sink on the calling thread.
+	// Entries travel in batches of 'batchSize' through a ring of 'batches'
+	// slots, all allocated up front.
+	template <typename Sink>
+	class PipelinedReader
+	{
+	public:
+		PipelinedReader(std::istream& stream, Sink& sink, Backpressure backpressure = Backpressure::Yield,
+				size_t batchSize = 256, size_t batches = 64) : sink_(sink),
+			ring_(batches, backpressure),
+			producer_(ring_),
+			file_(stream, producer_),
+			started_(false)
+		{
+			for(auto& batch : ring_.slots())
+			{
+				batch.count = 0;
+				batch.entries.resize(batchSize);
+			}
+		}
+
+		// Headers are parsed on construction; frames must be read through
+		// readAllFrames()
+		const QshFile<pipeline::BatchProducer>& file() const
+		{
+			return file_;
+		}
+
+		// Returns when the stream is exhausted. An exception thrown by the
+		// decoder or by the sink is rethrown here after both threads stopped;
+		// the entries decoded before a decoder error still reach the sink,
+		// as with QshFile. The ring is closed at the end, so this can only
+		// be called once per reader.
+		void readAllFrames()
+		{
+			if(started_)
+				throw std::runtime_error("PipelinedReader::readAllFrames() can only be called once");
+			started_ = true;
+
+			std::exception_ptr decoderError;
+			std::thread decoder([&]()
+					{
+						try
+						{
+							file_.readAllFrames();
+							producer_.flush();
+						}
+						catch(const pipeline::Cancelled&)
+						{
+						}
+						catch(...)
+						{
+							decoderError = std::current_exception();
+							// The entries of the partial batch come before the error
+							producer_.flush();
+						}
+						ring_.close();
+					});
+
+			try
+			{
+				while(pipeline::Batch* batch = ring_.beginPop())
+				{
+					for(size_t i = 0; i < batch->count; i++)
+						sink_.orderLogFrame(batch->entries[i]);
+					ring_.endPop();
+				}
+			}
+			catch(...)
+			{
+				ring_.cancel();
+				decoder.join();
+				throw;
+			}
+
+			decoder.join();
+			if(decoderError)
+				std::rethrow_exception(decoderError);
+		}
+
+	private:
+		Sink& sink_;
+		pipeline::SpscRing<pipeline::Batch> ring_;
+		pipeline::BatchProducer producer_;
+		QshFile<pipeline::BatchProducer> file_;
+		bool started_;
+	};
+}
+
+#endif /* ifndef PIPELINE_H */
@@ -2,22 +2,41 @@
 #ifndef QSHFILE_H
 #define QSHFILE_H
 
+#include <cstring>
 #include <iostream>
 #include <istream>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <chrono>
 
 #include "types.h"
+#include "ordlog.h"
+#include "stats.h"
 
 namespace qsh
 {
-	template <typename Sink>
+	// Where a QshFile is in its file: the offset of the next frame and the
+	// delta decoding state of every stream. Restoring it into a QshFile
+	// opened on the same file resumes decoding at that frame.
+	struct DecoderState
+	{
+		int64_t offset;
+		datetime_t lastTimestamp;
+		std::vector<OrdLogState> ordLogStates;	// by stream number
+	};
+
+	// Stats receives per-frame instrumentation hooks, see stats.h
+	template <typename Sink, typename Stats = NoStats>
 	class QshFile
 	{
 	public:
 
 		static const int SupportedVersion = 4;
+		static const int StateVersion = 2;
 
 		enum class StreamType
 		{
@@ -30,12 +49,16 @@ namespace qsh
 			OrdLog = 0x70
 		};
 
+		// The text fields point into the QshFile that parsed them and are
+		// valid until it is destroyed or opened on another file; copy them
+		// into strings to keep them longer
 		struct StreamId
 		{
 			StreamType type;
-			std::string connector;
-			std::string ticker;
-			std::string auxcode;
+			std::string_view code;	// the whole security id, "connector:ticker:auxcode:numId:step"
+			std::string_view connector;
+			std::string_view ticker;
+			std::string_view auxcode;
 			int numId;
 			double step;
 		};
@@ -55,40 +78,7 @@ namespace qsh
 			long openInterest;
 		};
 
-		struct OrderLogEntry
-		{
-			datetime_t frameTimestamp;
-
-			enum Flags
-			{
-				NonZeroReplAct = (1 << 0),
-				SessIdChanged = (1 << 1),
-				Add = (1 << 2),
-				Fill = (1 << 3),
-				Buy = (1 << 4),
-				Sell = (1 << 5),
-				Quote = (1 << 7),
-				Counter = (1 << 8),
-				NonSystem = (1 << 9),
-				EndOfTransaction = (1 << 10),
-				FillOrKill = (1 << 11),
-				Moved = (1 << 12),
-				Cancelled = (1 << 13),
-				CancelledGroup = (1 << 14),
-				CrossTrade = (1 << 15)
-			};
-
-			int streamNumber;
-			uint16_t flags;
-			datetime_t timestamp;
-			long long orderId;
-			decimal_fixed orderPrice;
-			int volume;
-			int remain;
-			long long matchingOrderId;
-			decimal_fixed tradePrice;
-			long openInterest;
-		};
+		using OrderLogEntry = qsh::OrderLogEntry;
 
 		struct Metadata
 		{
@@ -98,10 +88,39 @@ namespace qsh
 			int streamsNumber;
 		};
 
-		QshFile(std::istream& stream, Sink& sink) : stream_(stream),
-			sink_(sink)
+		QshFile(std::istream& stream, Sink& sink) : stream_(&stream),
+			sink_(sink),
+			partsDecoding_(ordlog::PartsDecoding::Table)
 		{
-			if(!stream_.good())
+			open(stream);
+		}
+
+		// Resumes from a blob made by saveState() on the same file: the
+		// headers come from the blob and the stream is positioned at the
+		// frame after the saved one, nothing before it is read
+		QshFile(std::istream& stream, Sink& sink, const std::string& state) : stream_(&stream),
+			sink_(sink),
+			partsDecoding_(ordlog::PartsDecoding::Table)
+		{
+			open(stream, state);
+		}
+
+		~QshFile()
+		{
+		}
+
+		QshFile(const QshFile&) = delete;
+		QshFile& operator=(const QshFile&) = delete;
+
+		// Starts over on another file. The headers are parsed into the
+		// buffers of the previous file, so a batch job that reuses one
+		// instance allocates next to nothing per file. The sink,
+		// parts decoding and stats are kept. After a throw the instance can
+		// only be opened again.
+		void open(std::istream& stream)
+		{
+			stream_ = &stream;
+			if(!stream_->good())
 				throw std::runtime_error("Unable to open stream");
 
 			readMetadata();
@@ -109,110 +128,286 @@ namespace qsh
 			readStreamHeaders();
 		}
 
-		~QshFile()
+		void open(std::istream& stream, const std::string& state)
+		{
+			stream_ = &stream;
+			if(!stream_->good())
+				throw std::runtime_error("Unable to open stream");
+
+			ids_.clear();
+			restoreState(state);
+		}
+
+		const std::vector<StreamId>& streams() const
+		{
+			return ids_;
+		}
+
+		const Metadata& getMetadata() const
+		{
+			return meta_;
+		}
+
+		void setPartsDecoding(ordlog::PartsDecoding decoding)
+		{
+			partsDecoding_ = decoding;
+		}
+
+		ordlog::PartsDecoding partsDecoding() const
 		{
+			return partsDecoding_;
 		}
 
-		std::vector<StreamId> streams() const
+		Stats& stats()
 		{
-			std::vector<StreamId> result;
+			return stats_;
+		}
+
+		const Stats& stats() const
+		{
+			return stats_;
+		}
+
+		DecoderState decoderState()
+		{
+			DecoderState result;
+			// At the end of the data, e.g. to resume once the file has grown
+			stream_->clear(stream_->rdstate() & ~std::ios_base::eofbit);
+			result.offset = stream_->tellg();
+			if(result.offset < 0)
+				throw std::runtime_error("Stream position unavailable");
+			result.lastTimestamp = lastTimestamp_;
 			for(const auto& stream : streams_)
+				result.ordLogStates.push_back(stream.ordLogState);
+			return result;
+		}
+
+		// Size of the underlying stream; the read position is kept
+		int64_t size()
+		{
+			stream_->clear(stream_->rdstate() & ~std::ios_base::eofbit);
+			std::streampos position = stream_->tellg();
+			stream_->seekg(0, std::ios_base::end);
+			int64_t result = stream_->tellg();
+			stream_->seekg(position);
+			if(position < 0 || result < 0 || stream_->fail())
+				throw std::runtime_error("Stream size unavailable");
+			return result;
+		}
+
+		void restoreDecoderState(const DecoderState& state)
+		{
+			if(state.ordLogStates.size() != streams_.size())
+				throw std::runtime_error("Decoder state does not match the streams");
+			stream_->clear();
+			stream_->seekg(state.offset);
+			if(stream_->fail())
+				throw std::runtime_error("Unable to seek");
+			lastTimestamp_ = state.lastTimestamp;
+			for(size_t i = 0; i < streams_.size(); i++)
+				streams_[i].ordLogState = state.ordLogStates[i];
+		}
+
+		// decoderState() together with the metadata and stream headers, as a
+		// binary blob of a few dozen bytes per stream:
+		//
+		//     "QSHSTATE" version, offset, last timestamp,
+		//     application name, comment, start time (8 bytes),
+		//     number of streams, per stream: type and security id, then per
+		//     stream the OrdLogState fields
+		//
+		// Integers are LEB128 and strings length-prefixed, as in the file.
+		std::string saveState()
+		{
+			DecoderState state = decoderState();
+			std::ostringstream out(std::ios_base::binary);
+			out.write("QSHSTATE", 8);
+			out.put(StateVersion);
+			helpers::writeLeb128(out, state.offset);
+			helpers::writeLeb128(out, state.lastTimestamp);
+			helpers::writeString(out, meta_.applicationName);
+			helpers::writeString(out, meta_.comment);
+			helpers::writeDatetime(out, meta_.startTime);
+			helpers::writeLeb128(out, ids_.size());
+			for(const auto& id : ids_)
 			{
-				result.push_back(stream.id);
+				out.put((char)id.type);
+				helpers::writeString(out, id.code);
 			}
-			return result;
+			for(const auto& ordLogState : state.ordLogStates)
+				ordlog::writeState(out, ordLogState);
+			return out.str();
 		}
 
-		Metadata getMetadata() const
+		// Loads a blob made by saveState() and seeks to its frame. If the
+		// headers were parsed already they must match the blob's.
+		void restoreState(const std::string& blob)
 		{
-			return meta_;
+			std::istringstream in(blob, std::ios_base::binary);
+			char magic[8];
+			in.read(magic, sizeof(magic));
+			if(!in.good() || memcmp(magic, "QSHSTATE", 8) != 0)
+				throw std::runtime_error("Invalid decoder state");
+			if(in.get() != StateVersion)
+				throw std::runtime_error("Unsupported decoder state version");
+
+			DecoderState state;
+			state.offset = helpers::readLeb128(in);
+			state.lastTimestamp = helpers::readLeb128(in);
+			Metadata meta;
+			meta.applicationName = readStateString(in, blob.size());
+			meta.comment = readStateString(in, blob.size());
+			meta.startTime = helpers::readDatetime(in);
+			int64_t count = helpers::readLeb128(in);
+			if(!in.good() || count < 0 || count > 255)
+				throw std::runtime_error("Invalid decoder state");
+			meta.streamsNumber = count;
+
+			std::vector<StreamType> types;
+			std::vector<std::string> codes;
+			for(int64_t i = 0; i < count; i++)
+			{
+				types.push_back((StreamType)in.get());
+				codes.push_back(readStateString(in, blob.size()));
+				if(!in.good())
+					throw std::runtime_error("Invalid decoder state");
+			}
+			for(int64_t i = 0; i < count; i++)
+				state.ordLogStates.push_back(ordlog::readState(in));
+			if(in.fail() || in.peek() != std::char_traits<char>::eof())
+				throw std::runtime_error("Invalid decoder state");
+
+			if(ids_.empty())
+			{
+				meta_ = meta;
+				ids_.resize(count);
+				codes_.clear();
+				codeEnds_.clear();
+				for(int64_t i = 0; i < count; i++)
+				{
+					ids_[i].type = types[i];
+					codes_ += codes[i];
+					codeEnds_.push_back(codes_.size());
+				}
+				parseStreamIds();
+			}
+			else
+			{
+				bool same = types.size() == ids_.size();
+				for(size_t i = 0; same && i < ids_.size(); i++)
+					same = types[i] == ids_[i].type && codes[i] == ids_[i].code;
+				if(!same)
+					throw std::runtime_error("Decoder state does not match the streams");
+			}
+			restoreDecoderState(state);
 		}
 
 		void readMetadata()
 		{
-			std::array<char, 128> buffer;
-			const std::string header = "QScalp History Data";
-			stream_.read(buffer.data(), header.size());
-			buffer[header.size()] = 0;
-			if(header.compare(buffer.data()) != 0)
+			static const char header[] = "QScalp History Data";
+			char buffer[sizeof(header) - 1];
+			stream_->read(buffer, sizeof(buffer));
+			if(!stream_->good() || memcmp(buffer, header, sizeof(buffer)) != 0)
 				throw std::runtime_error("Invalid header");
 
-			int version = stream_.get();
+			int version = stream_->get();
 			if(version != SupportedVersion)
 				throw std::runtime_error("Unsupported version");
 
-			meta_.applicationName = helpers::readString(stream_);
-			meta_.comment = helpers::readString(stream_);
-			meta_.startTime = helpers::readDatetime(stream_);
-			meta_.streamsNumber = stream_.get();
+			helpers::readString(*stream_, meta_.applicationName);
+			helpers::readString(*stream_, meta_.comment);
+			meta_.startTime = helpers::readDatetime(*stream_);
+			meta_.streamsNumber = stream_->get();
 			lastTimestamp_ = meta_.startTime / 10000;
 		}
 
+		// The security ids of all streams are read into one buffer first and
+		// then split into views, so parsing a header allocates nothing once
+		// the buffers have grown to the largest header seen
 		void readStreamHeaders()
 		{
-			for(auto i = 0; i < meta_.streamsNumber; i++)
+			size_t count = meta_.streamsNumber < 0 ? 0 : meta_.streamsNumber;
+			ids_.resize(count);
+			codes_.clear();
+			codeEnds_.clear();
+			for(size_t i = 0; i < count; i++)
 			{
-				StreamId id;
-				int type = stream_.get();
-				id.type = (StreamType)type;
-				auto code = helpers::readString(stream_);
-
-				auto colon = code.find(':');
-				if(colon == std::string::npos)
-					throw std::runtime_error("Unable to parse security id");
-				id.connector = code.substr(0, colon);
-				auto start = colon + 1;
-
-				colon = code.find(':', start);
-				if(colon == std::string::npos)
-					throw std::runtime_error("Unable to parse security id");
-				id.ticker = code.substr(start, colon - start);
-				start = colon + 1;
-
-				colon = code.find(':', start);
-				if(colon == std::string::npos)
-					throw std::runtime_error("Unable to parse security id");
-				id.auxcode = code.substr(start, colon - start);
-				start = colon + 1;
-
-				colon = code.find(':', start);
-				if(colon == std::string::npos)
-					throw std::runtime_error("Unable to parse security id");
-				id.numId = std::stoi(code.substr(start, colon - start));
-				start = colon + 1;
-
-				id.step = std::stod(code.substr(start));
-				start = colon + 1;
-
-				StreamDescriptor descriptor = {};
-				descriptor.id = id;
-
-				streams_.push_back(descriptor);
+				ids_[i].type = (StreamType)stream_->get();
+				uint32_t length = helpers::readULeb128(*stream_);
+				size_t start = codes_.size();
+				codes_.resize(start + length);
+				stream_->read(&codes_[start], length);
+				codeEnds_.push_back(codes_.size());
 			}
-
+			if(stream_->fail())
+				throw std::runtime_error("Truncated header");
+			parseStreamIds();
 		}
 
 		void readAllFrames()
 		{
-			while(!stream_.eof())
+			while(!stream_->eof())
 			{
-				if(stream_.peek() == std::char_traits<char>::eof())
+				if(stream_->peek() == std::char_traits<char>::eof())
 					break;
 				readOneFrame();
 			}
 		}
 
+		// Reads the frames that are completely available and returns their
+		// number. A frame cut short by the end of the stream is not consumed:
+		// the stream is rewound to its start, so the call can be repeated once
+		// more data has been appended.
+		size_t readAvailableFrames()
+		{
+			size_t frames = 0;
+			while(true)
+			{
+				stream_->clear();
+				auto position = stream_->tellg();
+				if(stream_->peek() == std::char_traits<char>::eof())
+				{
+					stream_->clear();
+					break;
+				}
+
+				auto timestamp = lastTimestamp_;
+				try
+				{
+					readOneFrame();
+				}
+				catch(const std::runtime_error&)
+				{
+					if(!stream_->eof())
+						throw;
+					lastTimestamp_ = timestamp;
+					stream_->clear();
+					stream_->seekg(position);
+					break;
+				}
+				frames++;
+			}
+			return frames;
+		}
+
 		void readOneFrame()
 		{
-			auto datetime = helpers::readGrowing(stream_);
+			stats_.frameBegin();
+			auto datetime = helpers::readGrowing(*stream_);
 			lastTimestamp_ += datetime;
 			int streamNumber = 0;
 			if(streams_.size() > 1)
 			{
-				streamNumber = stream_.get();
+				streamNumber = stream_->get();
 			}
 
-			currentStreamType_ = streams_[streamNumber].id.type;
+			if(stream_->fail())
+				throw std::runtime_error("Truncated frame");
+			if(streamNumber < 0 || (size_t)streamNumber >= streams_.size())
+				throw std::runtime_error("Invalid stream number");
+
+			stats_.frameHeader(streamNumber, datetime, streams_.size() > 1);
+			currentStreamType_ = ids_[streamNumber].type;
 
 			switch(currentStreamType_)
 			{
@@ -222,47 +417,35 @@ namespace qsh
 				default:
 					throw std::runtime_error("Unsupported entry");
 			}
+			stats_.frameEnd();
 		}
 
 		void parseOrdLogEntry(int streamNumber)
 		{
 			auto& currentStream = streams_[streamNumber];
-			int parts = stream_.get();
-			uint16_t flags = stream_.get();
-			flags |= ((uint16_t)stream_.get() << 8);
-
-			if(parts & (1 << 0))
-				currentStream.ordLogState.exchangeTime += helpers::readGrowing(stream_);
-			if(parts & (1 << 1))
-			{
-				if(flags & OrderLogEntry::Add)
-				{
-					currentStream.ordLogState.orderId += helpers::readGrowing(stream_);
-				}
-				else
-				{
-					currentStream.ordLogState.orderId += helpers::readLeb128(stream_);
-				}
-			}
-			if(parts & (1 << 2))
-				currentStream.ordLogState.orderPrice += helpers::readLeb128(stream_);
-			if(parts & (1 << 3))
-				currentStream.ordLogState.volume = helpers::readLeb128(stream_);
-			if(parts & (1 << 4))
-				currentStream.ordLogState.volumeLeft = helpers::readLeb128(stream_);
-			if(parts & (1 << 5))
-				currentStream.ordLogState.tradeId += helpers::readGrowing(stream_);
-			if(parts & (1 << 6))
-				currentStream.ordLogState.tradePrice += helpers::readLeb128(stream_);
-			if(parts & (1 << 7))
-				currentStream.ordLogState.openInterest += helpers::readLeb128(stream_);
+			int parts = stream_->get();
+			uint16_t flags = stream_->get();
+			flags |= ((uint16_t)stream_->get() << 8);
+
+			// Decode into a copy so that a truncated frame leaves the state intact
+			OrdLogState state = currentStream.ordLogState;
+			if(partsDecoding_ == ordlog::PartsDecoding::Table)
+				ordlog::decodePartsTable(*stream_, parts, flags, state);
+			else
+				ordlog::decodePartsSequential(*stream_, parts, flags, state);
+
+			if(stream_->fail())
+				throw std::runtime_error("Truncated frame");
+			stats_.ordLogFrame(streamNumber, parts, flags, currentStream.ordLogState, state);
+			currentStream.ordLogState = state;
 
 			OrderLogEntry entry;
 			entry.frameTimestamp = lastTimestamp_;
+			entry.streamNumber = streamNumber;
 			entry.flags = flags;
 			entry.timestamp = currentStream.ordLogState.exchangeTime;
 			entry.orderId = currentStream.ordLogState.orderId;
-			double p = currentStream.ordLogState.orderPrice * currentStream.id.step;
+			double p = currentStream.ordLogState.orderPrice * ids_[streamNumber].step;
 			entry.orderPrice = decimal_fixed(floor(p), (p - floor(p)) * 1000000000);
 			entry.volume = currentStream.ordLogState.volume;
 			entry.remain = 0;
@@ -275,42 +458,86 @@ namespace qsh
 				entry.remain = entry.volume;
 			}
 			entry.matchingOrderId = (flags & OrderLogEntry::Fill) ? currentStream.ordLogState.tradeId : 0;
-			p = currentStream.ordLogState.tradePrice * currentStream.id.step;
+			p = currentStream.ordLogState.tradePrice * ids_[streamNumber].step;
 			entry.tradePrice = (flags & OrderLogEntry::Fill) ? decimal_fixed(floor(p), (p - floor(p)) * 1000000000) : decimal_fixed();
 			entry.openInterest = (flags & OrderLogEntry::Fill)? currentStream.ordLogState.openInterest : 0;
 
+			stats_.sinkBegin();
 			sink_.orderLogFrame(entry);
+			stats_.sinkEnd();
 		}
 
 
 	private:
 		struct StreamDescriptor
 		{
-			StreamId id;
-
 			union
 			{
-				struct
-				{
-					datetime_t exchangeTime;
-					int64_t orderId;
-					int64_t orderPrice;
-					int64_t volume;
-					int64_t volumeLeft;
-					int64_t tradeId;
-					int64_t tradePrice;
-					int64_t openInterest;
-				} ordLogState;
+				OrdLogState ordLogState;
 			};
 		};
 
+		// Lengths are checked against the blob, so that a corrupted one
+		// cannot ask for a huge allocation
+		static std::string readStateString(std::istream& stream, size_t limit)
+		{
+			uint32_t length = helpers::readULeb128(stream);
+			if(!stream.good() || length > limit)
+				throw std::runtime_error("Invalid decoder state");
+			std::string result(length, 0);
+			stream.read(&result[0], length);
+			return result;
+		}
+
+		// "connector:ticker:auxcode:numId:step"
+		static void parseSecurityId(std::string_view code, StreamId& id)
+		{
+			std::string_view fields[4];
+			size_t start = 0;
+			for(auto& field : fields)
+			{
+				auto colon = code.find(':', start);
+				if(colon == std::string_view::npos)
+					throw std::runtime_error("Unable to parse security id");
+				field = code.substr(start, colon - start);
+				start = colon + 1;
+			}
+			id.code = code;
+			id.connector = fields[0];
+			id.ticker = fields[1];
+			id.auxcode = fields[2];
+			if(!helpers::parseNumber(fields[3], id.numId) || !helpers::parseNumber(code.substr(start), id.step))
+				throw std::runtime_error("Unable to parse security id");
+		}
+
+		// Points ids_ into codes_, split at codeEnds_, and resets the
+		// decoding state of every stream
+		void parseStreamIds()
+		{
+			std::string_view codes(codes_);
+			size_t start = 0;
+			for(size_t i = 0; i < ids_.size(); i++)
+			{
+				parseSecurityId(codes.substr(start, codeEnds_[i] - start), ids_[i]);
+				start = codeEnds_[i];
+			}
+			streams_.resize(ids_.size());
+			for(auto& stream : streams_)
+				stream.ordLogState = OrdLogState();
+		}
+
 	private:
 		datetime_t lastTimestamp_;
-		std::istream& stream_;
+		std::istream* stream_;
 		Sink& sink_;
-		std::vector<StreamDescriptor> streams_;
+		std::vector<StreamId> ids_;
+		std::vector<StreamDescriptor> streams_;	// by stream number, as ids_
+		std::string codes_;	// security ids of all streams, back to back
+		std::vector<size_t> codeEnds_;
 		Metadata meta_;
 		StreamType currentStreamType_;
+		ordlog::PartsDecoding partsDecoding_;
+		Stats stats_;
 	};
 }
 
@@ -0,0 +1,114 @@
+#ifndef QSHWRITER_H
+#define QSHWRITER_H
+
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "ordlog.h"
+
+namespace qsh
+{
+	// Encoder for the subset of the format that QshFile can read: version 4
+	// files with OrdLog streams. Used to produce synthetic data sets.
+	class QshWriter
+	{
+	public:
+		static const int Version = 4;
+		static const int OrdLogStreamType = 0x70;
+
+		QshWriter(std::ostream& stream, const std::string& applicationName, const std::string& comment,
+				datetime_t startTime, const std::vector<std::string>& securityCodes) : stream_(stream),
+			lastTimestamp_(startTime / 10000),
+			streams_(securityCodes.size(), OrdLogState())
+		{
+			if(securityCodes.empty() || securityCodes.size() > 255)
+				throw std::runtime_error("Invalid number of streams");
+
+			const std::string header = "QScalp History Data";
+			stream_.write(header.data(), header.size());
+			stream_.put(Version);
+			helpers::writeString(stream_, applicationName);
+			helpers::writeString(stream_, comment);
+			helpers::writeDatetime(stream_, startTime);
+			stream_.put(securityCodes.size());
+
+			for(const auto& code : securityCodes)
+			{
+				stream_.put(OrdLogStreamType);
+				helpers::writeString(stream_, code);
+			}
+		}
+
+		// frameTimestamp is in milliseconds, as in OrderLogEntry::frameTimestamp.
+		// Only the fields that differ from the previous frame of the stream are
+		// written, which is what QScalp itself does.
+		void writeOrdLogFrame(int streamNumber, datetime_t frameTimestamp, uint16_t flags, const OrdLogState& state)
+		{
+			helpers::writeGrowing(stream_, frameTimestamp - lastTimestamp_);
+			lastTimestamp_ = frameTimestamp;
+			if(streams_.size() > 1)
+				stream_.put(streamNumber);
+
+			// state.addOrderId is ignored, the writer tracks it
+			OrdLogState& last = streams_[streamNumber];
+			bool add = (flags & ordlog::AddFlag) != 0;
+			int parts = 0;
+			if(state.exchangeTime != last.exchangeTime)
+				parts |= ordlog::ExchangeTime;
+			if(state.orderId != last.addOrderId)
+				parts |= ordlog::OrderId;
+			if(state.orderPrice != last.orderPrice)
+				parts |= ordlog::OrderPrice;
+			if(state.volume != last.volume)
+				parts |= ordlog::Volume;
+			if(state.volumeLeft != last.volumeLeft)
+				parts |= ordlog::VolumeLeft;
+			if(state.tradeId != last.tradeId)
+				parts |= ordlog::TradeId;
+			if(state.tradePrice != last.tradePrice)
+				parts |= ordlog::TradePrice;
+			if(state.openInterest != last.openInterest)
+				parts |= ordlog::OpenInterest;
+
+			stream_.put(parts);
+			stream_.put(flags & 0xff);
+			stream_.put(flags >> 8);
+
+			if(parts & ordlog::ExchangeTime)
+				helpers::writeGrowing(stream_, state.exchangeTime - last.exchangeTime);
+			if(parts & ordlog::OrderId)
+			{
+				if(add)
+					helpers::writeGrowing(stream_, state.orderId - last.addOrderId);
+				else
+					helpers::writeLeb128(stream_, state.orderId - last.addOrderId);
+			}
+			if(parts & ordlog::OrderPrice)
+				helpers::writeLeb128(stream_, state.orderPrice - last.orderPrice);
+			if(parts & ordlog::Volume)
+				helpers::writeLeb128(stream_, state.volume);
+			if(parts & ordlog::VolumeLeft)
+				helpers::writeLeb128(stream_, state.volumeLeft);
+			if(parts & ordlog::TradeId)
+				helpers::writeGrowing(stream_, state.tradeId - last.tradeId);
+			if(parts & ordlog::TradePrice)
+				helpers::writeLeb128(stream_, state.tradePrice - last.tradePrice);
+			if(parts & ordlog::OpenInterest)
+				helpers::writeLeb128(stream_, state.openInterest - last.openInterest);
+
+			int64_t addOrderId = add ? state.orderId : last.addOrderId;
+			last = state;
+			last.addOrderId = addOrderId;
+		}
+
+	private:
+		std::ostream& stream_;
+		datetime_t lastTimestamp_;
+		std::vector<OrdLogState> streams_;
+	};
+}
+
+#endif /* ifndef QSHWRITER_H */
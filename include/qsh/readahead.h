@@ -0,0 +1,628 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define QSH_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+namespace qsh
+{
+	namespace io
+	{
+		struct Block
+		{
+			const char* data;
+			size_t size; // 0 at the end of the file
+		};
+
+		// Delivers consecutive blocks of a file in order while later blocks
+		// are being read. A block stays valid until the next call to next().
+		class BlockReader
+		{
+		public:
+			virtual ~BlockReader()
+			{
+			}
+
+			virtual Block next() = 0;
+			virtual void restart(uint64_t offset) = 0;
+			virtual const char* name() const = 0;
+		};
+
+		// Reads until 'size' bytes are in or the file ends
+		inline size_t preadFully(int fd, char* buffer, size_t size, uint64_t offset)
+		{
+			size_t done = 0;
+			while(done < size)
+			{
+				ssize_t result = ::pread(fd, buffer + done, size - done, offset + done);
+				if(result < 0)
+				{
+					if(errno == EINTR)
+						continue;
+					throw std::runtime_error("Read error");
+				}
+				if(result == 0)
+					break;
+				done += result;
+			}
+			return done;
+		}
+
+		// Fallback: one background thread issues blocking preads into a ring
+		// of buffers ahead of the consumer
+		class ThreadBlockReader : public BlockReader
+		{
+		public:
+			ThreadBlockReader(int fd, size_t blockSize, unsigned depth) : fd_(fd),
+				blockSize_(blockSize),
+				slots_(depth)
+			{
+				for(auto& slot : slots_)
+					slot.buffer.resize(blockSize);
+				restart(0);
+			}
+
+			~ThreadBlockReader()
+			{
+				stopWorker();
+			}
+
+			Block next() override
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				if(holding_)
+				{
+					slots_[consumer_ % slots_.size()].filled = false;
+					consumer_++;
+					holding_ = false;
+					cond_.notify_all();
+				}
+				if(eof_)
+					return Block { nullptr, 0 };
+
+				auto& slot = slots_[consumer_ % slots_.size()];
+				cond_.wait(lock, [&]() { return slot.filled || error_; });
+				if(error_)
+					throw std::runtime_error("Read error");
+				holding_ = true;
+				eof_ = slot.size < blockSize_;
+				return Block { slot.buffer.data(), slot.size };
+			}
+
+			void restart(uint64_t offset) override
+			{
+				stopWorker();
+				for(auto& slot : slots_)
+					slot.filled = false;
+				consumer_ = 0;
+				holding_ = false;
+				eof_ = false;
+				stop_ = false;
+				error_ = false;
+				worker_ = std::thread([this, offset]() { run(offset); });
+			}
+
+			const char* name() const override
+			{
+				return "thread";
+			}
+
+		private:
+			struct Slot
+			{
+				std::vector<char> buffer;
+				size_t size;
+				bool filled;
+			};
+
+			void run(uint64_t offset)
+			{
+				for(uint64_t producer = 0; ; producer++)
+				{
+					auto& slot = slots_[producer % slots_.size()];
+					{
+						std::unique_lock<std::mutex> lock(mutex_);
+						cond_.wait(lock, [&]() { return !slot.filled || stop_; });
+						if(stop_)
+							return;
+					}
+
+					size_t size = 0;
+					bool failed = false;
+					try
+					{
+						size = preadFully(fd_, slot.buffer.data(), blockSize_, offset);
+					}
+					catch(const std::runtime_error&)
+					{
+						failed = true;
+					}
+					offset += size;
+
+					std::unique_lock<std::mutex> lock(mutex_);
+					slot.size = size;
+					slot.filled = true;
+					error_ = failed;
+					cond_.notify_all();
+					if(size < blockSize_ || failed)
+						return;
+				}
+			}
+
+			void stopWorker()
+			{
+				if(worker_.joinable())
+				{
+					{
+						std::unique_lock<std::mutex> lock(mutex_);
+						stop_ = true;
+						cond_.notify_all();
+					}
+					worker_.join();
+				}
+			}
+
+		private:
+			int fd_;
+			size_t blockSize_;
+			std::vector<Slot> slots_;
+			uint64_t consumer_;
+			bool holding_;
+			bool eof_;
+			bool stop_;
+			bool error_;
+			std::mutex mutex_;
+			std::condition_variable cond_;
+			std::thread worker_;
+		};
+
+#ifdef QSH_HAVE_IO_URING
+		// Keeps one read per buffer in flight through io_uring. Uses raw
+		// syscalls, so liburing is not required. Completions may arrive out of
+		// order; blocks are still handed out in file order.
+		class UringBlockReader : public BlockReader
+		{
+		public:
+			UringBlockReader(int fd, size_t blockSize, unsigned depth) : fd_(fd),
+				blockSize_(blockSize),
+				slots_(depth),
+				ring_(-1),
+				sqRing_(MAP_FAILED),
+				cqRing_(MAP_FAILED),
+				sqes_(MAP_FAILED)
+			{
+				struct io_uring_params params;
+				memset(&params, 0, sizeof(params));
+				ring_ = syscall(__NR_io_uring_setup, depth, &params);
+				if(ring_ < 0)
+					throw std::runtime_error("io_uring is not available");
+
+				sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+				cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+				bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if(single)
+					sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+				sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQ_RING);
+				if(sqRing_ != MAP_FAILED)
+				{
+					cqRing_ = single ? sqRing_ :
+						mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_CQ_RING);
+				}
+				if(cqRing_ != MAP_FAILED)
+				{
+					sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+					sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQES);
+				}
+				if(sqes_ == MAP_FAILED)
+				{
+					release();
+					throw std::runtime_error("Unable to map io_uring");
+				}
+
+				char* sq = static_cast<char*>(sqRing_);
+				sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+				sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+				sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+				char* cq = static_cast<char*>(cqRing_);
+				cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+				cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+				cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+				cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+				for(auto& slot : slots_)
+				{
+					slot.buffer.resize(blockSize);
+					slot.iov.iov_base = slot.buffer.data();
+					slot.iov.iov_len = blockSize;
+					slot.pending = false;
+				}
+				inFlight_ = 0;
+				restart(0);
+			}
+
+			~UringBlockReader()
+			{
+				drain();
+				release();
+			}
+
+			Block next() override
+			{
+				if(holding_)
+				{
+					holding_ = false;
+					consumer_++;
+					if(!eof_)
+						submit((consumer_ + slots_.size() - 1) % slots_.size());
+				}
+
+				auto& slot = slots_[consumer_ % slots_.size()];
+				if(eof_ && slot.offset >= eofOffset_)
+					return Block { nullptr, 0 };
+				while(slot.pending)
+					reap(true);
+				if(slot.result < 0)
+					throw std::runtime_error("Read error");
+
+				size_t size = slot.result;
+				if(size > 0 && size < blockSize_)
+					size += preadFully(fd_, slot.buffer.data() + size, blockSize_ - size, slot.offset + size);
+				if(size < blockSize_)
+				{
+					eof_ = true;
+					eofOffset_ = slot.offset + size;
+				}
+				holding_ = true;
+				return Block { slot.buffer.data(), size };
+			}
+
+			void restart(uint64_t offset) override
+			{
+				drain();
+				consumer_ = 0;
+				holding_ = false;
+				eof_ = false;
+				eofOffset_ = 0;
+				nextOffset_ = offset;
+				for(size_t i = 0; i < slots_.size(); i++)
+					submit(i);
+			}
+
+			const char* name() const override
+			{
+				return "io_uring";
+			}
+
+		private:
+			struct Slot
+			{
+				std::vector<char> buffer;
+				struct iovec iov;
+				uint64_t offset;
+				int result;
+				bool pending;
+			};
+
+			void submit(size_t index)
+			{
+				auto& slot = slots_[index];
+				slot.offset = nextOffset_;
+				slot.pending = true;
+				nextOffset_ += blockSize_;
+
+				unsigned tail = *sqTail_;
+				unsigned sqeIndex = tail & sqMask_;
+				struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes_) + sqeIndex;
+				memset(sqe, 0, sizeof(*sqe));
+				sqe->opcode = IORING_OP_READV;
+				sqe->fd = fd_;
+				sqe->off = slot.offset;
+				sqe->addr = reinterpret_cast<uint64_t>(&slot.iov);
+				sqe->len = 1;
+				sqe->user_data = index;
+				sqArray_[sqeIndex] = sqeIndex;
+				__atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+
+				inFlight_++;
+				while(syscall(__NR_io_uring_enter, ring_, 1, 0, 0, nullptr, 0) < 0)
+				{
+					if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+						throw std::runtime_error("io_uring_enter failed");
+					reap(false);
+				}
+			}
+
+			void reap(bool wait)
+			{
+				unsigned head = *cqHead_;
+				if(head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+				{
+					if(!wait)
+						return;
+					if(syscall(__NR_io_uring_enter, ring_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+						throw std::runtime_error("io_uring_enter failed");
+				}
+
+				unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+				for(; head != tail; head++)
+				{
+					const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+					auto& slot = slots_[cqe.user_data];
+					slot.result = cqe.res;
+					slot.pending = false;
+					inFlight_--;
+				}
+				__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+			}
+
+			// Buffers must not be reused while the kernel may still write them
+			void drain()
+			{
+				while(inFlight_ > 0)
+					reap(true);
+			}
+
+			void release()
+			{
+				if(sqes_ != MAP_FAILED)
+					munmap(sqes_, sqesSize_);
+				if(cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+					munmap(cqRing_, cqRingSize_);
+				if(sqRing_ != MAP_FAILED)
+					munmap(sqRing_, sqRingSize_);
+				if(ring_ >= 0)
+					::close(ring_);
+			}
+
+		private:
+			int fd_;
+			size_t blockSize_;
+			std::vector<Slot> slots_;
+			int ring_;
+			void* sqRing_;
+			void* cqRing_;
+			void* sqes_;
+			size_t sqRingSize_;
+			size_t cqRingSize_;
+			size_t sqesSize_;
+			unsigned* sqTail_;
+			unsigned sqMask_;
+			unsigned* sqArray_;
+			unsigned* cqHead_;
+			unsigned* cqTail_;
+			unsigned cqMask_;
+			struct io_uring_cqe* cqes_;
+			size_t inFlight_;
+			uint64_t consumer_;
+			uint64_t nextOffset_;
+			uint64_t eofOffset_;
+			bool holding_;
+			bool eof_;
+		};
+#endif
+	}
+
+	// Input buffer that overlaps file reads with decoding: 'depth' reads of
+	// 'blockSize' bytes are kept in flight and consumed in order. Use it as
+	//
+	//     ReadAheadStreambuf buffer(path);
+	//     std::istream stream(&buffer);
+	//     QshFile<Sink> file(stream, sink);
+	class ReadAheadStreambuf : public std::streambuf
+	{
+	public:
+		enum class Backend
+		{
+			Auto,
+			IoUring,
+			Thread
+		};
+
+		ReadAheadStreambuf(const std::string& path, size_t blockSize = 1 << 20, unsigned depth = 4,
+				Backend backend = Backend::Auto) : fd_(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+			blockOffset_(0),
+			blockSize_(0)
+		{
+			if(fd_ < 0)
+				throw std::runtime_error("Unable to open " + path);
+			if(blockSize == 0 || depth < 2)
+			{
+				::close(fd_);
+				throw std::runtime_error("Invalid read-ahead parameters");
+			}
+
+#ifdef QSH_HAVE_IO_URING
+			if(backend != Backend::Thread)
+			{
+				try
+				{
+					reader_.reset(new io::UringBlockReader(fd_, blockSize, depth));
+				}
+				catch(const std::runtime_error&)
+				{
+					if(backend == Backend::IoUring)
+					{
+						::close(fd_);
+						throw;
+					}
+				}
+			}
+#else
+			if(backend == Backend::IoUring)
+			{
+				::close(fd_);
+				throw std::runtime_error("io_uring is not available");
+			}
+#endif
+			if(!reader_)
+				reader_.reset(new io::ThreadBlockReader(fd_, blockSize, depth));
+			setg(nullptr, nullptr, nullptr);
+		}
+
+		~ReadAheadStreambuf()
+		{
+			reader_.reset();
+			::close(fd_);
+		}
+
+		ReadAheadStreambuf(const ReadAheadStreambuf&) = delete;
+		ReadAheadStreambuf& operator=(const ReadAheadStreambuf&) = delete;
+
+		const char* backendName() const
+		{
+			return reader_->name();
+		}
+
+	protected:
+		int_type underflow() override
+		{
+			if(gptr() < egptr())
+				return traits_type::to_int_type(*gptr());
+
+			blockOffset_ += blockSize_;
+			io::Block block = reader_->next();
+			blockSize_ = block.size;
+			if(block.size == 0)
+			{
+				setg(nullptr, nullptr, nullptr);
+				return traits_type::eof();
+			}
+			char* data = const_cast<char*>(block.data);
+			setg(data, data, data + block.size);
+			return traits_type::to_int_type(*gptr());
+		}
+
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+		{
+			if(!(which & std::ios_base::in))
+				return pos_type(off_type(-1));
+
+			uint64_t current = blockOffset_ + (gptr() - eback());
+			if(dir == std::ios_base::cur)
+			{
+				if(off == 0)
+					return pos_type(current);
+				return seekpos(pos_type(current + off), which);
+			}
+			if(dir == std::ios_base::beg)
+				return seekpos(pos_type(off), which);
+
+			struct stat st;
+			if(fstat(fd_, &st) < 0)
+				return pos_type(off_type(-1));
+			return seekpos(pos_type(st.st_size + off), which);
+		}
+
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+		{
+			if(!(which & std::ios_base::in) || off_type(pos) < 0)
+				return pos_type(off_type(-1));
+
+			uint64_t target = off_type(pos);
+			if(target >= blockOffset_ && target <= blockOffset_ + blockSize_ && eback() != nullptr)
+			{
+				setg(eback(), eback() + (target - blockOffset_), egptr());
+				return pos;
+			}
+
+			reader_->restart(target);
+			blockOffset_ = target;
+			blockSize_ = 0;
+			setg(nullptr, nullptr, nullptr);
+			return pos;
+		}
+
+	private:
+		int fd_;
+		std::unique_ptr<io::BlockReader> reader_;
+		uint64_t blockOffset_;
+		size_t blockSize_;
+	};
+
+	// Input buffer over a read-only mapping of the whole file
+	class MmapStreambuf : public std::streambuf
+	{
+	public:
+		explicit MmapStreambuf(const std::string& path) : data_(nullptr),
+			size_(0)
+		{
+			int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if(fd < 0)
+				throw std::runtime_error("Unable to open " + path);
+			struct stat st;
+			if(fstat(fd, &st) < 0)
+			{
+				::close(fd);
+				throw std::runtime_error("Unable to stat " + path);
+			}
+			size_ = st.st_size;
+			if(size_ > 0)
+			{
+				void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(data == MAP_FAILED)
+				{
+					::close(fd);
+					throw std::runtime_error("Unable to map " + path);
+				}
+				madvise(data, size_, MADV_SEQUENTIAL);
+				data_ = static_cast<char*>(data);
+			}
+			::close(fd);
+			setg(data_, data_, data_ + size_);
+		}
+
+		~MmapStreambuf()
+		{
+			if(data_)
+				munmap(data_, size_);
+		}
+
+		MmapStreambuf(const MmapStreambuf&) = delete;
+		MmapStreambuf& operator=(const MmapStreambuf&) = delete;
+
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+		{
+			off_type base = (dir == std::ios_base::beg) ? 0 : (dir == std::ios_base::cur) ? gptr() - eback() : size_;
+			return seekpos(pos_type(base + off), which);
+		}
+
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+		{
+			if(!(which & std::ios_base::in) || off_type(pos) < 0 || (size_t)off_type(pos) > size_)
+				return pos_type(off_type(-1));
+			setg(data_, data_ + off_type(pos), data_ + size_);
+			return pos;
+		}
+
+	private:
+		char* data_;
+		size_t size_;
+	};
+}
+
+#endif /* ifndef READAHEAD_H */
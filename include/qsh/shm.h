@@ -0,0 +1,453 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "types.h"
+
+namespace qsh
+{
+	namespace shm
+	{
+		static const uint64_t Magic = 0x324e41462d485351ull; // "QSH-FAN2"
+
+		// Fixed-size form of OrderLogEntry. Prices are in 1e-9 units, which
+		// covers prices up to about 9.2e9.
+		struct Event
+		{
+			std::atomic<uint64_t> sequence; // sequence number + 1, 0 while being written
+			int64_t frameTimestamp;
+			int64_t timestamp;
+			int64_t orderId;
+			int64_t matchingOrderId;
+			int64_t orderPrice;
+			int64_t tradePrice;
+			int64_t openInterest;
+			int32_t volume;
+			int32_t remain;
+			uint16_t flags;
+			uint16_t streamNumber;
+		};
+
+		enum ReaderState
+		{
+			Free = 0,
+			Active = 1,
+			Evicted = 2,
+			Attaching = 3
+		};
+
+		struct alignas(64) ReaderSlot
+		{
+			std::atomic<uint32_t> state;
+			std::atomic<int32_t> owner; // pid of the subscriber, 0 while Free
+			std::atomic<uint64_t> cursor; // next sequence the reader will consume
+		};
+
+		// False only if the process is known to be gone; a pid reused by
+		// another process keeps its slot until that one exits
+		inline bool alive(int32_t pid)
+		{
+			return pid <= 0 || kill(pid, 0) == 0 || errno != ESRCH;
+		}
+
+		struct alignas(64) Header
+		{
+			std::atomic<uint64_t> magic; // written last by the publisher
+			uint64_t capacity;
+			uint64_t maxLag;
+			uint32_t maxReaders;
+			std::atomic<uint32_t> finished;
+			alignas(64) std::atomic<uint64_t> head; // number of published events
+		};
+
+		inline size_t regionSize(uint64_t capacity, uint32_t maxReaders)
+		{
+			return sizeof(Header) + maxReaders * sizeof(ReaderSlot) + capacity * sizeof(Event);
+		}
+
+		inline ReaderSlot* readerSlots(Header* header)
+		{
+			return reinterpret_cast<ReaderSlot*>(header + 1);
+		}
+
+		inline Event* events(Header* header)
+		{
+			return reinterpret_cast<Event*>(readerSlots(header) + header->maxReaders);
+		}
+
+		struct PublisherOptions
+		{
+			uint64_t capacity = 1 << 16; // events, rounded up to a power of two
+			uint64_t maxLag = 1 << 16; // at most capacity
+			uint32_t maxReaders = 32;
+			std::chrono::milliseconds stallTimeout = std::chrono::milliseconds(1000);
+			// Removes a segment of the same name first. Only for segments left
+			// behind by a publisher that crashed: a live publisher would lose
+			// its readers. Without it an existing segment is an error.
+			bool replaceExisting = false;
+		};
+
+		inline void backoff(unsigned& spins)
+		{
+			if(++spins < 64)
+				return;
+			if(spins < 256)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+	// Decodes once, consumed by many processes. Use as the sink of a QshFile;
+	// events go to a ring in POSIX shared memory (/dev/shm/<name>) that
+	// ShmSubscriber instances attach to.
+	//
+	// The publisher stays at most 'maxLag' events ahead of every attached
+	// reader. A reader that stays that far behind for longer than
+	// 'stallTimeout' is evicted, so one stuck process delays the others by at
+	// most that long. With a zero timeout the publisher never waits.
+	class ShmPublisher
+	{
+	public:
+		using Options = shm::PublisherOptions;
+
+		ShmPublisher(const std::string& name, const Options& options = Options()) : name_(name),
+			options_(options),
+			header_(nullptr),
+			head_(0),
+			minCursor_(0)
+		{
+			uint64_t capacity = 1;
+			while(capacity < options_.capacity)
+				capacity <<= 1;
+			if(options_.maxLag == 0 || options_.maxLag > capacity || options_.maxReaders == 0)
+				throw std::runtime_error("Invalid shared memory options");
+
+			size_ = shm::regionSize(capacity, options_.maxReaders);
+			if(options_.replaceExisting)
+				shm_unlink(name_.c_str());
+			int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+			if(fd < 0)
+			{
+				if(errno == EEXIST)
+					throw std::runtime_error("Shared memory " + name_ + " already exists");
+				throw std::runtime_error("Unable to create shared memory " + name_);
+			}
+			if(ftruncate(fd, size_) < 0)
+			{
+				::close(fd);
+				shm_unlink(name_.c_str());
+				throw std::runtime_error("Unable to size shared memory " + name_);
+			}
+			void* region = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if(region == MAP_FAILED)
+			{
+				shm_unlink(name_.c_str());
+				throw std::runtime_error("Unable to map shared memory " + name_);
+			}
+
+			// A fresh mapping is zero-filled: slots are Free, sequences 0
+			header_ = static_cast<shm::Header*>(region);
+			header_->capacity = capacity;
+			header_->maxLag = options_.maxLag;
+			header_->maxReaders = options_.maxReaders;
+			mask_ = capacity - 1;
+			readers_ = shm::readerSlots(header_);
+			events_ = shm::events(header_);
+			header_->magic.store(shm::Magic, std::memory_order_release);
+		}
+
+		~ShmPublisher()
+		{
+			finish();
+			munmap(header_, size_);
+			shm_unlink(name_.c_str());
+		}
+
+		ShmPublisher(const ShmPublisher&) = delete;
+		ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+		// Blocks until 'count' readers are attached or the timeout expires
+		bool waitForReaders(uint32_t count, std::chrono::milliseconds timeout)
+		{
+			auto deadline = std::chrono::steady_clock::now() + timeout;
+			while(activeReaders() < count)
+			{
+				if(std::chrono::steady_clock::now() >= deadline)
+					return false;
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			return true;
+		}
+
+		uint32_t activeReaders() const
+		{
+			uint32_t result = 0;
+			for(uint32_t i = 0; i < header_->maxReaders; i++)
+			{
+				if(readers_[i].state.load(std::memory_order_acquire) == shm::Active)
+					result++;
+			}
+			return result;
+		}
+
+		uint64_t published() const
+		{
+			return head_;
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			if(head_ - minCursor_ >= options_.maxLag)
+				throttle();
+
+			shm::Event& event = events_[head_ & mask_];
+			event.sequence.store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			event.frameTimestamp = entry.frameTimestamp;
+			event.timestamp = entry.timestamp;
+			event.orderId = entry.orderId;
+			event.matchingOrderId = entry.matchingOrderId;
+			event.orderPrice = entry.orderPrice.toNanos();
+			event.tradePrice = entry.tradePrice.toNanos();
+			event.openInterest = entry.openInterest;
+			event.volume = entry.volume;
+			event.remain = entry.remain;
+			event.flags = entry.flags;
+			event.streamNumber = entry.streamNumber;
+			event.sequence.store(head_ + 1, std::memory_order_release);
+
+			head_++;
+			header_->head.store(head_, std::memory_order_release);
+		}
+
+		// Tells readers that no more events will come
+		void finish()
+		{
+			header_->finished.store(1, std::memory_order_release);
+		}
+
+	private:
+		// Waits for the slowest reader, evicting the ones that stall
+		void throttle()
+		{
+			auto start = std::chrono::steady_clock::now();
+			unsigned spins = 0;
+			while(true)
+			{
+				uint64_t slowest = head_;
+				uint32_t slowestIndex = 0;
+				for(uint32_t i = 0; i < header_->maxReaders; i++)
+				{
+					if(readers_[i].state.load(std::memory_order_acquire) != shm::Active)
+						continue;
+					uint64_t cursor = readers_[i].cursor.load(std::memory_order_acquire);
+					if(cursor < slowest)
+					{
+						slowest = cursor;
+						slowestIndex = i;
+					}
+				}
+				minCursor_ = slowest;
+				if(head_ - slowest < options_.maxLag)
+					return;
+
+				if(std::chrono::steady_clock::now() - start >= options_.stallTimeout)
+				{
+					uint32_t expected = shm::Active;
+					readers_[slowestIndex].state.compare_exchange_strong(expected, shm::Evicted);
+					start = std::chrono::steady_clock::now();
+					continue;
+				}
+				shm::backoff(spins);
+			}
+		}
+
+	private:
+		std::string name_;
+		Options options_;
+		shm::Header* header_;
+		size_t size_;
+		uint64_t mask_;
+		shm::ReaderSlot* readers_;
+		shm::Event* events_;
+		uint64_t head_;
+		uint64_t minCursor_;
+	};
+
+	// Reads events published by ShmPublisher and passes them to
+	// Sink::orderLogFrame(), like QshFile does. A reader starts at the
+	// publisher's current position. When all slots are taken, slots of
+	// readers whose process has exited (crashed, or evicted and never
+	// destroyed) are reclaimed.
+	template <typename Sink>
+	class ShmSubscriber
+	{
+	public:
+		ShmSubscriber(const std::string& name, Sink& sink) : sink_(sink),
+			header_(nullptr),
+			slot_(nullptr)
+		{
+			int fd = shm_open(name.c_str(), O_RDWR, 0);
+			if(fd < 0)
+				throw std::runtime_error("Unable to open shared memory " + name);
+			struct stat st;
+			if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(shm::Header))
+			{
+				::close(fd);
+				throw std::runtime_error("Invalid shared memory " + name);
+			}
+			size_ = st.st_size;
+			void* region = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if(region == MAP_FAILED)
+				throw std::runtime_error("Unable to map shared memory " + name);
+			header_ = static_cast<shm::Header*>(region);
+
+			if(header_->magic.load(std::memory_order_acquire) != shm::Magic ||
+					size_ < shm::regionSize(header_->capacity, header_->maxReaders))
+			{
+				munmap(header_, size_);
+				throw std::runtime_error("Invalid shared memory " + name);
+			}
+			mask_ = header_->capacity - 1;
+			events_ = shm::events(header_);
+
+			shm::ReaderSlot* slots = shm::readerSlots(header_);
+			for(uint32_t i = 0; i < header_->maxReaders && !slot_; i++)
+			{
+				uint32_t expected = shm::Free;
+				if(slots[i].state.compare_exchange_strong(expected, shm::Attaching))
+					slot_ = &slots[i];
+			}
+			// Attaching slots are left alone: their owner may not be recorded yet
+			for(uint32_t i = 0; i < header_->maxReaders && !slot_; i++)
+			{
+				uint32_t state = slots[i].state.load(std::memory_order_acquire);
+				if((state == shm::Active || state == shm::Evicted) && !shm::alive(slots[i].owner.load()) &&
+						slots[i].state.compare_exchange_strong(state, shm::Attaching))
+					slot_ = &slots[i];
+			}
+			if(!slot_)
+			{
+				munmap(header_, size_);
+				throw std::runtime_error("Too many subscribers");
+			}
+
+			slot_->owner.store(getpid());
+			// The publisher ignores the slot until it is Active, so the cursor
+			// is made valid first and brought up to date once the slot counts
+			slot_->cursor.store(header_->head.load(std::memory_order_acquire), std::memory_order_release);
+			slot_->state.store(shm::Active, std::memory_order_seq_cst);
+			cursor_ = header_->head.load(std::memory_order_seq_cst);
+			slot_->cursor.store(cursor_, std::memory_order_release);
+		}
+
+		~ShmSubscriber()
+		{
+			slot_->owner.store(0);
+			slot_->state.store(shm::Free, std::memory_order_release);
+			munmap(header_, size_);
+		}
+
+		ShmSubscriber(const ShmSubscriber&) = delete;
+		ShmSubscriber& operator=(const ShmSubscriber&) = delete;
+
+		// Delivers the events published so far and returns their number
+		size_t readAvailableFrames()
+		{
+			checkEvicted();
+			uint64_t head = header_->head.load(std::memory_order_acquire);
+			size_t frames = 0;
+			while(cursor_ < head)
+			{
+				deliver(events_[cursor_ & mask_]);
+				cursor_++;
+				frames++;
+				// Publishing the cursor in steps keeps the line from bouncing
+				if((cursor_ & 63) == 0)
+					slot_->cursor.store(cursor_, std::memory_order_release);
+			}
+			slot_->cursor.store(cursor_, std::memory_order_release);
+			return frames;
+		}
+
+		// Delivers events until the publisher finishes
+		void readAllFrames()
+		{
+			unsigned spins = 0;
+			while(true)
+			{
+				bool finished = header_->finished.load(std::memory_order_acquire) != 0;
+				if(readAvailableFrames() > 0)
+					spins = 0;
+				else if(finished)
+					break;
+				else
+					shm::backoff(spins);
+			}
+		}
+
+		uint64_t position() const
+		{
+			return cursor_;
+		}
+
+	private:
+		void checkEvicted()
+		{
+			if(slot_->state.load(std::memory_order_acquire) == shm::Evicted)
+				throw std::runtime_error("Subscriber evicted");
+		}
+
+		void deliver(const shm::Event& event)
+		{
+			uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+			OrderLogEntry entry;
+			entry.frameTimestamp = event.frameTimestamp;
+			entry.timestamp = event.timestamp;
+			entry.orderId = event.orderId;
+			entry.matchingOrderId = event.matchingOrderId;
+			entry.orderPrice = decimal_fixed::fromNanos(event.orderPrice);
+			entry.tradePrice = decimal_fixed::fromNanos(event.tradePrice);
+			entry.openInterest = event.openInterest;
+			entry.volume = event.volume;
+			entry.remain = event.remain;
+			entry.flags = event.flags;
+			entry.streamNumber = event.streamNumber;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(sequence != cursor_ + 1 || event.sequence.load(std::memory_order_relaxed) != sequence)
+			{
+				checkEvicted();
+				throw std::runtime_error("Subscriber overrun");
+			}
+			sink_.orderLogFrame(entry);
+		}
+
+	private:
+		Sink& sink_;
+		shm::Header* header_;
+		size_t size_;
+		uint64_t mask_;
+		shm::Event* events_;
+		shm::ReaderSlot* slot_;
+		uint64_t cursor_;
+	};
+}
+
+#endif /* ifndef SHM_H */
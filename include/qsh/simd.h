@@ -0,0 +1,43 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+
+// Vector kernels are compiled per function with a target attribute and
+// selected at run time, so the library still builds for and runs on any
+// x86-64 (and any other architecture, through the scalar fallbacks).
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define QSH_SIMD_X86 1
+#define QSH_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace qsh
+{
+	namespace simd
+	{
+		inline bool hasAvx2()
+		{
+#ifdef QSH_SIMD_X86
+			static const bool supported = __builtin_cpu_supports("avx2");
+			return supported;
+#else
+			return false;
+#endif
+		}
+
+#ifdef QSH_SIMD_X86
+		// Low 64 bits of a * b for signed or unsigned 64-bit lanes; AVX2 only
+		// multiplies 32-bit halves
+		QSH_TARGET_AVX2 inline __m256i mul64by32(__m256i a, uint32_t b)
+		{
+			__m256i factor = _mm256_set1_epi64x(b);
+			__m256i low = _mm256_mul_epu32(a, factor);
+			__m256i high = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), factor);
+			return _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+		}
+#endif
+	}
+}
+
+#endif /* ifndef SIMD_H */
@@ -0,0 +1,170 @@
+#ifndef SINKS_H
+#define SINKS_H
+
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "types.h"
+
+namespace qsh
+{
+	// Building blocks for sinks that feed several consumers from one decode
+	// pass. Everything is resolved at compile time, so a chain like
+	//
+	//     auto sink = sinks::fanOut(book,
+	//             sinks::filter(sinks::FlagsAll<OrderLogEntry::Fill>(), bars),
+	//             sinks::filter(sinks::Stream(1), logger));
+	//     QshFile<decltype(sink)> file(stream, sink);
+	//
+	// inlines into QshFile::parseOrdLogEntry without indirect calls. Sinks
+	// passed as lvalues are held by reference, temporaries (nested stages)
+	// by value.
+	namespace sinks
+	{
+		template <typename... Sinks>
+		class FanOut
+		{
+		public:
+			template <typename... Args>
+			explicit FanOut(Args&&... sinks) : sinks_(std::forward<Args>(sinks)...)
+			{
+			}
+
+			template <typename Entry>
+			void orderLogFrame(const Entry& entry)
+			{
+				dispatch(entry, std::index_sequence_for<Sinks...>());
+			}
+
+			template <size_t I>
+			typename std::remove_reference<typename std::tuple_element<I, std::tuple<Sinks...>>::type>::type& get()
+			{
+				return std::get<I>(sinks_);
+			}
+
+		private:
+			template <typename Entry, size_t... I>
+			void dispatch(const Entry& entry, std::index_sequence<I...>)
+			{
+				using expand = int[];
+				(void)expand { 0, (std::get<I>(sinks_).orderLogFrame(entry), 0)... };
+			}
+
+		private:
+			std::tuple<Sinks...> sinks_;
+		};
+
+		template <typename Predicate, typename Next>
+		class Filter
+		{
+		public:
+			template <typename N>
+			Filter(Predicate predicate, N&& next) : predicate_(predicate),
+				next_(std::forward<N>(next))
+			{
+			}
+
+			template <typename Entry>
+			void orderLogFrame(const Entry& entry)
+			{
+				if(predicate_(entry))
+					next_.orderLogFrame(entry);
+			}
+
+		private:
+			Predicate predicate_;
+			Next next_;
+		};
+
+		// Function takes an entry and returns the entry to pass on
+		template <typename Function, typename Next>
+		class Map
+		{
+		public:
+			template <typename N>
+			Map(Function function, N&& next) : function_(function),
+				next_(std::forward<N>(next))
+			{
+			}
+
+			template <typename Entry>
+			void orderLogFrame(const Entry& entry)
+			{
+				next_.orderLogFrame(function_(entry));
+			}
+
+		private:
+			Function function_;
+			Next next_;
+		};
+
+		template <typename... Sinks>
+		FanOut<Sinks...> fanOut(Sinks&&... sinks)
+		{
+			return FanOut<Sinks...>(std::forward<Sinks>(sinks)...);
+		}
+
+		template <typename Predicate, typename Next>
+		Filter<Predicate, Next> filter(Predicate predicate, Next&& next)
+		{
+			return Filter<Predicate, Next>(predicate, std::forward<Next>(next));
+		}
+
+		template <typename Function, typename Next>
+		Map<Function, Next> map(Function function, Next&& next)
+		{
+			return Map<Function, Next>(function, std::forward<Next>(next));
+		}
+
+		// Predicates
+
+		template <uint16_t Mask>
+		struct FlagsAll
+		{
+			template <typename Entry>
+			bool operator()(const Entry& entry) const
+			{
+				return (entry.flags & Mask) == Mask;
+			}
+		};
+
+		template <uint16_t Mask>
+		struct FlagsAny
+		{
+			template <typename Entry>
+			bool operator()(const Entry& entry) const
+			{
+				return (entry.flags & Mask) != 0;
+			}
+		};
+
+		template <uint16_t Mask>
+		struct FlagsNone
+		{
+			template <typename Entry>
+			bool operator()(const Entry& entry) const
+			{
+				return (entry.flags & Mask) == 0;
+			}
+		};
+
+		struct Stream
+		{
+			explicit Stream(int number) : number(number)
+			{
+			}
+
+			template <typename Entry>
+			bool operator()(const Entry& entry) const
+			{
+				return entry.streamNumber == number;
+			}
+
+			int number;
+		};
+	}
+}
+
+#endif /* ifndef SINKS_H */
@@ -0,0 +1,184 @@
+#ifndef SNAPSHOTS_H
+#define SNAPSHOTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "types.h"
+#include "bars.h"
+#include "book.h"
+
+namespace qsh
+{
+	struct SnapshotCadence
+	{
+		enum Type
+		{
+			Time,	// every 'interval' milliseconds
+			Events	// every 'interval' entries
+		};
+
+		Type type;
+		int64_t interval;
+	};
+
+	// Top-of-book snapshots, one row each. Every level has its own column
+	// (bidPrice[0] is the best bid of every row), so a column is one
+	// contiguous feature. Prices are in ticks; levels missing from the book
+	// have price and volume 0.
+	struct SnapshotColumns
+	{
+		explicit SnapshotColumns(size_t depth) : bidPrice(depth),
+			bidVolume(depth),
+			askPrice(depth),
+			askVolume(depth)
+		{
+		}
+
+		std::vector<datetime_t> time;	// of the entry that closed the transaction
+		std::vector<uint64_t> events;	// entries seen up to and including it
+		std::vector<std::vector<int64_t>> bidPrice;	// [level][row]
+		std::vector<std::vector<int64_t>> bidVolume;
+		std::vector<std::vector<int64_t>> askPrice;
+		std::vector<std::vector<int64_t>> askVolume;
+
+		size_t depth() const
+		{
+			return bidPrice.size();
+		}
+
+		size_t size() const
+		{
+			return time.size();
+		}
+
+		void reserve(size_t capacity)
+		{
+			time.reserve(capacity);
+			events.reserve(capacity);
+			for(auto columns : { &bidPrice, &bidVolume, &askPrice, &askVolume })
+			{
+				for(auto& column : *columns)
+					column.reserve(capacity);
+			}
+		}
+
+		// Keeps the capacity
+		void clear()
+		{
+			time.clear();
+			events.clear();
+			for(auto columns : { &bidPrice, &bidVolume, &askPrice, &askVolume })
+			{
+				for(auto& column : *columns)
+					column.clear();
+			}
+		}
+	};
+
+	// Maintains the book of one instrument (see L3Book) and records the
+	// best 'depth' levels of each side at the given cadence. Snapshots are
+	// only taken at EndOfTransaction entries, so the book is never seen
+	// halfway through a match: a time snapshot is taken at the first
+	// boundary in each 'interval' bucket that has one, an event snapshot at
+	// the first boundary after 'interval' entries since the last one.
+	// Columns are reserved for 'capacity' rows up front and drained with
+	// snapshots().clear().
+	template <BarClock Clock = BarClock::Exchange>
+	class SnapshotSampler
+	{
+	public:
+		SnapshotSampler(double step, size_t depth, SnapshotCadence cadence, size_t capacity = 1 << 16) : book_(step),
+			cadence_(cadence),
+			snapshots_(depth),
+			events_(0),
+			lastEvents_(0),
+			lastBucket_(0),
+			sampled_(false)
+		{
+			if(depth == 0)
+				throw std::runtime_error("Invalid depth");
+			if(cadence_.interval <= 0)
+				throw std::runtime_error("Invalid interval");
+			snapshots_.reserve(capacity);
+		}
+
+		SnapshotSampler(const SnapshotSampler&) = delete;
+		SnapshotSampler& operator=(const SnapshotSampler&) = delete;
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			book_.orderLogFrame(entry);
+			events_++;
+			if(!(entry.flags & OrderLogEntry::EndOfTransaction))
+				return;
+
+			datetime_t time = (Clock == BarClock::Exchange) ? entry.timestamp : entry.frameTimestamp;
+			if(cadence_.type == SnapshotCadence::Time)
+			{
+				int64_t interval = cadence_.interval;
+				datetime_t bucket = time - (time % interval + interval) % interval;
+				if(sampled_ && bucket == lastBucket_)
+					return;
+				lastBucket_ = bucket;
+			}
+			else if(events_ - lastEvents_ < (uint64_t)cadence_.interval)
+			{
+				return;
+			}
+			take(time);
+		}
+
+		// Records a snapshot now, regardless of the cadence
+		void take(datetime_t time)
+		{
+			snapshots_.time.push_back(time);
+			snapshots_.events.push_back(events_);
+			record(book::Bid, snapshots_.bidPrice, snapshots_.bidVolume);
+			record(book::Ask, snapshots_.askPrice, snapshots_.askVolume);
+			lastEvents_ = events_;
+			sampled_ = true;
+		}
+
+		SnapshotColumns& snapshots()
+		{
+			return snapshots_;
+		}
+
+		const L3Book& book() const
+		{
+			return book_;
+		}
+
+	private:
+		void record(book::Side side, std::vector<std::vector<int64_t>>& prices,
+				std::vector<std::vector<int64_t>>& volumes)
+		{
+			size_t level = 0;
+			book_.forEachLevel(side, prices.size(), [&](int64_t price, const book::Level& queue)
+					{
+						prices[level].push_back(price);
+						volumes[level].push_back(queue.volume);
+						level++;
+					});
+			for(; level < prices.size(); level++)
+			{
+				prices[level].push_back(0);
+				volumes[level].push_back(0);
+			}
+		}
+
+	private:
+		L3Book book_;
+		SnapshotCadence cadence_;
+		SnapshotColumns snapshots_;
+		uint64_t events_;
+		uint64_t lastEvents_;
+		datetime_t lastBucket_;
+		bool sampled_;
+	};
+}
+
+#endif /* ifndef SNAPSHOTS_H */
@@ -0,0 +1,315 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+#include "ordlog.h"
+
+namespace qsh
+{
+	// Decoder instrumentation, selected by the second template parameter of
+	// QshFile:
+	//
+	//     QshFile<Sink, DecoderStats> file(stream, sink);
+	//     ... on another thread: auto snapshot = file.stats().snapshot();
+	//
+	// QshFile calls the hooks below on every frame. NoStats, the default,
+	// implements them as empty inline functions, so the instrumented build
+	// and the plain one produce the same code.
+	struct NoStats
+	{
+		void frameBegin()
+		{
+		}
+
+		void frameHeader(int, int64_t, bool)
+		{
+		}
+
+		void ordLogFrame(int, int, uint16_t, const OrdLogState&, const OrdLogState&)
+		{
+		}
+
+		void sinkBegin()
+		{
+		}
+
+		void sinkEnd()
+		{
+		}
+
+		void frameEnd()
+		{
+		}
+	};
+
+	namespace stats
+	{
+		// Encoded sizes, assuming the minimal encodings QshWriter and QScalp
+		// produce. Lets the counters be derived from decoded values instead
+		// of stream positions.
+		inline size_t uleb128Size(uint64_t value)
+		{
+			size_t size = 1;
+			while(value >= 0x80)
+			{
+				value >>= 7;
+				size++;
+			}
+			return size;
+		}
+
+		inline size_t leb128Size(int64_t value)
+		{
+			size_t size = 1;
+			while(value >= 0x40 || value < -0x40)
+			{
+				value >>= 7;
+				size++;
+			}
+			return size;
+		}
+
+		inline size_t growingSize(int64_t value)
+		{
+			if(value >= 0 && value < 268435455)
+				return uleb128Size(value);
+			return uleb128Size(268435455) + leb128Size(value);
+		}
+
+		// Cycle counter on x86, nanoseconds elsewhere
+		inline uint64_t ticks()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			return __builtin_ia32_rdtsc();
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+		inline int64_t nowNanos()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static const size_t MaxStreams = 256;	// the stream number is one byte
+		static const size_t MaxVarintSize = 10;
+	}
+
+	// Counters for one QshFile. The decoder thread is the only writer; every
+	// counter is an atomic updated with a plain load and store (no locked
+	// instructions), so snapshot() may be called from any thread at any time.
+	// Timing is sampled: one frame in 'sampleEvery' (rounded up to a power of
+	// two) is timed with the cycle counter.
+	class DecoderStats
+	{
+	public:
+		struct Snapshot
+		{
+			std::array<uint64_t, stats::MaxStreams> frames;
+			std::array<uint64_t, stats::MaxStreams> bytes;
+			std::array<uint64_t, 256> parts;	// by parts byte
+			std::array<uint64_t, stats::MaxVarintSize + 1> varintSize;	// by encoded size in bytes
+			uint64_t sampledFrames;
+			uint64_t decodeTicks;	// sampled frames only, sink excluded
+			uint64_t sinkTicks;	// sampled frames only
+			double elapsedSeconds;	// first frame to the last sampled one
+
+			uint64_t totalFrames() const
+			{
+				uint64_t total = 0;
+				for(auto count : frames)
+					total += count;
+				return total;
+			}
+
+			uint64_t totalBytes() const
+			{
+				uint64_t total = 0;
+				for(auto count : bytes)
+					total += count;
+				return total;
+			}
+
+			double eventsPerSecond() const
+			{
+				return elapsedSeconds > 0 ? totalFrames() / elapsedSeconds : 0.0;
+			}
+
+			// Share of the sampled time spent in the sink
+			double sinkShare() const
+			{
+				uint64_t total = decodeTicks + sinkTicks;
+				return total ? (double)sinkTicks / total : 0.0;
+			}
+		};
+
+		explicit DecoderStats(unsigned sampleEvery = 64) : mask_(1),
+			counter_(0),
+			sampled_(false),
+			frameStart_(0),
+			sinkStart_(0),
+			sinkTicks_(0),
+			timeSize_(0),
+			headerSize_(0),
+			startNanos_(0),
+			lastNanos_(0),
+			sampledFrames_(0),
+			decodeTicksTotal_(0),
+			sinkTicksTotal_(0)
+		{
+			while(mask_ < sampleEvery)
+				mask_ <<= 1;
+			mask_--;
+			for(auto& value : frames_)
+				value.store(0);
+			for(auto& value : bytes_)
+				value.store(0);
+			for(auto& value : parts_)
+				value.store(0);
+			for(auto& value : varintSize_)
+				value.store(0);
+		}
+
+		DecoderStats(const DecoderStats&) = delete;
+		DecoderStats& operator=(const DecoderStats&) = delete;
+
+		Snapshot snapshot() const
+		{
+			Snapshot result;
+			for(size_t i = 0; i < stats::MaxStreams; i++)
+			{
+				result.frames[i] = frames_[i].load(std::memory_order_relaxed);
+				result.bytes[i] = bytes_[i].load(std::memory_order_relaxed);
+			}
+			for(size_t i = 0; i < parts_.size(); i++)
+				result.parts[i] = parts_[i].load(std::memory_order_relaxed);
+			for(size_t i = 0; i < varintSize_.size(); i++)
+				result.varintSize[i] = varintSize_[i].load(std::memory_order_relaxed);
+			result.sampledFrames = sampledFrames_.load(std::memory_order_relaxed);
+			result.decodeTicks = decodeTicksTotal_.load(std::memory_order_relaxed);
+			result.sinkTicks = sinkTicksTotal_.load(std::memory_order_relaxed);
+			int64_t start = startNanos_.load(std::memory_order_relaxed);
+			int64_t last = lastNanos_.load(std::memory_order_relaxed);
+			result.elapsedSeconds = (start && last > start) ? (last - start) / 1e9 : 0.0;
+			return result;
+		}
+
+		// Hooks called by QshFile
+
+		void frameBegin()
+		{
+			sampled_ = (counter_++ & mask_) == 0;
+			if(sampled_)
+			{
+				int64_t now = stats::nowNanos();
+				if(!startNanos_.load(std::memory_order_relaxed))
+					startNanos_.store(now, std::memory_order_relaxed);
+				lastNanos_.store(now, std::memory_order_relaxed);
+				sinkTicks_ = 0;
+				frameStart_ = stats::ticks();
+			}
+		}
+
+		// Counted together with the body, once the frame is known to be complete
+		void frameHeader(int, int64_t timeDelta, bool hasStreamNumber)
+		{
+			timeSize_ = stats::growingSize(timeDelta);
+			headerSize_ = timeSize_ + (hasStreamNumber ? 1 : 0);
+		}
+
+		void ordLogFrame(int streamNumber, int parts, uint16_t flags, const OrdLogState& before, const OrdLogState& after)
+		{
+			bump(frames_[streamNumber], 1);
+			bump(parts_[parts & 0xff], 1);
+			field(timeSize_);
+			size_t size = headerSize_ + 3;
+			if(parts & ordlog::ExchangeTime)
+				size += field(stats::growingSize(after.exchangeTime - before.exchangeTime));
+			if(parts & ordlog::OrderId)
+			{
+				int64_t delta = after.orderId - before.addOrderId;
+				size += field((flags & ordlog::AddFlag) ? stats::growingSize(delta) : stats::leb128Size(delta));
+			}
+			if(parts & ordlog::OrderPrice)
+				size += field(stats::leb128Size(after.orderPrice - before.orderPrice));
+			if(parts & ordlog::Volume)
+				size += field(stats::leb128Size(after.volume));
+			if(parts & ordlog::VolumeLeft)
+				size += field(stats::leb128Size(after.volumeLeft));
+			if(parts & ordlog::TradeId)
+				size += field(stats::growingSize(after.tradeId - before.tradeId));
+			if(parts & ordlog::TradePrice)
+				size += field(stats::leb128Size(after.tradePrice - before.tradePrice));
+			if(parts & ordlog::OpenInterest)
+				size += field(stats::leb128Size(after.openInterest - before.openInterest));
+			bump(bytes_[streamNumber], size);
+		}
+
+		void sinkBegin()
+		{
+			if(sampled_)
+				sinkStart_ = stats::ticks();
+		}
+
+		void sinkEnd()
+		{
+			if(sampled_)
+				sinkTicks_ += stats::ticks() - sinkStart_;
+		}
+
+		void frameEnd()
+		{
+			if(sampled_)
+			{
+				uint64_t total = stats::ticks() - frameStart_;
+				bump(sampledFrames_, 1);
+				bump(sinkTicksTotal_, sinkTicks_);
+				bump(decodeTicksTotal_, total > sinkTicks_ ? total - sinkTicks_ : 0);
+				sampled_ = false;
+			}
+		}
+
+	private:
+		static void bump(std::atomic<uint64_t>& counter, uint64_t value)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		size_t field(size_t size)
+		{
+			bump(varintSize_[size > stats::MaxVarintSize ? stats::MaxVarintSize : size], 1);
+			return size;
+		}
+
+	private:
+		// Decoder thread only
+		uint64_t mask_;
+		uint64_t counter_;
+		bool sampled_;
+		uint64_t frameStart_;
+		uint64_t sinkStart_;
+		uint64_t sinkTicks_;
+		size_t timeSize_;
+		size_t headerSize_;
+
+		std::atomic<int64_t> startNanos_;
+		std::atomic<int64_t> lastNanos_;
+		std::atomic<uint64_t> sampledFrames_;
+		std::atomic<uint64_t> decodeTicksTotal_;
+		std::atomic<uint64_t> sinkTicksTotal_;
+		std::array<std::atomic<uint64_t>, stats::MaxStreams> frames_;
+		std::array<std::atomic<uint64_t>, stats::MaxStreams> bytes_;
+		std::array<std::atomic<uint64_t>, 256> parts_;
+		std::array<std::atomic<uint64_t>, stats::MaxVarintSize + 1> varintSize_;
+	};
+}
+
+#endif /* ifndef STATS_H */
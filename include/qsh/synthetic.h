@@ -0,0 +1,270 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "qshwriter.h"
+
+namespace qsh
+{
+	namespace testing
+	{
+		// Generates OrdLog files that follow the Plaza2 conventions seen in
+		// real data: resting orders carry Quote, moves are a Moved removal
+		// followed by Moved|Add, trades are a Counter order with a pair of Fill
+		// entries. With 'randomParts' every field changes at random instead,
+		// which exercises all parts patterns.
+		class SyntheticOrdLog
+		{
+		public:
+			enum Flags
+			{
+				Add = (1 << 2),
+				Fill = (1 << 3),
+				Buy = (1 << 4),
+				Sell = (1 << 5),
+				Quote = (1 << 7),
+				Counter = (1 << 8),
+				EndOfTransaction = (1 << 10),
+				Moved = (1 << 12),
+				Cancelled = (1 << 13)
+			};
+
+			// 2016-04-26 07:00:00 UTC in .NET ticks
+			static datetime_t startTime()
+			{
+				return (TimeDeltaInSeconds + 1461654000ll) * 10000000ll;
+			}
+
+			SyntheticOrdLog(uint64_t seed = 1, int streams = 1, bool randomParts = false) : rng_(seed),
+				randomParts_(randomParts),
+				streams_(streams)
+			{
+				for(auto& stream : streams_)
+				{
+					stream.state = OrdLogState();
+					stream.state.exchangeTime = startTime() / 10000 - 3600000;
+					stream.state.orderId = 20000000000ll;
+					stream.state.orderPrice = 7000;
+					stream.state.tradeId = 1500000000ll;
+					stream.state.openInterest = 100000;
+					stream.mid = 7000;
+				}
+			}
+
+			static std::string securityCode(int stream)
+			{
+				return "Plaza2:SYN-" + std::to_string(stream) + "::" + std::to_string(800000 + stream) + ":1";
+			}
+
+			// Writes a complete file with approximately 'frames' frames
+			void write(std::ostream& out, size_t frames)
+			{
+				std::vector<std::string> codes;
+				for(size_t i = 0; i < streams_.size(); i++)
+					codes.push_back(securityCode(i));
+
+				QshWriter writer(out, "Synthetic", "libqsh test data", startTime(), codes);
+				frameTimestamp_ = startTime() / 10000;
+				size_t written = 0;
+				while(written < frames)
+				{
+					int stream = random(streams_.size());
+					if(randomParts_)
+						written += randomFrame(writer, stream);
+					else
+						written += transaction(writer, stream);
+				}
+			}
+
+		private:
+			struct LiveOrder
+			{
+				int64_t orderId;
+				int64_t price;
+				int64_t volume;
+				uint16_t side;
+			};
+
+			struct Stream
+			{
+				OrdLogState state;
+				std::vector<LiveOrder> orders;
+				int64_t mid;
+			};
+
+			int64_t random(int64_t n)
+			{
+				return (int64_t)(rng_() % (uint64_t)n);
+			}
+
+			void emit(QshWriter& writer, int stream, uint16_t flags)
+			{
+				auto& state = streams_[stream].state;
+				state.exchangeTime += random(3);
+				frameTimestamp_ = std::max(frameTimestamp_, state.exchangeTime + 5 + random(40));
+				writer.writeOrdLogFrame(stream, frameTimestamp_, flags, state);
+			}
+
+			size_t randomFrame(QshWriter& writer, int stream)
+			{
+				static const uint16_t flagSet[] = {
+					Add | Buy | Quote | EndOfTransaction,
+					Add | Sell | Quote,
+					Fill | Buy | Quote,
+					Fill | Sell | Counter | EndOfTransaction,
+					Cancelled | Buy | Quote | EndOfTransaction,
+					Moved | Sell | Quote,
+				};
+				auto& state = streams_[stream].state;
+				if(random(2))
+					state.exchangeTime += random(100000);
+				if(random(2))
+					state.orderId += random(2) ? random(1000) : -random(1ll << 40);
+				if(random(2))
+					state.orderPrice += random(201) - 100;
+				if(random(2))
+					state.volume = random(1000) - 10;
+				if(random(2))
+					state.volumeLeft = random(1000);
+				if(random(2))
+					state.tradeId += random(1ll << 30);
+				if(random(2))
+					state.tradePrice += random(20001) - 10000;
+				if(random(2))
+					state.openInterest += random(101) - 50;
+				uint16_t flags = flagSet[random(sizeof(flagSet) / sizeof(flagSet[0]))];
+				frameTimestamp_ += random(1000);
+				writer.writeOrdLogFrame(stream, frameTimestamp_, flags, state);
+				return 1;
+			}
+
+			size_t transaction(QshWriter& writer, int stream)
+			{
+				auto& s = streams_[stream];
+				int64_t action = random(100);
+				if(s.orders.size() < 20 || action < 45)
+					return addOrder(writer, stream);
+				else if(action < 70)
+					return cancelOrder(writer, stream);
+				else if(action < 80)
+					return moveOrder(writer, stream);
+				else
+					return trade(writer, stream);
+			}
+
+			size_t addOrder(QshWriter& writer, int stream)
+			{
+				auto& s = streams_[stream];
+				LiveOrder order;
+				order.side = random(2) ? Buy : Sell;
+				order.orderId = s.state.orderId + 1 + random(20);
+				order.price = (order.side == Buy) ? s.mid - 1 - random(10) : s.mid + 1 + random(10);
+				order.volume = 1 + random(50);
+				s.orders.push_back(order);
+
+				s.state.orderId = order.orderId;
+				s.state.orderPrice = order.price;
+				s.state.volume = order.volume;
+				emit(writer, stream, Add | Quote | order.side | EndOfTransaction);
+				return 1;
+			}
+
+			LiveOrder takeOrder(int stream)
+			{
+				auto& orders = streams_[stream].orders;
+				size_t index = random(orders.size());
+				LiveOrder order = orders[index];
+				orders[index] = orders.back();
+				orders.pop_back();
+				return order;
+			}
+
+			size_t cancelOrder(QshWriter& writer, int stream)
+			{
+				auto& s = streams_[stream];
+				LiveOrder order = takeOrder(stream);
+				s.state.orderId = order.orderId;
+				s.state.orderPrice = order.price;
+				s.state.volume = order.volume;
+				emit(writer, stream, Cancelled | Quote | order.side | EndOfTransaction);
+				return 1;
+			}
+
+			size_t moveOrder(QshWriter& writer, int stream)
+			{
+				auto& s = streams_[stream];
+				LiveOrder order = takeOrder(stream);
+				s.state.orderId = order.orderId;
+				s.state.orderPrice = order.price;
+				s.state.volume = order.volume;
+				emit(writer, stream, Moved | Quote | order.side);
+
+				order.orderId = s.state.orderId + 1 + random(20);
+				order.price += (order.side == Buy) ? -random(3) : random(3);
+				s.orders.push_back(order);
+				s.state.orderId = order.orderId;
+				s.state.orderPrice = order.price;
+				emit(writer, stream, Moved | Add | Quote | order.side | EndOfTransaction);
+				return 2;
+			}
+
+			size_t trade(QshWriter& writer, int stream)
+			{
+				auto& s = streams_[stream];
+				LiveOrder passive = takeOrder(stream);
+				uint16_t side = (passive.side == Buy) ? Sell : Buy;
+				int64_t volume = 1 + random(passive.volume + 10);
+				int64_t filled = std::min(volume, passive.volume);
+				int64_t counterId = s.state.orderId + 1 + random(20);
+
+				s.state.orderId = counterId;
+				s.state.orderPrice = passive.price;
+				s.state.volume = volume;
+				emit(writer, stream, Add | Counter | side);
+
+				s.state.tradeId += 1 + random(5);
+				s.state.tradePrice = passive.price;
+				s.state.openInterest += random(2 * filled + 1) - filled;
+				s.state.orderId = passive.orderId;
+				s.state.volume = filled;
+				s.state.volumeLeft = passive.volume - filled;
+				emit(writer, stream, Fill | Quote | passive.side);
+
+				s.state.orderId = counterId;
+				s.state.volumeLeft = volume - filled;
+				bool rest = volume > filled;
+				emit(writer, stream, Fill | Counter | side | (rest ? 0 : EndOfTransaction));
+				size_t frames = 3;
+				if(rest)
+				{
+					s.state.volume = volume - filled;
+					emit(writer, stream, Counter | side | EndOfTransaction);
+					frames++;
+				}
+
+				if(passive.volume > filled)
+				{
+					passive.volume -= filled;
+					s.orders.push_back(passive);
+				}
+				else
+				{
+					s.mid = passive.price;
+				}
+				return frames;
+			}
+
+			std::mt19937_64 rng_;
+			bool randomParts_;
+			std::vector<Stream> streams_;
+			datetime_t frameTimestamp_;
+		};
+	}
+}
+
+#endif /* ifndef SYNTHETIC_H */
@@ -0,0 +1,190 @@
+#ifndef TRADES_H
+#define TRADES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+namespace qsh
+{
+	// Sink adapter that turns the Fill entries of the order log into trades
+	// and hands them to Consumer::dealFrame(const Deal&), so Deals-stream
+	// consumers can run on OrdLog files. Each trade is a pair of Fill entries
+	// with the same trade id (matchingOrderId) in one transaction, one per
+	// side. The aggressor is
+	//
+	//  - the Counter or non-Quote entry (an order that never rests), else
+	//  - the order added earlier in the same transaction (a quote that
+	//    crossed the spread), else
+	//  - the newer, i.e. larger, order id.
+	//
+	// A trade is delivered as soon as its second fill arrives; a fill still
+	// alone at EndOfTransaction is delivered by itself (see unpaired()).
+	// Transactions are tracked per stream. The buffers keep their capacity
+	// between transactions, so steady state does not allocate.
+	template <typename Consumer>
+	class TradeReconstructor
+	{
+	public:
+		TradeReconstructor(Consumer& consumer, size_t reserve = 64) : consumer_(consumer),
+			reserve_(reserve),
+			deals_(0),
+			unpaired_(0)
+		{
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			uint16_t flags = entry.flags;
+			if(flags & OrderLogEntry::Fill)
+				fill(transactionFor(entry.streamNumber), entry);
+			else if(flags & OrderLogEntry::Add)
+				transactionFor(entry.streamNumber).added.push_back(entry.orderId);
+			if((flags & OrderLogEntry::EndOfTransaction) && (size_t)entry.streamNumber < transactions_.size())
+				finish(transactions_[entry.streamNumber]);
+		}
+
+		// Delivers the fills of incomplete trailing transactions, e.g. at the
+		// end of a file
+		void flush()
+		{
+			for(auto& transaction : transactions_)
+				finish(transaction);
+		}
+
+		uint64_t deals() const
+		{
+			return deals_;
+		}
+
+		// Fills delivered without a counterpart, e.g. from filtered data
+		uint64_t unpaired() const
+		{
+			return unpaired_;
+		}
+
+	private:
+		struct Transaction
+		{
+			std::vector<OrderLogEntry> fills;	// waiting for their pair
+			std::vector<long long> added;
+		};
+
+		Transaction& transactionFor(int streamNumber)
+		{
+			if((size_t)streamNumber >= transactions_.size())
+			{
+				transactions_.resize(streamNumber + 1);
+				for(auto& transaction : transactions_)
+				{
+					transaction.fills.reserve(reserve_);
+					transaction.added.reserve(reserve_);
+				}
+			}
+			return transactions_[streamNumber];
+		}
+
+		void fill(Transaction& transaction, const OrderLogEntry& entry)
+		{
+			auto& fills = transaction.fills;
+			// The pair is nearly always the previous entry
+			for(size_t i = fills.size(); i > 0; i--)
+			{
+				if(fills[i - 1].matchingOrderId == entry.matchingOrderId)
+				{
+					emit(fills[i - 1], &entry, transaction.added);
+					fills.erase(fills.begin() + (i - 1));
+					return;
+				}
+			}
+			fills.push_back(entry);
+		}
+
+		void finish(Transaction& transaction)
+		{
+			for(const auto& entry : transaction.fills)
+			{
+				emit(entry, nullptr, transaction.added);
+				unpaired_++;
+			}
+			transaction.fills.clear();
+			transaction.added.clear();
+		}
+
+		static bool rests(const OrderLogEntry& entry)
+		{
+			return (entry.flags & OrderLogEntry::Quote) && !(entry.flags & OrderLogEntry::Counter);
+		}
+
+		static bool contains(const std::vector<long long>& ids, long long id)
+		{
+			for(auto value : ids)
+			{
+				if(value == id)
+					return true;
+			}
+			return false;
+		}
+
+		// nullptr if the entries do not tell
+		static const OrderLogEntry* aggressor(const OrderLogEntry& a, const OrderLogEntry* b,
+				const std::vector<long long>& added)
+		{
+			if(!b)
+				return rests(a) ? nullptr : &a;
+			if(rests(a) != rests(*b))
+				return rests(a) ? b : &a;
+			if(!rests(a))
+				return nullptr;
+			bool aAdded = contains(added, a.orderId);
+			if(aAdded != contains(added, b->orderId))
+				return aAdded ? &a : b;
+			if(a.orderId != b->orderId)
+				return a.orderId > b->orderId ? &a : b;
+			return nullptr;
+		}
+
+		void emit(const OrderLogEntry& a, const OrderLogEntry* b, const std::vector<long long>& added)
+		{
+			const OrderLogEntry& last = b ? *b : a;
+			Deal deal;
+			deal.frameTimestamp = last.frameTimestamp;
+			deal.streamNumber = a.streamNumber;
+			deal.timestamp = a.timestamp;
+			deal.id = a.matchingOrderId;
+			deal.buyOrderId = 0;
+			deal.sellOrderId = 0;
+			for(const OrderLogEntry* side : { &a, b })
+			{
+				if(side && (side->flags & OrderLogEntry::Buy))
+					deal.buyOrderId = side->orderId;
+				else if(side && (side->flags & OrderLogEntry::Sell))
+					deal.sellOrderId = side->orderId;
+			}
+			deal.price = a.tradePrice;
+			deal.volume = a.volume;
+			deal.openInterest = last.openInterest;
+
+			const OrderLogEntry* initiator = aggressor(a, b, added);
+			deal.type = Deal::Unknown;
+			if(initiator && (initiator->flags & OrderLogEntry::Buy))
+				deal.type = Deal::Buy;
+			else if(initiator && (initiator->flags & OrderLogEntry::Sell))
+				deal.type = Deal::Sell;
+
+			consumer_.dealFrame(deal);
+			deals_++;
+		}
+
+	private:
+		Consumer& consumer_;
+		size_t reserve_;
+		std::vector<Transaction> transactions_;
+		uint64_t deals_;
+		uint64_t unpaired_;
+	};
+}
+
+#endif /* ifndef TRADES_H */
@@ -0,0 +1,113 @@
+#ifndef TRANSACTIONSINK_H
+#define TRANSACTIONSINK_H
+
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+
+namespace qsh
+{
+	// Contiguous run of entries, valid only for the duration of the callback
+	struct OrderLogSpan
+	{
+		const OrderLogEntry* first;
+		size_t count;
+
+		const OrderLogEntry* begin() const
+		{
+			return first;
+		}
+
+		const OrderLogEntry* end() const
+		{
+			return first + count;
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		const OrderLogEntry& operator[](size_t i) const
+		{
+			return first[i];
+		}
+
+		const OrderLogEntry& back() const
+		{
+			return first[count - 1];
+		}
+	};
+
+	// Sink adapter that collects OrdLog entries up to and including the one
+	// flagged EndOfTransaction and hands them to
+	// Consumer::orderLogTransaction(OrderLogSpan) in one call. Transactions
+	// are tracked per stream. The buffers keep their capacity between
+	// transactions, so steady state does not allocate.
+	template <typename Consumer>
+	class TransactionSink
+	{
+	public:
+		TransactionSink(Consumer& consumer, size_t reserve = 64) : consumer_(consumer),
+			reserve_(reserve)
+		{
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			auto& buffer = bufferFor(entry.streamNumber);
+			buffer.push_back(entry);
+			if(entry.flags & OrderLogEntry::EndOfTransaction)
+				deliver(buffer);
+		}
+
+		// Delivers incomplete trailing transactions, e.g. at the end of a file
+		void flush()
+		{
+			for(auto& buffer : buffers_)
+			{
+				if(!buffer.empty())
+					deliver(buffer);
+			}
+		}
+
+		size_t pending() const
+		{
+			size_t result = 0;
+			for(const auto& buffer : buffers_)
+				result += buffer.size();
+			return result;
+		}
+
+	private:
+		std::vector<OrderLogEntry>& bufferFor(int streamNumber)
+		{
+			if((size_t)streamNumber >= buffers_.size())
+			{
+				buffers_.resize(streamNumber + 1);
+				for(auto& buffer : buffers_)
+					buffer.reserve(reserve_);
+			}
+			return buffers_[streamNumber];
+		}
+
+		void deliver(std::vector<OrderLogEntry>& buffer)
+		{
+			consumer_.orderLogTransaction(OrderLogSpan { buffer.data(), buffer.size() });
+			buffer.clear();
+		}
+
+	private:
+		Consumer& consumer_;
+		size_t reserve_;
+		std::vector<std::vector<OrderLogEntry>> buffers_;
+	};
+}
+
+#endif /* ifndef TRANSACTIONSINK_H */
@@ -2,10 +2,15 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <charconv>
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <istream>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <stdexcept>
 #include <cmath>
 
 namespace qsh
@@ -41,7 +46,10 @@ namespace qsh
 			uint8_t byte = 0;
 			while(true)
 			{
-				byte = stream.get();
+				auto c = stream.get();
+				if(c == std::char_traits<char>::eof())
+					break;
+				byte = c;
 				result |= (((uint64_t)byte & 0x7f) << shift);
 				shift += 7;
 				if((byte & 0x80) == 0)
@@ -52,7 +60,7 @@ namespace qsh
 			if ((shift < size) && (byte & 0x40))
 			{
 				/* sign extend */
-				result |= - (1 << shift);
+				result |= - ((int64_t)1 << shift);
 			}
 			return result;
 		}
@@ -63,7 +71,10 @@ namespace qsh
 			int shift = 0;
 			while(true)
 			{
-				uint8_t byte = stream.get();
+				auto c = stream.get();
+				if(c == std::char_traits<char>::eof())
+					break;
+				uint8_t byte = c;
 				result |= ((byte & 0x7f) << shift);
 				if ((byte & 0x80) == 0)
 					break;
@@ -82,6 +93,24 @@ namespace qsh
 			return result;
 		}
 
+		// Reuses the capacity of 'result'
+		inline void readString(std::istream& stream, std::string& result)
+		{
+			uint32_t length = readULeb128(stream);
+			result.resize(length);
+			stream.read(&result[0], length);
+		}
+
+		// Integer or floating point value of the whole of 'text', without
+		// locales, whitespace or allocations
+		template <typename T>
+		bool parseNumber(std::string_view text, T& value)
+		{
+			const char* end = text.data() + text.size();
+			auto result = std::from_chars(text.data(), end, value);
+			return result.ec == std::errc() && result.ptr == end;
+		}
+
 		inline int64_t readGrowing(std::istream& stream)
 		{
 			uint32_t first = readULeb128(stream);
@@ -97,10 +126,118 @@ namespace qsh
 			stream.read(reinterpret_cast<char*>(&value), 8);
 			return value;
 		}
+
+		inline void writeLeb128(std::ostream& stream, int64_t value)
+		{
+			while(true)
+			{
+				uint8_t byte = value & 0x7f;
+				value >>= 7;
+				if((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)))
+				{
+					stream.put(byte);
+					break;
+				}
+				stream.put(byte | 0x80);
+			}
+		}
+
+		inline void writeULeb128(std::ostream& stream, uint32_t value)
+		{
+			do
+			{
+				uint8_t byte = value & 0x7f;
+				value >>= 7;
+				if(value != 0)
+					byte |= 0x80;
+				stream.put(byte);
+			} while(value != 0);
+		}
+
+		inline void writeString(std::ostream& stream, std::string_view value)
+		{
+			writeULeb128(stream, value.size());
+			stream.write(value.data(), value.size());
+		}
+
+		inline void writeGrowing(std::ostream& stream, int64_t value)
+		{
+			if(value >= 0 && value < 268435455)
+			{
+				writeULeb128(stream, value);
+			}
+			else
+			{
+				writeULeb128(stream, 268435455);
+				writeLeb128(stream, value);
+			}
+		}
+
+		inline void writeDatetime(std::ostream& stream, int64_t value)
+		{
+			stream.write(reinterpret_cast<const char*>(&value), 8);
+		}
 	}
 
+	// How scaled multiplication and division round results that fall between
+	// two multiples of 1e-9
+	enum class Rounding
+	{
+		TowardZero,
+		Down,		// toward minus infinity
+		Up,			// toward plus infinity
+		HalfUp,		// nearest, ties away from zero
+		HalfEven	// nearest, ties to the even neighbour
+	};
+
+	namespace helpers
+	{
+		// numerator / denominator, denominator != 0
+		inline __int128 divide(__int128 numerator, __int128 denominator, Rounding rounding)
+		{
+			__int128 quotient, remainder;
+			// 128-bit division is a library call; prices rarely need it
+			if(numerator == (int64_t)numerator && denominator == (int64_t)denominator)
+			{
+				quotient = (int64_t)numerator / (int64_t)denominator;
+				remainder = (int64_t)numerator % (int64_t)denominator;
+			}
+			else
+			{
+				quotient = numerator / denominator;
+				remainder = numerator % denominator;
+			}
+			if(remainder == 0)
+				return quotient;
+			// The exact result lies between quotient and quotient + step
+			int step = (numerator < 0) == (denominator < 0) ? 1 : -1;
+			switch(rounding)
+			{
+				case Rounding::TowardZero:
+					return quotient;
+				case Rounding::Down:
+					return step < 0 ? quotient - 1 : quotient;
+				case Rounding::Up:
+					return step > 0 ? quotient + 1 : quotient;
+				default:
+					break;
+			}
+			__int128 twice = remainder < 0 ? -2 * remainder : 2 * remainder;
+			__int128 magnitude = denominator < 0 ? -denominator : denominator;
+			if(twice > magnitude || (twice == magnitude && (rounding == Rounding::HalfUp || (quotient & 1))))
+				return quotient + step;
+			return quotient;
+		}
+	}
+
+	// Exact decimal with 9 fractional digits: value is the floor of the
+	// number and fractional the rest, 0 to 999999999, so -1.5 is (-2, 500000000).
+	// Arithmetic is exact as long as the result fits; scaled multiplication
+	// and division round once, as asked.
 	struct decimal_fixed
 	{
+		static const int64_t Scale = 1000000000;
+
 		int64_t value;
 		int32_t fractional; // 1e-9 parts
 
@@ -123,11 +260,99 @@ namespace qsh
 			return (double)value + (double)fractional / 1e9;
 		}
 
+		// Billionths; |value| must stay below 9.2e9
+		int64_t toNanos() const
+		{
+			return value * Scale + fractional;
+		}
+
+		static decimal_fixed fromNanos(int64_t nanos)
+		{
+			int64_t integral = nanos / Scale;
+			int64_t fractional = nanos % Scale;
+			if(fractional < 0)
+			{
+				integral--;
+				fractional += Scale;
+			}
+			return decimal_fixed(integral, fractional);
+		}
+
+		decimal_fixed operator+(const decimal_fixed& other) const
+		{
+			decimal_fixed result(value + other.value, fractional + other.fractional);
+			if(result.fractional >= Scale)
+			{
+				result.value++;
+				result.fractional -= Scale;
+			}
+			return result;
+		}
+
+		decimal_fixed operator-(const decimal_fixed& other) const
+		{
+			decimal_fixed result(value - other.value, fractional - other.fractional);
+			if(result.fractional < 0)
+			{
+				result.value--;
+				result.fractional += Scale;
+			}
+			return result;
+		}
+
+		decimal_fixed operator-() const
+		{
+			return fractional == 0 ? decimal_fixed(-value, 0) : decimal_fixed(-value - 1, Scale - fractional);
+		}
+
+		decimal_fixed& operator+=(const decimal_fixed& other)
+		{
+			return *this = *this + other;
+		}
+
+		decimal_fixed& operator-=(const decimal_fixed& other)
+		{
+			return *this = *this - other;
+		}
+
+		decimal_fixed operator*(int64_t factor) const
+		{
+			return fromWide(wide() * factor);
+		}
+
+		// this * numerator / denominator, e.g. the mid price is
+		// (bid + ask).mulDiv(1, 2, ...) and a VWAP is notional.mulDiv(1, volume, ...)
+		decimal_fixed mulDiv(int64_t numerator, int64_t denominator, Rounding rounding = Rounding::HalfEven) const
+		{
+			if(denominator == 0)
+				throw std::runtime_error("Division by zero");
+			return fromWide(helpers::divide(wide() * numerator, denominator, rounding));
+		}
+
+		// The exact product has 18 fractional digits and is rounded to 9; it
+		// must stay below 1.7e20 in magnitude
+		decimal_fixed multiply(const decimal_fixed& other, Rounding rounding = Rounding::HalfEven) const
+		{
+			return fromWide(helpers::divide(wide() * other.wide(), Scale, rounding));
+		}
+
+		decimal_fixed divide(const decimal_fixed& other, Rounding rounding = Rounding::HalfEven) const
+		{
+			if(other.value == 0 && other.fractional == 0)
+				throw std::runtime_error("Division by zero");
+			return fromWide(helpers::divide(wide() * Scale, other.wide(), rounding));
+		}
+
 		bool operator==(const decimal_fixed& other) const
 		{
 			return (value == other.value) && (fractional == other.fractional);
 		}
 
+		bool operator!=(const decimal_fixed& other) const
+		{
+			return !(*this == other);
+		}
+
 		bool operator<(const decimal_fixed& other) const
 		{
 			if(value < other.value)
@@ -152,6 +377,246 @@ namespace qsh
 		{
 			return !(*this <= other);
 		}
+
+	private:
+		__int128 wide() const
+		{
+			return (__int128)value * Scale + fractional;
+		}
+
+		static decimal_fixed fromWide(__int128 nanos)
+		{
+			__int128 integral = nanos / Scale;
+			int64_t fractional = nanos % Scale;
+			if(fractional < 0)
+			{
+				integral--;
+				fractional += Scale;
+			}
+			return decimal_fixed((int64_t)integral, fractional);
+		}
+	};
+
+	inline decimal_fixed operator*(int64_t factor, const decimal_fixed& value)
+	{
+		return value * factor;
+	}
+
+	namespace helpers
+	{
+		constexpr int64_t powerOf10(unsigned exponent)
+		{
+			return exponent == 0 ? 1 : 10 * powerOf10(exponent - 1);
+		}
+	}
+
+	// A decimal stored as one int64 count of 10^-Digits units: half the size
+	// of decimal_fixed, and it compares, sorts and hashes as that integer.
+	// Converting from decimal_fixed throws when the value is not a whole
+	// number of units or does not fit; converting back is always exact.
+	template<unsigned Digits>
+	struct fixed_point
+	{
+		static_assert(Digits <= 9, "decimal_fixed has 9 fractional digits");
+		static const int64_t Scale = helpers::powerOf10(Digits);
+
+		int64_t raw;
+
+		fixed_point() : raw(0)
+		{
+		}
+
+		explicit fixed_point(const decimal_fixed& value)
+		{
+			const int64_t divisor = decimal_fixed::Scale / Scale;
+			if(value.fractional % divisor != 0)
+				throw std::runtime_error("Value is not a multiple of the fixed_point unit");
+			if(__builtin_mul_overflow(value.value, Scale, &raw) || __builtin_add_overflow(raw, value.fractional / divisor, &raw))
+				throw std::runtime_error("Value does not fit fixed_point");
+		}
+
+		static fixed_point fromRaw(int64_t raw)
+		{
+			fixed_point result;
+			result.raw = raw;
+			return result;
+		}
+
+		// fromRaw() for an exact intermediate result; throws if it does not fit
+		static fixed_point fromWide(__int128 raw)
+		{
+			if(raw < INT64_MIN || raw > INT64_MAX)
+				throw std::runtime_error("Value does not fit fixed_point");
+			return fromRaw((int64_t)raw);
+		}
+
+		// Nearest representable value by the rounding policy
+		static fixed_point round(const decimal_fixed& value, Rounding rounding = Rounding::HalfEven)
+		{
+			__int128 nanos = (__int128)value.value * decimal_fixed::Scale + value.fractional;
+			return fromWide(helpers::divide(nanos, decimal_fixed::Scale / Scale, rounding));
+		}
+
+		decimal_fixed toDecimal() const
+		{
+			int64_t integral = raw / Scale;
+			int64_t rest = raw % Scale;
+			if(rest < 0)
+			{
+				integral--;
+				rest += Scale;
+			}
+			return decimal_fixed(integral, rest * (decimal_fixed::Scale / Scale));
+		}
+
+		double toDouble() const
+		{
+			return (double)raw / Scale;
+		}
+
+		fixed_point operator+(fixed_point other) const
+		{
+			return fromRaw(raw + other.raw);
+		}
+
+		fixed_point operator-(fixed_point other) const
+		{
+			return fromRaw(raw - other.raw);
+		}
+
+		fixed_point operator-() const
+		{
+			return fromRaw(-raw);
+		}
+
+		fixed_point& operator+=(fixed_point other)
+		{
+			raw += other.raw;
+			return *this;
+		}
+
+		fixed_point& operator-=(fixed_point other)
+		{
+			raw -= other.raw;
+			return *this;
+		}
+
+		fixed_point operator*(int64_t factor) const
+		{
+			return fromRaw(raw * factor);
+		}
+
+		fixed_point mulDiv(int64_t numerator, int64_t denominator, Rounding rounding = Rounding::HalfEven) const
+		{
+			if(denominator == 0)
+				throw std::runtime_error("Division by zero");
+			return fromWide(helpers::divide((__int128)raw * numerator, denominator, rounding));
+		}
+
+		bool operator==(fixed_point other) const
+		{
+			return raw == other.raw;
+		}
+
+		bool operator!=(fixed_point other) const
+		{
+			return raw != other.raw;
+		}
+
+		bool operator<(fixed_point other) const
+		{
+			return raw < other.raw;
+		}
+
+		bool operator<=(fixed_point other) const
+		{
+			return raw <= other.raw;
+		}
+
+		bool operator>(fixed_point other) const
+		{
+			return raw > other.raw;
+		}
+
+		bool operator>=(fixed_point other) const
+		{
+			return raw >= other.raw;
+		}
+	};
+
+	// Every decimal_fixed in [-9.2e9, 9.2e9]
+	using fixed_nanos = fixed_point<9>;
+
+	// Decoded OrdLog frame, also available as QshFile<Sink>::OrderLogEntry
+	struct OrderLogEntry
+	{
+		datetime_t frameTimestamp;
+
+		enum Flags
+		{
+			NonZeroReplAct = (1 << 0),
+			SessIdChanged = (1 << 1),
+			Add = (1 << 2),
+			Fill = (1 << 3),
+			Buy = (1 << 4),
+			Sell = (1 << 5),
+			Quote = (1 << 7),
+			Counter = (1 << 8),
+			NonSystem = (1 << 9),
+			EndOfTransaction = (1 << 10),
+			FillOrKill = (1 << 11),
+			Moved = (1 << 12),
+			Cancelled = (1 << 13),
+			CancelledGroup = (1 << 14),
+			CrossTrade = (1 << 15)
+		};
+
+		int streamNumber;
+		uint16_t flags;
+		datetime_t timestamp;
+		long long orderId;
+		decimal_fixed orderPrice;
+		int volume;
+		int remain;
+		long long matchingOrderId;
+		decimal_fixed tradePrice;
+		long openInterest;
+	};
+
+	// One trade as the Deals stream carries it: type is the aggressor side.
+	// Consumers implement dealFrame(const Deal&); TradeReconstructor builds
+	// these from OrdLog fills.
+	struct Deal
+	{
+		enum Type
+		{
+			Unknown = 0,
+			Buy = 1,
+			Sell = 2
+		};
+
+		datetime_t frameTimestamp;
+		int streamNumber;
+		Type type;
+		datetime_t timestamp;
+		long long id;
+		long long buyOrderId;	// 0 if not known
+		long long sellOrderId;
+		decimal_fixed price;
+		int volume;
+		long openInterest;
+	};
+}
+
+namespace std
+{
+	template<unsigned Digits>
+	struct hash<qsh::fixed_point<Digits>>
+	{
+		size_t operator()(qsh::fixed_point<Digits> value) const
+		{
+			return hash<int64_t>()(value.raw);
+		}
 	};
 }
 
@@ -0,0 +1,403 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "qshfile.h"
+#include "follow.h"
+#include "pipeline.h"
+#include "readahead.h"
+#include "stats.h"
+
+namespace qsh
+{
+	// Differential verification: decodes one file with several engines and
+	// checks that all of them deliver exactly the entries of the reference
+	// engine (ifstream with sequential parts decoding, the original path).
+	//
+	// The first pass keeps only a rolling hash per engine, sampled every
+	// 'interval' frames. If an engine diverges, a second pass re-decodes the
+	// block of frames around the first mismatching sample and compares entry
+	// by entry, field by field, so memory stays constant in the size of the
+	// file.
+	namespace verify
+	{
+		inline uint64_t mix(uint64_t value)
+		{
+			// splitmix64 finalizer
+			value ^= value >> 30;
+			value *= 0xbf58476d1ce4e5b9ull;
+			value ^= value >> 27;
+			value *= 0x94d049bb133111ebull;
+			value ^= value >> 31;
+			return value;
+		}
+
+		// Hash of every field of an entry, chained onto 'seed'
+		inline uint64_t hashEntry(uint64_t seed, const OrderLogEntry& entry)
+		{
+			uint64_t fields[] = {
+				(uint64_t)entry.frameTimestamp,
+				(uint64_t)entry.streamNumber,
+				(uint64_t)entry.flags,
+				(uint64_t)entry.timestamp,
+				(uint64_t)entry.orderId,
+				(uint64_t)entry.orderPrice.value,
+				(uint64_t)entry.orderPrice.fractional,
+				(uint64_t)entry.volume,
+				(uint64_t)entry.remain,
+				(uint64_t)entry.matchingOrderId,
+				(uint64_t)entry.tradePrice.value,
+				(uint64_t)entry.tradePrice.fractional,
+				(uint64_t)entry.openInterest
+			};
+			uint64_t hash = seed;
+			for(auto field : fields)
+				hash = mix(hash ^ (field + 0x9e3779b97f4a7c15ull));
+			return hash;
+		}
+
+		// Name of the first field in which the entries differ, nullptr if
+		// they are equal. Compares the fields themselves, not their hashes.
+		inline const char* differingField(const OrderLogEntry& a, const OrderLogEntry& b)
+		{
+			if(a.frameTimestamp != b.frameTimestamp)
+				return "frameTimestamp";
+			if(a.streamNumber != b.streamNumber)
+				return "streamNumber";
+			if(a.flags != b.flags)
+				return "flags";
+			if(a.timestamp != b.timestamp)
+				return "timestamp";
+			if(a.orderId != b.orderId)
+				return "orderId";
+			if(a.orderPrice.value != b.orderPrice.value || a.orderPrice.fractional != b.orderPrice.fractional)
+				return "orderPrice";
+			if(a.volume != b.volume)
+				return "volume";
+			if(a.remain != b.remain)
+				return "remain";
+			if(a.matchingOrderId != b.matchingOrderId)
+				return "matchingOrderId";
+			if(a.tradePrice.value != b.tradePrice.value || a.tradePrice.fractional != b.tradePrice.fractional)
+				return "tradePrice";
+			if(a.openInterest != b.openInterest)
+				return "openInterest";
+			return nullptr;
+		}
+
+		inline bool sameEntry(const OrderLogEntry& a, const OrderLogEntry& b)
+		{
+			return differingField(a, b) == nullptr;
+		}
+
+		inline std::string formatEntry(const OrderLogEntry& entry)
+		{
+			char buffer[320];
+			snprintf(buffer, sizeof(buffer),
+					"frameTimestamp=%" PRId64 " stream=%d flags=0x%04x timestamp=%" PRId64 " orderId=%lld"
+					" orderPrice=%" PRId64 ".%09d volume=%d remain=%d matchingOrderId=%lld tradePrice=%" PRId64 ".%09d"
+					" openInterest=%ld",
+					(int64_t)entry.frameTimestamp, entry.streamNumber, entry.flags, (int64_t)entry.timestamp,
+					entry.orderId, entry.orderPrice.value, entry.orderPrice.fractional, entry.volume, entry.remain,
+					entry.matchingOrderId, entry.tradePrice.value, entry.tradePrice.fractional, entry.openInterest);
+			return buffer;
+		}
+
+		// The sink every engine decodes into. Keeps the rolling hash, a
+		// sample of it every 'interval' frames, and, for the frames in
+		// [detailFirst, detailFirst + detailCount), the entries themselves.
+		class Recorder
+		{
+		public:
+			explicit Recorder(uint64_t interval, uint64_t detailFirst = 0, uint64_t detailCount = 0) : interval_(interval),
+				detailFirst_(detailFirst),
+				detailCount_(detailCount),
+				frames_(0),
+				hash_(0)
+			{
+				if(interval_ == 0)
+					throw std::runtime_error("Invalid interval");
+			}
+
+			void orderLogFrame(const OrderLogEntry& entry)
+			{
+				hash_ = hashEntry(hash_, entry);
+				if(frames_ - detailFirst_ < detailCount_)
+					detail_.push_back(entry);
+				frames_++;
+				if(frames_ % interval_ == 0)
+					samples_.push_back(hash_);
+			}
+
+			uint64_t frames() const
+			{
+				return frames_;
+			}
+
+			uint64_t hash() const
+			{
+				return hash_;
+			}
+
+			const std::vector<uint64_t>& samples() const
+			{
+				return samples_;
+			}
+
+			const std::vector<OrderLogEntry>& detail() const
+			{
+				return detail_;
+			}
+
+		private:
+			uint64_t interval_;
+			uint64_t detailFirst_;
+			uint64_t detailCount_;
+			uint64_t frames_;
+			uint64_t hash_;
+			std::vector<uint64_t> samples_;
+			std::vector<OrderLogEntry> detail_;
+		};
+
+		struct Engine
+		{
+			std::string name;
+			std::function<void(const std::string& path, Recorder& recorder)> decode;
+		};
+
+		inline void decodeIstream(std::istream& stream, Recorder& recorder, ordlog::PartsDecoding decoding)
+		{
+			QshFile<Recorder> file(stream, recorder);
+			file.setPartsDecoding(decoding);
+			file.readAllFrames();
+		}
+
+		// The reference, followed by every engine in the library
+		inline std::vector<Engine> engines()
+		{
+			std::vector<Engine> result;
+			result.push_back({ "reference", [](const std::string& path, Recorder& recorder)
+					{
+						std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+						decodeIstream(stream, recorder, ordlog::PartsDecoding::Sequential);
+					} });
+			result.push_back({ "table", [](const std::string& path, Recorder& recorder)
+					{
+						std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+						decodeIstream(stream, recorder, ordlog::PartsDecoding::Table);
+					} });
+			result.push_back({ "stats", [](const std::string& path, Recorder& recorder)
+					{
+						std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+						QshFile<Recorder, DecoderStats> file(stream, recorder);
+						file.readAllFrames();
+					} });
+			result.push_back({ "mmap", [](const std::string& path, Recorder& recorder)
+					{
+						MmapStreambuf buffer(path);
+						std::istream stream(&buffer);
+						decodeIstream(stream, recorder, ordlog::PartsDecoding::Table);
+					} });
+			result.push_back({ "readahead-thread", [](const std::string& path, Recorder& recorder)
+					{
+						ReadAheadStreambuf buffer(path, 64 * 1024, 4, ReadAheadStreambuf::Backend::Thread);
+						std::istream stream(&buffer);
+						decodeIstream(stream, recorder, ordlog::PartsDecoding::Table);
+					} });
+			result.push_back({ "readahead-auto", [](const std::string& path, Recorder& recorder)
+					{
+						ReadAheadStreambuf buffer(path, 64 * 1024, 4, ReadAheadStreambuf::Backend::Auto);
+						std::istream stream(&buffer);
+						decodeIstream(stream, recorder, ordlog::PartsDecoding::Table);
+					} });
+			result.push_back({ "pipelined", [](const std::string& path, Recorder& recorder)
+					{
+						std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+						PipelinedReader<Recorder> reader(stream, recorder, Backpressure::Yield, 256, 16);
+						reader.readAllFrames();
+					} });
+			result.push_back({ "follower", [](const std::string& path, Recorder& recorder)
+					{
+						QshFollower<Recorder> follower(path, recorder);
+						follower.poll();
+					} });
+			return result;
+		}
+
+		struct EngineResult
+		{
+			std::string name;
+			uint64_t frames;
+			uint64_t hash;
+			std::string error;	// exception thrown by the engine, if any
+			bool matches;
+		};
+
+		struct Divergence
+		{
+			std::string engine;
+			uint64_t frame;	// index of the first differing frame
+			int64_t offset;	// of that frame in the file, -1 past the end
+			bool hasExpected;	// false if the engine produced extra frames
+			bool hasActual;	// false if the engine stopped early
+			std::string field;	// first differing field when both entries exist
+			OrderLogEntry expected;
+			OrderLogEntry actual;
+		};
+
+		struct Report
+		{
+			std::string path;
+			std::vector<EngineResult> results;	// the reference first
+			std::vector<Divergence> divergences;	// one per mismatching engine
+
+			bool ok() const
+			{
+				return divergences.empty();
+			}
+
+			std::string toString() const
+			{
+				std::string result = path + "\n";
+				char line[256];
+				for(const auto& engine : results)
+				{
+					snprintf(line, sizeof(line), "  %-20s %12" PRIu64 " frames  %016" PRIx64 "  %s%s\n", engine.name.c_str(),
+							engine.frames, engine.hash, engine.matches ? "ok" : "MISMATCH",
+							engine.error.empty() ? "" : (" (" + engine.error + ")").c_str());
+					result += line;
+				}
+				for(const auto& divergence : divergences)
+				{
+					snprintf(line, sizeof(line), "  %s: first divergent frame %" PRIu64 " at offset %" PRId64 "%s%s\n",
+							divergence.engine.c_str(), divergence.frame, divergence.offset,
+							divergence.field.empty() ? "" : ", field ", divergence.field.c_str());
+					result += line;
+					result += "    expected: " + (divergence.hasExpected ? formatEntry(divergence.expected) : "end of data") + "\n";
+					result += "    actual:   " + (divergence.hasActual ? formatEntry(divergence.actual) : "end of data") + "\n";
+				}
+				return result;
+			}
+		};
+
+		inline void run(const Engine& engine, const std::string& path, Recorder& recorder, std::string& error)
+		{
+			try
+			{
+				engine.decode(path, recorder);
+			}
+			catch(const std::exception& e)
+			{
+				error = e.what();
+			}
+		}
+
+		// File offsets of frames [first, first + count) according to the
+		// reference decoder
+		inline std::vector<int64_t> frameOffsets(const std::string& path, uint64_t first, uint64_t count)
+		{
+			std::vector<int64_t> offsets;
+			std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+			Recorder recorder(1);
+			QshFile<Recorder> file(stream, recorder);
+			file.setPartsDecoding(ordlog::PartsDecoding::Sequential);
+			for(uint64_t frame = 0; frame < first + count; frame++)
+			{
+				if(stream.peek() == std::char_traits<char>::eof())
+					break;
+				int64_t offset = stream.tellg();
+				if(frame >= first)
+					offsets.push_back(offset);
+				file.readOneFrame();
+			}
+			return offsets;
+		}
+
+		inline Divergence locate(const Engine& reference, const Engine& engine, const std::string& path,
+				const Recorder& expected, const Recorder& actual, uint64_t interval)
+		{
+			// First block whose sample differs or is missing on one side
+			size_t block = 0;
+			while(block < expected.samples().size() && block < actual.samples().size() &&
+					expected.samples()[block] == actual.samples()[block])
+				block++;
+
+			uint64_t first = block * interval;
+			Recorder expectedDetail(interval, first, interval);
+			Recorder actualDetail(interval, first, interval);
+			std::string error;
+			run(reference, path, expectedDetail, error);
+			run(engine, path, actualDetail, error);
+
+			Divergence result = {};
+			result.engine = engine.name;
+			const auto& a = expectedDetail.detail();
+			const auto& b = actualDetail.detail();
+			size_t i = 0;
+			while(i < a.size() && i < b.size() && sameEntry(a[i], b[i]))
+				i++;
+			result.frame = first + i;
+			result.hasExpected = i < a.size();
+			result.hasActual = i < b.size();
+			if(result.hasExpected)
+				result.expected = a[i];
+			if(result.hasActual)
+				result.actual = b[i];
+			if(result.hasExpected && result.hasActual)
+				result.field = differingField(a[i], b[i]);
+
+			auto offsets = frameOffsets(path, result.frame, 1);
+			result.offset = offsets.empty() ? -1 : offsets[0];
+			return result;
+		}
+
+		// The first engine is the reference
+		inline Report compare(const std::string& path, const std::vector<Engine>& engines, uint64_t interval = 4096)
+		{
+			if(engines.empty())
+				throw std::runtime_error("No engines");
+
+			Report report;
+			report.path = path;
+			std::vector<Recorder> recorders;
+			recorders.reserve(engines.size());
+			for(const auto& engine : engines)
+			{
+				recorders.emplace_back(interval);
+				EngineResult result = {};
+				result.name = engine.name;
+				run(engine, path, recorders.back(), result.error);
+				result.frames = recorders.back().frames();
+				result.hash = recorders.back().hash();
+				report.results.push_back(result);
+			}
+
+			const EngineResult& reference = report.results[0];
+			if(!reference.error.empty())
+				throw std::runtime_error("Reference decoder failed: " + reference.error);
+			for(size_t i = 0; i < engines.size(); i++)
+			{
+				EngineResult& result = report.results[i];
+				result.matches = result.error.empty() && result.frames == reference.frames && result.hash == reference.hash;
+				if(!result.matches)
+					report.divergences.push_back(locate(engines[0], engines[i], path, recorders[0], recorders[i], interval));
+			}
+			return report;
+		}
+
+		inline Report compare(const std::string& path, uint64_t interval = 4096)
+		{
+			return compare(path, engines(), interval);
+		}
+	}
+}
+
+#endif /* ifndef VERIFY_H */
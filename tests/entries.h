@@ -0,0 +1,32 @@
+#ifndef ENTRIES_H
+#define ENTRIES_H
+
+#include <cstdint>
+
+#include "qsh/types.h"
+
+namespace qsh
+{
+	namespace testing
+	{
+		// An OrdLog entry at a whole price, for hand-written scenarios; the
+		// exchange and frame times are both 'time'
+		inline OrderLogEntry entry(uint16_t flags, long long orderId, int64_t price, int volume, datetime_t time = 0)
+		{
+			OrderLogEntry result = {};
+			result.flags = flags;
+			result.orderId = orderId;
+			result.orderPrice = decimal_fixed(price, 0);
+			result.volume = volume;
+			result.timestamp = time;
+			result.frameTimestamp = time;
+			return result;
+		}
+
+		// Side and Quote only; the action (Add, Fill, ...) is added by the test
+		const uint16_t BuyQuote = OrderLogEntry::Buy | OrderLogEntry::Quote;
+		const uint16_t SellQuote = OrderLogEntry::Sell | OrderLogEntry::Quote;
+	}
+}
+
+#endif /* ifndef ENTRIES_H */
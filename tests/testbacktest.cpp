@@ -0,0 +1,289 @@
+#include "catch/catch.hpp"
+#include "qsh/backtest.h"
+#include "qsh/qshfile.h"
+#include "entries.h"
+
+#include <fstream>
+#include <vector>
+
+using namespace qsh;
+using namespace qsh::testing;
+
+namespace
+{
+	// Real volume in front of a virtual order, from the book itself
+	int64_t realAhead(const MatchingSimulator& simulator, const backtest::Order& order)
+	{
+		const book::Level* level = simulator.book().level(order.side, order.price);
+		int64_t volume = 0;
+		for(const book::Order* real = level ? level->head : nullptr; real; real = real->next)
+		{
+			if(real->sequence < order.sequence)
+				volume += real->volume;
+		}
+		return volume;
+	}
+
+	// Keeps one lot at the best bid and the best ask, requoting when the
+	// order is filled or the best price moves
+	class QuotingStrategy
+	{
+	public:
+		explicit QuotingStrategy(MatchingSimulator& simulator) : simulator_(simulator),
+			events(0),
+			checks(0)
+		{
+			quotes_[0] = quotes_[1] = UINT64_MAX;
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			simulator_.orderLogFrame(entry);
+			events++;
+			if(!(entry.flags & OrderLogEntry::EndOfTransaction))
+				return;
+
+			for(auto side : { book::Bid, book::Ask })
+			{
+				const L3Book& book = simulator_.book();
+				uint64_t& quote = quotes_[side];
+				bool working = quote != UINT64_MAX && simulator_.order(quote).status == backtest::Status::Working;
+				if(working && events % 97 == 0)
+				{
+					REQUIRE(simulator_.order(quote).ahead == realAhead(simulator_, simulator_.order(quote)));
+					checks++;
+				}
+				if(book.empty(side))
+					continue;
+				if(working && simulator_.order(quote).price == book.best(side))
+					continue;
+				if(working)
+					simulator_.cancel(quote);
+				quote = simulator_.submit(side, book.best(side), 1);
+			}
+		}
+
+	private:
+		MatchingSimulator& simulator_;
+		uint64_t quotes_[2];
+
+	public:
+		uint64_t events;
+		uint64_t checks;
+	};
+
+	std::vector<backtest::Fill> replaySample(uint64_t& checks)
+	{
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		MatchingSimulator simulator(1);
+		QuotingStrategy strategy(simulator);
+		QshFile<QuotingStrategy> file(stream, strategy);
+		file.readAllFrames();
+		checks = strategy.checks;
+		REQUIRE(simulator.book().unknownOrders() == 0);
+		return simulator.fills();
+	}
+}
+
+TEST_CASE("MatchingSimulator", "[backtest]")
+{
+	MatchingSimulator simulator(1);
+
+	SECTION("Queue position")
+	{
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 1, 100, 5));
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 2, 100, 3));
+		auto id = simulator.submit(book::Bid, 100, 2);
+		REQUIRE(simulator.order(id).ahead == 8);
+		REQUIRE(simulator.working() == 1);
+
+		// Behind the virtual order
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 3, 100, 4));
+		REQUIRE(simulator.order(id).ahead == 8);
+
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Cancelled, 1, 100, 5));
+		REQUIRE(simulator.order(id).ahead == 3);
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill, 2, 100, 3));
+		REQUIRE(simulator.order(id).ahead == 0);
+		REQUIRE(simulator.fills().empty());
+
+		// The aggressor reached an order behind the virtual one
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill, 3, 100, 3));
+		REQUIRE(simulator.fills().size() == 1);
+		REQUIRE(simulator.fills()[0].orderId == id);
+		REQUIRE(simulator.fills()[0].price == 100);
+		REQUIRE(simulator.fills()[0].volume == 2);
+		REQUIRE(simulator.fills()[0].passive);
+		REQUIRE(simulator.order(id).status == backtest::Status::Filled);
+		REQUIRE(simulator.working() == 0);
+
+		// The replay is not altered
+		REQUIRE(simulator.book().level(book::Bid, 100)->volume == 1);
+	}
+
+	SECTION("Time priority among virtual orders")
+	{
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Add, 1, 100, 1));
+		auto first = simulator.submit(book::Ask, 100, 2);
+		auto second = simulator.submit(book::Ask, 100, 2);
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Add, 2, 100, 10));
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Fill, 1, 100, 1));
+		REQUIRE(simulator.fills().empty());
+
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Fill, 2, 100, 3));
+		REQUIRE(simulator.order(first).status == backtest::Status::Filled);
+		REQUIRE(simulator.order(second).filled == 1);
+		REQUIRE(simulator.order(second).status == backtest::Status::Working);
+		REQUIRE(simulator.fills().size() == 2);
+	}
+
+	SECTION("Trade through")
+	{
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 1, 100, 10));
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 2, 99, 10));
+		auto id = simulator.submit(book::Bid, 100, 5);
+		REQUIRE(simulator.order(id).ahead == 10);
+
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill, 2, 99, 3));
+		REQUIRE(simulator.order(id).filled == 3);
+
+		// An aggressor is logged as an Add, then the fills; this one only
+		// took a lot of the real order ahead of the virtual one
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Add, 3, 100, 1));
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Fill, 3, 100, 1));
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill | OrderLogEntry::EndOfTransaction, 1, 100, 1));
+		REQUIRE(simulator.order(id).filled == 3);
+		REQUIRE(simulator.order(id).ahead == 9);
+
+		// Asks above the bid do not touch it
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Add | OrderLogEntry::EndOfTransaction, 4, 101, 5));
+		REQUIRE(simulator.order(id).filled == 3);
+
+		// This one took all of the real order ahead and rests at the bid with
+		// 3 lots, which would have met the virtual order
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Add, 5, 100, 12));
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Fill, 5, 100, 9));
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill | OrderLogEntry::EndOfTransaction, 1, 100, 9));
+		REQUIRE(simulator.order(id).status == backtest::Status::Filled);
+		REQUIRE(simulator.fills().size() == 2);
+		REQUIRE(simulator.fills()[1].price == 100);
+		REQUIRE(simulator.fills()[1].volume == 2);
+		REQUIRE(simulator.fills()[1].passive);
+
+		// Only the lot left over can fill another order, once
+		auto next = simulator.submit(book::Bid, 100, 5);
+		REQUIRE(simulator.order(next).filled == 1);
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add | OrderLogEntry::EndOfTransaction, 6, 98, 1));
+		REQUIRE(simulator.order(next).filled == 1);
+		REQUIRE(simulator.fills().size() == 3);
+	}
+
+	SECTION("One fill volume for all levels")
+	{
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 1, 99, 10));
+		auto behind = simulator.submit(book::Bid, 99, 5);
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 2, 99, 10));
+		auto better = simulator.submit(book::Bid, 100, 3);
+
+		// 4 lots traded at 99: 3 went to the better price, 1 is left for
+		// the order queued ahead of the real one
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill, 2, 99, 4));
+		REQUIRE(simulator.fills().size() == 2);
+		REQUIRE(simulator.fills()[0].orderId == better);
+		REQUIRE(simulator.fills()[0].price == 100);
+		REQUIRE(simulator.fills()[0].volume == 3);
+		REQUIRE(simulator.fills()[1].orderId == behind);
+		REQUIRE(simulator.fills()[1].volume == 1);
+		REQUIRE(simulator.order(better).status == backtest::Status::Filled);
+		REQUIRE(simulator.order(behind).filled == 1);
+
+		// Never more virtual volume than was traded
+		simulator.clearFills();
+		auto again = simulator.submit(book::Bid, 100, 10);
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill, 2, 99, 2));
+		int64_t filled = 0;
+		for(const auto& fill : simulator.fills())
+			filled += fill.volume;
+		REQUIRE(filled == 2);
+		REQUIRE(simulator.order(again).filled == 2);
+		REQUIRE(simulator.order(behind).filled == 1);
+	}
+
+	SECTION("Ladder of orders")
+	{
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add, 1, 90, 20));
+		std::vector<uint64_t> ids;
+		for(int64_t price = 100; price > 90; price--)
+			ids.push_back(simulator.submit(book::Bid, price, 1));
+		auto second = simulator.submit(book::Bid, 95, 1);
+		REQUIRE(simulator.cancel(ids[5]));
+		REQUIRE(simulator.working() == 10);
+
+		// The fill at 90 went through the levels above it, best first
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Fill, 1, 90, 7));
+		REQUIRE(simulator.fills().size() == 7);
+		for(size_t i = 0; i < 7; i++)
+			REQUIRE(simulator.fills()[i].price == 100 - (int64_t)i);
+		REQUIRE(simulator.fills()[5].orderId == second);
+		REQUIRE(simulator.working() == 3);
+		REQUIRE(simulator.order(ids[7]).status == backtest::Status::Working);
+	}
+
+	SECTION("Marketable orders")
+	{
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Add, 1, 101, 2));
+		simulator.orderLogFrame(entry(SellQuote | OrderLogEntry::Add, 2, 102, 5));
+		auto id = simulator.submit(book::Bid, 102, 4);
+		REQUIRE(simulator.order(id).status == backtest::Status::Filled);
+		REQUIRE(simulator.fills().size() == 2);
+		REQUIRE(simulator.fills()[0].price == 101);
+		REQUIRE(simulator.fills()[0].volume == 2);
+		REQUIRE(!simulator.fills()[0].passive);
+		REQUIRE(simulator.fills()[1].price == 102);
+		REQUIRE(simulator.fills()[1].volume == 2);
+		REQUIRE(simulator.working() == 0);
+
+		// The lots the first order met are gone for the next one
+		simulator.clearFills();
+		id = simulator.submit(book::Bid, 102, 5);
+		REQUIRE(simulator.order(id).filled == 3);
+		REQUIRE(simulator.fills().size() == 1);
+		REQUIRE(simulator.fills()[0].price == 102);
+		REQUIRE(simulator.order(id).status == backtest::Status::Working);
+		REQUIRE(simulator.order(id).ahead == 0);
+	}
+
+	SECTION("Cancel and session change")
+	{
+		auto a = simulator.submit(book::Bid, 100, 1);
+		auto b = simulator.submit(book::Ask, 110, 1);
+		REQUIRE(simulator.cancel(a));
+		REQUIRE(!simulator.cancel(a));
+		REQUIRE(simulator.order(a).status == backtest::Status::Cancelled);
+
+		simulator.orderLogFrame(entry(BuyQuote | OrderLogEntry::Add | OrderLogEntry::SessIdChanged, 1, 105, 1));
+		REQUIRE(simulator.order(b).status == backtest::Status::Expired);
+		REQUIRE(simulator.working() == 0);
+		REQUIRE_THROWS(simulator.order(2));
+		REQUIRE_THROWS(simulator.submit(book::Bid, 100, 0));
+	}
+}
+
+TEST_CASE("MatchingSimulator on sample file", "[backtest]")
+{
+	uint64_t checks = 0;
+	auto fills = replaySample(checks);
+	REQUIRE(checks > 100);
+	REQUIRE(fills.size() > 10);
+
+	uint64_t again = 0;
+	auto replayed = replaySample(again);
+	REQUIRE(replayed.size() == fills.size());
+	for(size_t i = 0; i < fills.size(); i++)
+	{
+		REQUIRE(replayed[i].orderId == fills[i].orderId);
+		REQUIRE(replayed[i].time == fills[i].time);
+		REQUIRE(replayed[i].price == fills[i].price);
+		REQUIRE(replayed[i].volume == fills[i].volume);
+	}
+}
@@ -0,0 +1,176 @@
+
+#include "catch/catch.hpp"
+#include "qsh/bars.h"
+#include "qsh/qshfile.h"
+
+#include <fstream>
+
+using namespace qsh;
+
+namespace
+{
+	OrderLogEntry fill(datetime_t time, long long tradeId, decimal_fixed price, int volume)
+	{
+		OrderLogEntry entry = {};
+		entry.timestamp = time;
+		entry.frameTimestamp = time + 1000;
+		entry.flags = OrderLogEntry::Fill | OrderLogEntry::Buy | OrderLogEntry::Quote;
+		entry.matchingOrderId = tradeId;
+		entry.tradePrice = price;
+		entry.volume = volume;
+		return entry;
+	}
+
+	class TradeTotals
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			if((entry.flags & OrderLogEntry::Fill) && entry.matchingOrderId != lastTradeId)
+			{
+				lastTradeId = entry.matchingOrderId;
+				trades++;
+				volume += entry.volume;
+			}
+		}
+
+		long long lastTradeId = 0;
+		int64_t trades = 0;
+		int64_t volume = 0;
+	};
+}
+
+TEST_CASE("BarAggregator", "")
+{
+	SECTION("Hand-made trades")
+	{
+		std::vector<BarSpec> specs = { { BarSpec::Time, 60000 }, { BarSpec::Volume, 10 }, { BarSpec::Ticks, 2 } };
+		BarAggregator<> aggregator(specs, 0.01);
+
+		// The second entry of each pair repeats the trade id and is ignored
+		aggregator.orderLogFrame(fill(60000, 1, decimal_fixed(100, 0), 4));
+		aggregator.orderLogFrame(fill(60000, 1, decimal_fixed(100, 0), 4));
+		aggregator.orderLogFrame(fill(90000, 2, decimal_fixed(100, 50000000), 8));
+		aggregator.orderLogFrame(fill(90000, 2, decimal_fixed(100, 50000000), 8));
+		aggregator.orderLogFrame(fill(125000, 3, decimal_fixed(99, 990000000), 3));
+		aggregator.flush();
+
+		auto& bars = aggregator.bars();
+		REQUIRE(bars.size() == 6);
+
+		// Emission order: volume bar (12 crosses 10), tick bar, minute bar,
+		// then the remaining open bars on flush
+		REQUIRE(bars.spec[0] == 1);
+		REQUIRE(bars.volume[0] == 10);
+		REQUIRE(bars.open[0] == 10000);
+		REQUIRE(bars.close[0] == 10005);
+		REQUIRE(bars.trades[0] == 2);
+
+		REQUIRE(bars.spec[1] == 2);
+		REQUIRE(bars.volume[1] == 12);
+		REQUIRE(bars.high[1] == 10005);
+
+		REQUIRE(bars.spec[2] == 0);
+		REQUIRE(bars.openTime[2] == 60000);
+		REQUIRE(bars.closeTime[2] == 90000);
+		REQUIRE(bars.open[2] == 10000);
+		REQUIRE(bars.high[2] == 10005);
+		REQUIRE(bars.low[2] == 10000);
+		REQUIRE(bars.close[2] == 10005);
+		REQUIRE(bars.volume[2] == 12);
+
+		REQUIRE(bars.spec[3] == 0);
+		REQUIRE(bars.openTime[3] == 120000);
+		REQUIRE(bars.close[3] == 9999);
+
+		REQUIRE(bars.spec[4] == 1);
+		REQUIRE(bars.volume[4] == 5);
+		REQUIRE(bars.open[4] == 10005);
+		REQUIRE(bars.low[4] == 9999);
+
+		REQUIRE(bars.spec[5] == 2);
+		REQUIRE(bars.trades[5] == 1);
+	}
+
+	SECTION("Interleaved fill pairs")
+	{
+		BarAggregator<> aggregator({ { BarSpec::Ticks, 1000 } }, 1);
+		auto entry = [](int stream, long long tradeId, int volume, bool last)
+		{
+			OrderLogEntry result = fill(60000, tradeId, decimal_fixed(100, 0), volume);
+			result.streamNumber = stream;
+			if(last)
+				result.flags |= OrderLogEntry::EndOfTransaction;
+			return result;
+		};
+
+		// Two trades of one transaction with their entries interleaved, and
+		// a transaction of another stream in between
+		aggregator.orderLogFrame(entry(0, 1, 3, false));
+		aggregator.orderLogFrame(entry(0, 2, 5, false));
+		aggregator.orderLogFrame(entry(1, 1, 7, false));
+		aggregator.orderLogFrame(entry(0, 1, 3, false));
+		aggregator.orderLogFrame(entry(1, 1, 7, true));
+		aggregator.orderLogFrame(entry(0, 2, 5, true));
+		// A later trade may reuse an id once its transaction has ended
+		aggregator.orderLogFrame(entry(0, 2, 2, false));
+		aggregator.flush();
+
+		auto& bars = aggregator.bars();
+		REQUIRE(bars.size() == 1);
+		REQUIRE(bars.trades[0] == 4);
+		REQUIRE(bars.volume[0] == 3 + 5 + 7 + 2);
+	}
+
+	SECTION("Frame clock")
+	{
+		BarAggregator<BarClock::Frame> aggregator({ { BarSpec::Time, 1000 } }, 1);
+		aggregator.orderLogFrame(fill(500, 1, decimal_fixed(7000, 0), 1));
+		aggregator.flush();
+		REQUIRE(aggregator.bars().openTime[0] == 1000);
+		REQUIRE(aggregator.bars().closeTime[0] == 1500);
+	}
+
+	SECTION("Sample file")
+	{
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		std::vector<BarSpec> specs = { { BarSpec::Time, 60000 }, { BarSpec::Volume, 100 }, { BarSpec::Ticks, 50 } };
+
+		struct Both
+		{
+			void orderLogFrame(const OrderLogEntry& entry)
+			{
+				totals.orderLogFrame(entry);
+				bars->orderLogFrame(entry);
+			}
+			TradeTotals totals;
+			BarAggregator<>* bars;
+		} sink;
+		BarAggregator<> aggregator(specs, 1);
+		sink.bars = &aggregator;
+		QshFile<Both> file(stream, sink);
+		file.readAllFrames();
+		aggregator.flush();
+
+		const auto& bars = aggregator.bars();
+		std::vector<int64_t> volume(specs.size());
+		std::vector<int64_t> trades(specs.size());
+		for(size_t i = 0; i < bars.size(); i++)
+		{
+			volume[bars.spec[i]] += bars.volume[i];
+			trades[bars.spec[i]] += bars.trades[i];
+			REQUIRE(bars.low[i] <= bars.open[i]);
+			REQUIRE(bars.low[i] <= bars.close[i]);
+			REQUIRE(bars.high[i] >= bars.open[i]);
+			REQUIRE(bars.high[i] >= bars.close[i]);
+			REQUIRE(bars.openTime[i] <= bars.closeTime[i]);
+			if(bars.spec[i] == 1 && i + 1 < bars.size())
+				REQUIRE(bars.volume[i] <= 100);
+		}
+		REQUIRE(sink.totals.trades > 0);
+		for(size_t i = 0; i < specs.size(); i++)
+			REQUIRE(volume[i] == sink.totals.volume);
+		REQUIRE(trades[0] == sink.totals.trades);
+		REQUIRE(trades[2] == sink.totals.trades);
+	}
+}
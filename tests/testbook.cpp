@@ -0,0 +1,352 @@
+#include "catch/catch.hpp"
+#include "qsh/book.h"
+#include "qsh/qshfile.h"
+#include "entries.h"
+
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <unordered_map>
+
+using namespace qsh;
+using namespace qsh::testing;
+
+namespace
+{
+	// Every level agrees with the orders queued in it
+	void requireConsistent(const L3Book& book)
+	{
+		for(auto side : { book::Bid, book::Ask })
+		{
+			size_t levels = 0;
+			int64_t previous = 0;
+			book.forEachLevel(side, book.levels(side), [&](int64_t price, const book::Level& level)
+					{
+						if(levels > 0)
+							REQUIRE((side == book::Bid ? price < previous : price > previous));
+						previous = price;
+						levels++;
+
+						int64_t volume = 0;
+						uint32_t orders = 0;
+						const book::Order* last = nullptr;
+						for(const book::Order* order = level.head; order; order = order->next)
+						{
+							REQUIRE(order->prev == last);
+							REQUIRE(order->price == price);
+							REQUIRE(book.find(order->orderId) == order);
+							volume += order->volume;
+							orders++;
+							last = order;
+						}
+						REQUIRE(level.tail == last);
+						REQUIRE(level.volume == volume);
+						REQUIRE(level.orders == orders);
+					});
+			REQUIRE(levels == book.levels(side));
+		}
+	}
+}
+
+TEST_CASE("IdTable", "")
+{
+	book::IdTable<int64_t> table(4);
+	std::unordered_map<int64_t, int64_t> reference;
+	std::mt19937_64 rng(3);
+
+	// Clustered keys and keys sharing a home slot stress the backward shift
+	for(int i = 0; i < 200000; i++)
+	{
+		int64_t key = (rng() % 3 == 0) ? (int64_t)(rng() % 64) << 40 : (int64_t)(rng() % 5000);
+		if(rng() % 3 == 0)
+		{
+			REQUIRE(table.erase(key) == (reference.erase(key) == 1));
+		}
+		else
+		{
+			bool inserted = reference.emplace(key, i).second;
+			REQUIRE(table.insert(key, i) == inserted);
+		}
+		if(i % 20000 == 0)
+		{
+			REQUIRE(table.size() == reference.size());
+			for(const auto& kv : reference)
+			{
+				REQUIRE(table.find(kv.first));
+				REQUIRE(*table.find(kv.first) == kv.second);
+			}
+		}
+	}
+	REQUIRE(table.size() == reference.size());
+	REQUIRE(table.buckets() >= table.size() * 2);
+	REQUIRE(!table.find(-1));
+}
+
+TEST_CASE("SlabPool", "")
+{
+	book::SlabPool<book::Order> pool(10, 8);
+	REQUIRE(pool.slabs() == 2);
+	std::vector<book::Order*> orders;
+	for(int i = 0; i < 16; i++)
+		orders.push_back(pool.acquire());
+	REQUIRE(pool.slabs() == 2);
+	REQUIRE(pool.used() == 16);
+	book::Order* released = orders[5];
+	pool.release(released);
+	REQUIRE(pool.acquire() == released);
+	pool.acquire();
+	REQUIRE(pool.slabs() == 3);
+
+	pool.clear();
+	REQUIRE(pool.used() == 0);
+	for(int i = 0; i < 24; i++)
+		pool.acquire();
+	REQUIRE(pool.slabs() == 3);
+}
+
+TEST_CASE("LevelBitmap", "")
+{
+	book::LevelBitmap bitmap;
+	bitmap.resize(300000);
+	std::set<int64_t> reference;
+	std::mt19937_64 rng(5);
+
+	REQUIRE(bitmap.above(0) == -1);
+	REQUIRE(bitmap.below(299999) == -1);
+
+	// A few dense clusters and isolated far bits, so that searches cross
+	// word and summary boundaries in both directions
+	for(int i = 0; i < 100000; i++)
+	{
+		int64_t index = (rng() % 4 == 0) ? (int64_t)(rng() % 300000) : 150000 + (int64_t)(rng() % 200) - 100;
+		if(rng() % 2 == 0)
+		{
+			bitmap.set(index);
+			reference.insert(index);
+		}
+		else
+		{
+			bitmap.reset(index);
+			reference.erase(index);
+		}
+
+		int64_t probe = (int64_t)(rng() % 300000);
+		auto above = reference.upper_bound(probe);
+		REQUIRE(bitmap.above(probe) == (above == reference.end() ? -1 : *above));
+		auto below = reference.lower_bound(probe);
+		REQUIRE(bitmap.below(probe) == (below == reference.begin() ? -1 : *std::prev(below)));
+	}
+}
+
+TEST_CASE("L3Book", "")
+{
+	SECTION("Queues and best prices")
+	{
+		L3Book book(1);
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 1, 100, 5));
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 2, 100, 3));
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 3, 100, 7));
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 4, 98, 1));
+		book.orderLogFrame(entry(OrderLogEntry::Add | SellQuote, 5, 102, 4));
+		book.orderLogFrame(entry(OrderLogEntry::Add | SellQuote, 6, 105, 4));
+		// Not quotes, never rest
+		book.orderLogFrame(entry(OrderLogEntry::Add | OrderLogEntry::Buy | OrderLogEntry::Counter, 7, 102, 4));
+		book.orderLogFrame(entry(OrderLogEntry::Add | OrderLogEntry::Buy | OrderLogEntry::FillOrKill, 10, 102, 4));
+		book.orderLogFrame(entry(OrderLogEntry::Fill | OrderLogEntry::Buy | OrderLogEntry::FillOrKill, 10, 102, 4));
+
+		REQUIRE(book.orders() == 6);
+		REQUIRE(book.best(book::Bid) == 100);
+		REQUIRE(book.best(book::Ask) == 102);
+		REQUIRE(book.level(book::Bid, 100)->volume == 15);
+		REQUIRE(book.level(book::Bid, 99) == nullptr);
+		REQUIRE(book.queueAhead(1) == 0);
+		REQUIRE(book.queueAhead(3) == 8);
+		REQUIRE(book.queueAhead(7) == -1);
+
+		// Partial fill of the head, cancel from the middle
+		book.orderLogFrame(entry(OrderLogEntry::Fill | BuyQuote, 1, 100, 2));
+		REQUIRE(book.queueAhead(3) == 6);
+		book.orderLogFrame(entry(OrderLogEntry::Cancelled | BuyQuote, 2, 100, 3));
+		REQUIRE(book.queueAhead(3) == 3);
+		requireConsistent(book);
+
+		// Emptying the best level moves the best price
+		book.orderLogFrame(entry(OrderLogEntry::Fill | BuyQuote, 1, 100, 3));
+		book.orderLogFrame(entry(OrderLogEntry::Moved | BuyQuote, 3, 100, 7));
+		REQUIRE(book.best(book::Bid) == 98);
+		book.orderLogFrame(entry(OrderLogEntry::Moved | OrderLogEntry::Add | BuyQuote, 8, 101, 7));
+		REQUIRE(book.best(book::Bid) == 101);
+		REQUIRE(book.levels(book::Bid) == 2);
+
+		// Far away prices grow the ladder
+		book.orderLogFrame(entry(OrderLogEntry::Add | SellQuote, 9, 100000, 1));
+		REQUIRE(book.best(book::Ask) == 102);
+		book.orderLogFrame(entry(OrderLogEntry::CancelledGroup | SellQuote, 5, 102, 4));
+		book.orderLogFrame(entry(OrderLogEntry::Cancelled | SellQuote, 6, 105, 4));
+		REQUIRE(book.best(book::Ask) == 100000);
+		requireConsistent(book);
+
+		book.orderLogFrame(entry(OrderLogEntry::Cancelled | SellQuote, 42, 105, 4));
+		REQUIRE(book.unknownOrders() == 1);
+
+		// A new session starts from an empty book
+		book.orderLogFrame(entry(OrderLogEntry::SessIdChanged | OrderLogEntry::Add | SellQuote, 11, 110, 1));
+		REQUIRE(book.orders() == 1);
+		REQUIRE(book.best(book::Ask) == 110);
+		REQUIRE(book.empty(book::Bid));
+
+		book.clear();
+		REQUIRE(book.orders() == 0);
+		REQUIRE(book.empty(book::Bid));
+		REQUIRE(book.empty(book::Ask));
+		REQUIRE(book.pool().used() == 0);
+	}
+
+	SECTION("Sparse levels")
+	{
+		// Levels thousands of ticks apart; the best price after each cancel
+		// is checked against a map of the resting volume per price
+		L3Book book(1);
+		std::map<int64_t, int64_t> bids;
+		std::map<int64_t, int64_t> asks;
+		std::map<long long, std::pair<int64_t, int>> resting;
+		std::mt19937_64 rng(7);
+		long long nextId = 1;
+		for(int i = 0; i < 20000; i++)
+		{
+			if(resting.empty() || rng() % 5 < 3)
+			{
+				bool buy = rng() % 2 == 0;
+				int64_t price = buy ? 500000 - (int64_t)(rng() % 64) * 4000 : 500001 + (int64_t)(rng() % 64) * 4000;
+				int volume = 1 + (int)(rng() % 10);
+				book.orderLogFrame(entry(OrderLogEntry::Add | (buy ? BuyQuote : SellQuote), nextId, price, volume));
+				resting[nextId++] = { price, buy ? volume : -volume };
+				(buy ? bids : asks)[price] += volume;
+			}
+			else
+			{
+				auto order = resting.begin();
+				std::advance(order, rng() % resting.size());
+				bool buy = order->second.second > 0;
+				int64_t price = order->second.first;
+				int volume = buy ? order->second.second : -order->second.second;
+				book.orderLogFrame(entry(OrderLogEntry::Cancelled | (buy ? BuyQuote : SellQuote), order->first, price, volume));
+				auto& levels = buy ? bids : asks;
+				if((levels[price] -= volume) == 0)
+					levels.erase(price);
+				resting.erase(order);
+			}
+
+			REQUIRE(book.levels(book::Bid) == bids.size());
+			REQUIRE(book.levels(book::Ask) == asks.size());
+			if(!bids.empty())
+				REQUIRE(book.best(book::Bid) == bids.rbegin()->first);
+			if(!asks.empty())
+				REQUIRE(book.best(book::Ask) == asks.begin()->first);
+		}
+		requireConsistent(book);
+
+		std::vector<int64_t> prices;
+		book.forEachLevel(book::Ask, 3, [&](int64_t price, const book::Level&) { prices.push_back(price); });
+		std::vector<int64_t> expected;
+		for(auto it = asks.begin(); it != asks.end() && expected.size() < 3; ++it)
+			expected.push_back(it->first);
+		REQUIRE(prices == expected);
+	}
+
+	SECTION("Stray prices")
+	{
+		// Prices too far from the others for the ladder go to its overflow
+		L3Book book(1);
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 1, 1000000, 5));
+		book.orderLogFrame(entry(OrderLogEntry::Add | SellQuote, 2, 1000010, 5));
+		book.orderLogFrame(entry(OrderLogEntry::Add | SellQuote, 3, 5000000000ll, 1));
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 4, 3, 2));
+		book.orderLogFrame(entry(OrderLogEntry::Add | SellQuote, 5, 6000000000ll, 1));
+		REQUIRE(book.levels(book::Ask) == 3);
+		REQUIRE(book.best(book::Ask) == 1000010);
+		requireConsistent(book);
+
+		book.orderLogFrame(entry(OrderLogEntry::Cancelled | SellQuote, 2, 1000010, 5));
+		REQUIRE(book.best(book::Ask) == 5000000000ll);
+		book.orderLogFrame(entry(OrderLogEntry::Fill | SellQuote, 3, 5000000000ll, 1));
+		REQUIRE(book.best(book::Ask) == 6000000000ll);
+		book.orderLogFrame(entry(OrderLogEntry::Cancelled | BuyQuote, 1, 1000000, 5));
+		REQUIRE(book.best(book::Bid) == 3);
+		requireConsistent(book);
+
+		// An empty ladder moves to the next price and takes in the overflow
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 6, 5, 1));
+		book.orderLogFrame(entry(OrderLogEntry::Fill | BuyQuote, 4, 3, 1));
+		REQUIRE(book.best(book::Bid) == 5);
+		REQUIRE(book.level(book::Bid, 3)->volume == 1);
+		book.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 7, 1000000, 1));
+		REQUIRE(book.best(book::Bid) == 1000000);
+		REQUIRE(book.levels(book::Bid) == 3);
+		requireConsistent(book);
+		REQUIRE(book.unknownOrders() == 0);
+
+		book.orderLogFrame(entry(OrderLogEntry::SessIdChanged | OrderLogEntry::Add | BuyQuote, 8, 2000000, 1));
+		REQUIRE(book.orders() == 1);
+		REQUIRE(book.levels(book::Bid) == 1);
+		REQUIRE(book.empty(book::Ask));
+		REQUIRE(book.pool().used() == 1);
+		requireConsistent(book);
+	}
+
+	SECTION("Sample file")
+	{
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+
+		// Checks the book against a map-based reconstruction at the end of
+		// every transaction
+		struct Checker
+		{
+			void orderLogFrame(const OrderLogEntry& entry)
+			{
+				book->orderLogFrame(entry);
+				frames++;
+				if(entry.flags & OrderLogEntry::SessIdChanged)
+					orders.clear();
+				if(!(entry.flags & OrderLogEntry::Counter) && (entry.flags & OrderLogEntry::Quote))
+				{
+					if(entry.flags & OrderLogEntry::Add)
+						orders[entry.orderId] = entry.volume;
+					else if(orders.count(entry.orderId))
+					{
+						if((entry.flags & OrderLogEntry::Fill) && orders[entry.orderId] > entry.volume)
+							orders[entry.orderId] -= entry.volume;
+						else if(entry.flags & (OrderLogEntry::Fill | OrderLogEntry::Cancelled |
+									OrderLogEntry::CancelledGroup | OrderLogEntry::Moved))
+							orders.erase(entry.orderId);
+					}
+				}
+				if((entry.flags & OrderLogEntry::EndOfTransaction) && frames % 97 == 0)
+				{
+					REQUIRE(book->orders() == orders.size());
+					if(!book->empty(book::Bid) && !book->empty(book::Ask))
+						crossed += book->best(book::Bid) >= book->best(book::Ask);
+				}
+			}
+
+			L3Book* book;
+			std::unordered_map<long long, int64_t> orders;
+			uint64_t frames = 0;
+			uint64_t crossed = 0;
+		} checker;
+
+		L3Book book(1);
+		checker.book = &book;
+		QshFile<Checker> file(stream, checker);
+		size_t slabs = book.pool().slabs();
+		file.readAllFrames();
+
+		REQUIRE(book.orders() == checker.orders.size());
+		REQUIRE(book.orders() > 0);
+		REQUIRE(checker.crossed == 0);
+		REQUIRE(book.unknownOrders() == 0);
+		REQUIRE(book.pool().slabs() == slabs);
+		requireConsistent(book);
+	}
+}
@@ -0,0 +1,141 @@
+#include "catch/catch.hpp"
+#include "qsh/checkpoint.h"
+#include "qsh/verify.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace qsh;
+
+namespace
+{
+	const char* SampleFile = "data/OrdLog.VTBR-6.16.2016-04-26.qsh";
+
+	struct Replay
+	{
+		Replay() : book(1)
+		{
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			book.orderLogFrame(entry);
+			hashes.push_back(verify::hashEntry(0, entry));
+		}
+
+		L3Book book;
+		std::vector<uint64_t> hashes;
+	};
+
+	std::string serialize(const L3Book& book)
+	{
+		std::ostringstream stream;
+		checkpoint::writeBook(stream, book);
+		return stream.str();
+	}
+
+	std::string temporaryPath()
+	{
+		char path[] = "/tmp/libqsh-checkpoint-XXXXXX";
+		int fd = mkstemp(path);
+		REQUIRE(fd >= 0);
+		close(fd);
+		return path;
+	}
+}
+
+TEST_CASE("Book checkpoints", "[checkpoint]")
+{
+	auto sidecar = temporaryPath();
+	size_t count = buildCheckpoints(SampleFile, sidecar, 30 * 60 * 1000);
+	REQUIRE(count > 5);
+
+	Replay reference;
+	{
+		std::ifstream stream(SampleFile, std::ios_base::binary | std::ios_base::in);
+		QshFile<Replay> file(stream, reference);
+		file.readAllFrames();
+	}
+	std::string finalBook = serialize(reference.book);
+
+	SECTION("Resuming from any checkpoint replays the rest of the file")
+	{
+		CheckpointFile checkpoints(sidecar);
+		REQUIRE(checkpoints.entries().size() == count);
+		REQUIRE(checkpoints.streamNumber() == 0);
+		REQUIRE(checkpoints.entries()[0].frame == 0);
+		{
+			std::ifstream size(SampleFile, std::ios_base::binary | std::ios_base::ate);
+			REQUIRE(checkpoints.sourceSize() == (int64_t)size.tellg());
+		}
+
+		for(const auto& entry : checkpoints.entries())
+		{
+			Replay replay;
+			std::ifstream stream(SampleFile, std::ios_base::binary | std::ios_base::in);
+			QshFile<Replay> file(stream, replay);
+			checkpoints.restore(entry, file, replay.book);
+			file.readAllFrames();
+
+			REQUIRE(entry.frame + replay.hashes.size() == reference.hashes.size());
+			REQUIRE(std::equal(replay.hashes.begin(), replay.hashes.end(), reference.hashes.begin() + entry.frame));
+			REQUIRE(serialize(replay.book) == finalBook);
+		}
+	}
+
+	SECTION("Another file is rejected")
+	{
+		auto copy = temporaryPath();
+		{
+			std::ifstream in(SampleFile, std::ios_base::binary | std::ios_base::in);
+			std::ofstream out(copy, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+			out << in.rdbuf();
+			out.put(0);
+		}
+		CheckpointFile checkpoints(sidecar);
+		Replay replay;
+		std::ifstream stream(copy, std::ios_base::binary | std::ios_base::in);
+		QshFile<Replay> file(stream, replay);
+		REQUIRE_THROWS(checkpoints.restore(checkpoints.entries()[1], file, replay.book));
+		REQUIRE(replay.book.orders() == 0);
+		std::remove(copy.c_str());
+	}
+
+	SECTION("Lookup by time")
+	{
+		CheckpointFile checkpoints(sidecar);
+		const auto& entries = checkpoints.entries();
+		REQUIRE(checkpoints.before(entries[0].time - 1) == nullptr);
+		REQUIRE(checkpoints.before(entries[3].time) == &entries[3]);
+		REQUIRE(checkpoints.before(entries[3].time + 1) == &entries[3]);
+		REQUIRE(checkpoints.before(entries.back().time + 3600000) == &entries.back());
+		for(size_t i = 1; i < entries.size(); i++)
+		{
+			REQUIRE(entries[i].frame > entries[i - 1].frame);
+			REQUIRE(entries[i].time / 1800000 > entries[i - 1].time / 1800000);
+		}
+	}
+
+	SECTION("Damaged sidecars are rejected")
+	{
+		std::string data;
+		{
+			std::ifstream stream(sidecar, std::ios_base::binary | std::ios_base::in);
+			data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+		}
+		{
+			std::ofstream stream(sidecar, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+			stream.write(data.data(), data.size() - 3);
+		}
+		REQUIRE_THROWS(CheckpointFile checkpoints(sidecar));
+		{
+			std::ofstream stream(sidecar, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+			stream << "not a checkpoint file";
+		}
+		REQUIRE_THROWS(CheckpointFile checkpoints(sidecar));
+	}
+
+	std::remove(sidecar.c_str());
+}
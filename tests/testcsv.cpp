@@ -0,0 +1,157 @@
+#include "catch/catch.hpp"
+#include "qsh/csv.h"
+#include "qsh/qshfile.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <ctime>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+using namespace qsh;
+
+namespace
+{
+	std::string formatTimestamp(datetime_t timestamp)
+	{
+		auto tp = helpers::convertGrowDatetimeToTimePoint(timestamp);
+		struct tm t;
+		gmtime_r(&tp.first, &t);
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%02d.%02d.%04d %02d:%02d:%02d.%03d", t.tm_mday, t.tm_mon + 1, t.tm_year + 1900,
+				t.tm_hour, t.tm_min, t.tm_sec, tp.second / 1000);
+		return buffer;
+	}
+
+	std::string formatDecimal(const decimal_fixed& value)
+	{
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%.9f", value.toDouble());
+		std::string result = buffer;
+		while(result.back() == '0')
+			result.pop_back();
+		if(result.back() == '.')
+			result.pop_back();
+		return result;
+	}
+
+	// The exporter's line, built the slow way
+	std::string formatEntry(const OrderLogEntry& entry)
+	{
+		char buffer[512];
+		snprintf(buffer, sizeof(buffer), "%s,%s,%d,%u,%lld,%s,%d,%d,%lld,%s,%ld\n", formatTimestamp(entry.frameTimestamp).c_str(),
+				formatTimestamp(entry.timestamp).c_str(), entry.streamNumber, entry.flags, entry.orderId,
+				formatDecimal(entry.orderPrice).c_str(), entry.volume, entry.remain, entry.matchingOrderId,
+				formatDecimal(entry.tradePrice).c_str(), entry.openInterest);
+		return buffer;
+	}
+
+	class Collector
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			entries.push_back(entry);
+		}
+
+		std::vector<OrderLogEntry> entries;
+	};
+}
+
+TEST_CASE("CSV writers", "[csv]")
+{
+	std::mt19937_64 rng(5);
+	char buffer[64];
+
+	SECTION("Integers")
+	{
+		std::vector<int64_t> values = { 0, 1, 9, 10, 99, 100, 999, 1000, 9999, 10000, 123456789, INT64_MAX, INT64_MIN, -1, -10 };
+		for(int i = 0; i < 10000; i++)
+			values.push_back((int64_t)(rng() >> (rng() % 64)) * ((i % 2) ? -1 : 1));
+		for(auto value : values)
+		{
+			char expected[32];
+			snprintf(expected, sizeof(expected), "%" PRId64, value);
+			char* end = csv::writeSigned(buffer, value);
+			REQUIRE(std::string(buffer, end) == expected);
+			if(value >= 0)
+				REQUIRE(csv::writeUnsigned(buffer, value) - buffer == (ptrdiff_t)strlen(expected));
+		}
+		REQUIRE(std::string(buffer, csv::writeUnsigned(buffer, UINT64_MAX)) == "18446744073709551615");
+	}
+
+	SECTION("Decimals")
+	{
+		REQUIRE(std::string(buffer, csv::writeDecimal(buffer, decimal_fixed(12, 0))) == "12");
+		REQUIRE(std::string(buffer, csv::writeDecimal(buffer, decimal_fixed(12, 500000000))) == "12.5");
+		REQUIRE(std::string(buffer, csv::writeDecimal(buffer, decimal_fixed(0, 1))) == "0.000000001");
+		REQUIRE(std::string(buffer, csv::writeDecimal(buffer, decimal_fixed(-2, 500000000))) == "-1.5");
+		REQUIRE(std::string(buffer, csv::writeDecimal(buffer, decimal_fixed(-3, 0))) == "-3");
+		for(int i = 0; i < 10000; i++)
+		{
+			decimal_fixed value((int64_t)(rng() % 2000000) - 1000000, (int32_t)(rng() % 1000) * 1000000);
+			REQUIRE(std::string(buffer, csv::writeDecimal(buffer, value)) == formatDecimal(value));
+		}
+	}
+
+	SECTION("Timestamps")
+	{
+		csv::TimestampFormatter formatter;
+		// 2016-04-26 in OrderLogEntry milliseconds, then a random walk
+		// across seconds, days and centuries
+		datetime_t timestamp = (TimeDeltaInSeconds + 1461628800ll) * 1000;
+		for(int i = 0; i < 100000; i++)
+		{
+			timestamp += (i % 3 == 0) ? rng() % 2000000000 : rng() % 2000;
+			char* end = formatter.write(buffer, timestamp);
+			REQUIRE(end - buffer == (ptrdiff_t)csv::TimestampFormatter::Size);
+			REQUIRE(std::string(buffer, end) == formatTimestamp(timestamp));
+		}
+	}
+}
+
+TEST_CASE("CsvExporter", "[csv]")
+{
+	Collector collector;
+	{
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		QshFile<Collector> file(stream, collector);
+		file.readAllFrames();
+	}
+
+	SECTION("Matches printf formatting")
+	{
+		std::ostringstream output;
+		{
+			CsvExporter exporter(output, ',', true, 4096);
+			for(const auto& entry : collector.entries)
+				exporter.orderLogFrame(entry);
+		}
+
+		std::istringstream lines(output.str());
+		std::string line;
+		std::getline(lines, line);
+		REQUIRE(line == "frame_time,exchange_time,stream,flags,order_id,order_price,volume,remain,matching_order_id,"
+				"trade_price,open_interest");
+		for(const auto& entry : collector.entries)
+		{
+			std::getline(lines, line);
+			REQUIRE(line + "\n" == formatEntry(entry));
+		}
+		REQUIRE(!std::getline(lines, line));
+	}
+
+	SECTION("TSV without header")
+	{
+		std::ostringstream output;
+		CsvExporter exporter(output, '\t', false);
+		exporter.orderLogFrame(collector.entries[0]);
+		REQUIRE(output.str().empty());
+		exporter.flush();
+		std::string expected = formatEntry(collector.entries[0]);
+		std::replace(expected.begin(), expected.end(), ',', '\t');
+		REQUIRE(output.str() == expected);
+		REQUIRE(exporter.bytes() == expected.size());
+	}
+}
@@ -0,0 +1,124 @@
+#include "catch/catch.hpp"
+#include "qsh/datetime.h"
+
+#include <ctime>
+#include <random>
+#include <vector>
+
+using namespace qsh;
+
+namespace
+{
+	// 2016-04-26 00:00 UTC as milliseconds since 0001-01-01
+	datetime_t sampleDay()
+	{
+		return (TimeDeltaInSeconds + 1461628800ll) * 1000;
+	}
+
+	void requireSame(const Calendar& calendar, time_t seconds)
+	{
+		struct tm t;
+		gmtime_r(&seconds, &t);
+		REQUIRE(calendar.year == t.tm_year + 1900);
+		REQUIRE(calendar.month == t.tm_mon + 1);
+		REQUIRE(calendar.day == t.tm_mday);
+		REQUIRE(calendar.hour == t.tm_hour);
+		REQUIRE(calendar.minute == t.tm_min);
+		REQUIRE(calendar.second == t.tm_sec);
+		REQUIRE(calendar.weekday == t.tm_wday);
+		REQUIRE(calendar.yearDay == t.tm_yday);
+	}
+}
+
+TEST_CASE("Datetime conversion", "[datetime]")
+{
+	std::mt19937_64 rng(8);
+
+	SECTION("Epoch and chrono")
+	{
+		for(int i = 0; i < 10000; i++)
+		{
+			datetime_t grow = sampleDay() + (int64_t)(rng() % 8000000000000ll) - 4000000000000ll;
+			auto tp = helpers::convertGrowDatetimeToTimePoint(grow);
+			int64_t nanos = helpers::growDatetimeToEpochNanos(grow);
+			REQUIRE(nanos == (int64_t)tp.first * 1000000000 + tp.second * 1000ll);
+			REQUIRE(helpers::growDatetimeToSysTime(grow).time_since_epoch().count() == nanos);
+
+			datetime_t ticks = grow * 10000 + rng() % 10000;
+			tp = helpers::convertDatetimeToTimePoint(ticks);
+			nanos = helpers::datetimeToEpochNanos(ticks);
+			REQUIRE(helpers::floorDiv(nanos, 1000) == (int64_t)tp.first * 1000000 + tp.second);
+			REQUIRE(helpers::datetimeToSysTime(ticks).time_since_epoch().count() == nanos);
+		}
+	}
+
+	SECTION("Calendar matches gmtime")
+	{
+		CalendarCache cache;
+		datetime_t timestamp = sampleDay() - 200ll * 365 * 86400000;
+		for(int i = 0; i < 50000; i++)
+		{
+			timestamp += (i % 5 == 0) ? rng() % 4000000000ll : rng() % 3000;
+			const Calendar& calendar = cache.fromGrowDatetime(timestamp);
+			requireSame(calendar, helpers::convertGrowDatetimeToTimePoint(timestamp).first);
+			REQUIRE(calendar.nanosecond == (timestamp % 1000) * 1000000);
+		}
+
+		// Backwards and before 1970
+		for(int i = 0; i < 10000; i++)
+		{
+			int64_t nanos = (int64_t)(rng() % 8000000000000000000ull) - 4000000000000000000ll;
+			const Calendar& calendar = cache.fromEpochNanos(nanos);
+			requireSame(calendar, helpers::floorDiv(nanos, 1000000000));
+			REQUIRE(calendar.nanosecond == nanos - helpers::floorDiv(nanos, 1000000000) * 1000000000);
+		}
+	}
+
+	SECTION("Civil days round trip")
+	{
+		for(int64_t day = -800000; day < 800000; day += 37)
+		{
+			int year, month, dayOfMonth;
+			helpers::civilFromDays(day, year, month, dayOfMonth);
+			REQUIRE(helpers::daysFromCivil(year, month, dayOfMonth) == day);
+		}
+	}
+
+	SECTION("Batch")
+	{
+		for(size_t count = 0; count < 40; count++)
+		{
+			std::vector<datetime_t> grow(count), ticks(count);
+			for(size_t i = 0; i < count; i++)
+			{
+				grow[i] = sampleDay() + (int64_t)(rng() % 100000000000ll);
+				ticks[i] = grow[i] * 10000 + rng() % 10000;
+			}
+
+			std::vector<int64_t> out(count + 1, -1);
+			helpers::batch::growDatetimeToEpochNanos(grow.data(), out.data(), count);
+			for(size_t i = 0; i < count; i++)
+				REQUIRE(out[i] == helpers::growDatetimeToEpochNanos(grow[i]));
+			REQUIRE(out[count] == -1);
+
+			helpers::batch::datetimeToEpochNanos(ticks.data(), out.data(), count);
+			for(size_t i = 0; i < count; i++)
+				REQUIRE(out[i] == helpers::datetimeToEpochNanos(ticks[i]));
+
+			std::vector<int64_t> scalar(count);
+			helpers::batch::affineScalar(grow.data(), scalar.data(), count, helpers::GrowNanos, helpers::EpochOffsetNanos);
+#ifdef QSH_SIMD_X86
+			if(simd::hasAvx2())
+			{
+				std::vector<int64_t> vector(count);
+				helpers::batch::affineAvx2(grow.data(), vector.data(), count, helpers::GrowNanos, helpers::EpochOffsetNanos);
+				REQUIRE(vector == scalar);
+			}
+#endif
+
+			// In place
+			helpers::batch::growDatetimeToEpochNanos(grow.data(), grow.data(), count);
+			REQUIRE(grow == scalar);
+		}
+	}
+}
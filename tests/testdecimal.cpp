@@ -0,0 +1,262 @@
+#include "catch/catch.hpp"
+#include "qsh/decimal.h"
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+using namespace qsh;
+
+namespace
+{
+	decimal_fixed nanos(int64_t value)
+	{
+		return decimal_fixed::fromNanos(value);
+	}
+
+	decimal_fixed randomDecimal(std::mt19937_64& rng)
+	{
+		return decimal_fixed((int64_t)(rng() % 2000000) - 1000000, rng() % 1000000000);
+	}
+}
+
+TEST_CASE("decimal_fixed arithmetic", "[decimal]")
+{
+	std::mt19937_64 rng(44);
+
+	SECTION("Exact add, subtract, negate and integer multiply")
+	{
+		REQUIRE(decimal_fixed(1, 500000000) + decimal_fixed(2, 700000000) == decimal_fixed(4, 200000000));
+		REQUIRE(decimal_fixed(1, 500000000) - decimal_fixed(2, 700000000) == decimal_fixed(-2, 800000000));
+		REQUIRE(-decimal_fixed(1, 500000000) == decimal_fixed(-2, 500000000));
+		REQUIRE(-decimal_fixed(-3, 0) == decimal_fixed(3, 0));
+		REQUIRE(decimal_fixed(-2, 500000000) * 3 == decimal_fixed(-5, 500000000));
+		REQUIRE(2 * decimal_fixed(0, 600000000) == decimal_fixed(1, 200000000));
+		for(int i = 0; i < 10000; i++)
+		{
+			decimal_fixed a = randomDecimal(rng);
+			decimal_fixed b = randomDecimal(rng);
+			int64_t factor = (int64_t)(rng() % 2000) - 1000;
+			REQUIRE((a + b).toNanos() == a.toNanos() + b.toNanos());
+			REQUIRE((a - b).toNanos() == a.toNanos() - b.toNanos());
+			REQUIRE((-a).toNanos() == -a.toNanos());
+			REQUIRE((a * factor).toNanos() == a.toNanos() * factor);
+			REQUIRE((a + b - b) == a);
+			REQUIRE((a + b).fractional >= 0);
+			REQUIRE((a - b).fractional < (int64_t)decimal_fixed::Scale);
+			decimal_fixed c = a;
+			c += b;
+			c -= a;
+			REQUIRE(c == b);
+			REQUIRE((a < b) == (a.toNanos() < b.toNanos()));
+			REQUIRE((a != b) == (a.toNanos() != b.toNanos()));
+		}
+	}
+
+	SECTION("Rounding")
+	{
+		struct Case
+		{
+			Rounding rounding;
+			int64_t positive;	// 2.5 and 2.6 billionths
+			int64_t negative;	// -2.5 and -2.6 billionths
+			int64_t above;
+		};
+		std::vector<Case> cases = {
+			{ Rounding::TowardZero, 2, -2, 2 },
+			{ Rounding::Down, 2, -3, 2 },
+			{ Rounding::Up, 3, -2, 3 },
+			{ Rounding::HalfUp, 3, -3, 3 },
+			{ Rounding::HalfEven, 2, -2, 3 },
+		};
+		for(const auto& c : cases)
+		{
+			REQUIRE(nanos(5).mulDiv(1, 2, c.rounding) == nanos(c.positive));
+			REQUIRE(nanos(-5).mulDiv(1, 2, c.rounding) == nanos(c.negative));
+			REQUIRE(nanos(5).mulDiv(-1, -2, c.rounding) == nanos(c.positive));
+			REQUIRE(nanos(13).mulDiv(1, 5, c.rounding) == nanos(c.above));
+		}
+		REQUIRE(nanos(7).mulDiv(1, 2, Rounding::HalfEven) == nanos(4));
+		REQUIRE(nanos(-7).mulDiv(1, 2, Rounding::HalfEven) == nanos(-4));
+		REQUIRE(nanos(6).mulDiv(1, 2, Rounding::Up) == nanos(3));
+	}
+
+	SECTION("Scaled multiply and divide")
+	{
+		REQUIRE(decimal_fixed(1, 500000000).multiply(decimal_fixed(2, 250000000)) == decimal_fixed(3, 375000000));
+		REQUIRE(decimal_fixed(-2, 500000000).multiply(decimal_fixed(4, 0)) == decimal_fixed(-6, 0));
+		REQUIRE(decimal_fixed(0, 1).multiply(decimal_fixed(0, 500000000), Rounding::HalfEven) == decimal_fixed());
+		REQUIRE(decimal_fixed(0, 1).multiply(decimal_fixed(0, 500000000), Rounding::HalfUp) == nanos(1));
+		REQUIRE(decimal_fixed(1, 0).divide(decimal_fixed(3, 0)) == nanos(333333333));
+		REQUIRE(decimal_fixed(1, 0).divide(decimal_fixed(3, 0), Rounding::Up) == nanos(333333334));
+		REQUIRE(decimal_fixed(2, 0).divide(decimal_fixed(3, 0)) == nanos(666666667));
+		REQUIRE(decimal_fixed(-2, 0).divide(decimal_fixed(3, 0), Rounding::TowardZero) == nanos(-666666666));
+		REQUIRE(decimal_fixed(7, 500000000).divide(decimal_fixed(0, 250000000)) == decimal_fixed(30, 0));
+
+		// Mid price and VWAP without doubles
+		decimal_fixed bid(100, 250000000), ask(100, 500000000);
+		REQUIRE((bid + ask).mulDiv(1, 2, Rounding::HalfEven) == decimal_fixed(100, 375000000));
+		decimal_fixed notional = decimal_fixed(10, 100000000) * 3 + decimal_fixed(10, 200000000) * 4;
+		REQUIRE(notional.mulDiv(1, 7, Rounding::HalfEven) == nanos(10157142857));
+
+		for(int i = 0; i < 10000; i++)
+		{
+			decimal_fixed a = randomDecimal(rng);
+			decimal_fixed b = randomDecimal(rng);
+			REQUIRE(a.multiply(b, Rounding::Down) <= a.multiply(b, Rounding::Up));
+			REQUIRE(a.multiply(b, Rounding::Up) - a.multiply(b, Rounding::Down) <= nanos(1));
+			if(b != decimal_fixed())
+			{
+				decimal_fixed q = a.divide(b, Rounding::Down);
+				REQUIRE(q <= a.divide(b, Rounding::Up));
+				REQUIRE(a.divide(b, Rounding::Up) - q <= nanos(1));
+			}
+			REQUIRE(a.mulDiv(3, 3) == a);
+		}
+
+		REQUIRE_THROWS(decimal_fixed(1, 0).divide(decimal_fixed()));
+		REQUIRE_THROWS(decimal_fixed(1, 0).mulDiv(1, 0));
+	}
+}
+
+TEST_CASE("fixed_point", "[decimal]")
+{
+	std::mt19937_64 rng(46);
+	REQUIRE(sizeof(fixed_nanos) == 8);
+
+	SECTION("Lossless conversion")
+	{
+		for(int i = 0; i < 10000; i++)
+		{
+			decimal_fixed value = randomDecimal(rng);
+			fixed_nanos compact(value);
+			REQUIRE(compact.raw == value.toNanos());
+			REQUIRE(compact.toDecimal() == value);
+			decimal_fixed cents((int64_t)(rng() % 2000000) - 1000000, (rng() % 100) * 10000000);
+			REQUIRE(fixed_point<2>(cents).toDecimal() == cents);
+			REQUIRE(fixed_point<0>(decimal_fixed(cents.value, 0)).raw == cents.value);
+		}
+		REQUIRE(fixed_point<2>(decimal_fixed(-2, 990000000)).raw == -101);
+		REQUIRE(fixed_point<2>::fromRaw(-101).toDecimal() == decimal_fixed(-2, 990000000));
+		REQUIRE(fixed_point<2>::fromRaw(-101).toDouble() == -1.01);
+		REQUIRE(fixed_nanos(decimal_fixed(9223372035, 0)).raw == 9223372035000000000ll);
+		REQUIRE_THROWS(fixed_nanos(decimal_fixed(9223372037, 0)));
+		REQUIRE_THROWS(fixed_nanos(decimal_fixed(-9223372038, 0)));
+		REQUIRE_THROWS(fixed_point<2>(decimal_fixed(1, 5000000)));
+	}
+
+	SECTION("Rounding")
+	{
+		decimal_fixed value(1, 5000000);	// 1.005
+		REQUIRE(fixed_point<2>::round(value, Rounding::HalfEven).raw == 100);
+		REQUIRE(fixed_point<2>::round(value, Rounding::HalfUp).raw == 101);
+		REQUIRE(fixed_point<2>::round(-value, Rounding::HalfUp).raw == -101);
+		REQUIRE(fixed_point<2>::round(-value, Rounding::Down).raw == -101);
+		REQUIRE(fixed_point<2>::round(-value, Rounding::Up).raw == -100);
+		REQUIRE(fixed_point<2>::round(-value, Rounding::TowardZero).raw == -100);
+		REQUIRE(fixed_point<2>::fromRaw(5).mulDiv(1, 2, Rounding::HalfEven).raw == 2);
+		REQUIRE(fixed_point<2>::fromRaw(-5).mulDiv(1, 2, Rounding::HalfUp).raw == -3);
+		REQUIRE_THROWS(fixed_point<2>::fromRaw(5).mulDiv(1, 0));
+
+		// Out of range results throw like the constructor instead of wrapping
+		REQUIRE(fixed_nanos::round(decimal_fixed(9223372035, 0)).raw == 9223372035000000000ll);
+		REQUIRE_THROWS(fixed_nanos::round(decimal_fixed(9223372037, 0)));
+		REQUIRE_THROWS(fixed_nanos::round(decimal_fixed(-9223372038, 0)));
+		REQUIRE_THROWS(fixed_point<2>::fromRaw(INT64_MAX / 2).mulDiv(3, 1));
+	}
+
+	SECTION("Arithmetic, ordering and hashing agree with decimal_fixed")
+	{
+		std::vector<decimal_fixed> values;
+		std::vector<fixed_nanos> compact;
+		std::unordered_set<fixed_nanos> set;
+		for(int i = 0; i < 10000; i++)
+		{
+			values.push_back(randomDecimal(rng));
+			if(i % 4 == 0)
+				values.back() = values[rng() % values.size()];
+			compact.push_back(fixed_nanos(values.back()));
+			set.insert(compact.back());
+		}
+		for(size_t i = 1; i < values.size(); i++)
+		{
+			const decimal_fixed& a = values[i - 1];
+			const decimal_fixed& b = values[i];
+			fixed_nanos x = compact[i - 1], y = compact[i];
+			REQUIRE((x < y) == (a < b));
+			REQUIRE((x <= y) == (a <= b));
+			REQUIRE((x == y) == (a == b));
+			REQUIRE((x + y).toDecimal() == a + b);
+			REQUIRE((x - y).toDecimal() == a - b);
+			REQUIRE((-x).toDecimal() == -a);
+			REQUIRE((x * 3).toDecimal() == a * 3);
+			REQUIRE(x.mulDiv(1, 7, Rounding::Down).toDecimal() == a.mulDiv(1, 7, Rounding::Down));
+		}
+
+		std::sort(values.begin(), values.end());
+		std::sort(compact.begin(), compact.end());
+		for(size_t i = 0; i < values.size(); i++)
+			REQUIRE(compact[i].toDecimal() == values[i]);
+		values.erase(std::unique(values.begin(), values.end()), values.end());
+		REQUIRE(set.size() == values.size());
+	}
+}
+
+TEST_CASE("Decimal column kernels", "[decimal]")
+{
+	std::mt19937_64 rng(45);
+	for(size_t count = 0; count < 70; count++)
+	{
+		std::vector<int64_t> a(count), b(count);
+		std::vector<decimal_fixed> prices(count);
+		for(size_t i = 0; i < count; i++)
+		{
+			a[i] = (int64_t)(rng() % 200) - 100;
+			b[i] = (i % 3 == 0) ? a[i] : (int64_t)rng();
+			prices[i] = randomDecimal(rng);
+			// Garbage in the padding must not leak into the results
+			memset((char*)&prices[i] + 12, 0xa5, 4);
+		}
+
+		std::vector<int8_t> expected(count + 1, 7), actual(count + 1, 7);
+		for(size_t i = 0; i < count; i++)
+			expected[i] = a[i] < b[i] ? -1 : (a[i] > b[i] ? 1 : 0);
+		decimal::compare(a.data(), b.data(), actual.data(), count);
+		REQUIRE(actual == expected);
+
+		REQUIRE(decimal::sum(a.data(), count) == decimal::sumScalar(a.data(), count));
+		decimal_fixed total;
+		for(const auto& price : prices)
+			total += price;
+		REQUIRE(decimal::sum(prices.data(), count) == total);
+		REQUIRE(decimal::sumScalar(prices.data(), count) == total);
+
+		std::vector<int64_t> priceNanos(count);
+		decimal::toNanos(prices.data(), priceNanos.data(), count);
+		for(size_t i = 0; i < count; i++)
+			REQUIRE(priceNanos[i] == prices[i].toNanos());
+
+		if(count > 0)
+		{
+			REQUIRE(decimal::min(b.data(), count) == *std::min_element(b.begin(), b.end()));
+			REQUIRE(decimal::max(b.data(), count) == *std::max_element(b.begin(), b.end()));
+		}
+
+#ifdef QSH_SIMD_X86
+		if(simd::hasAvx2())
+		{
+			std::vector<int8_t> scalar(count + 1, 7);
+			decimal::compareScalar(a.data(), b.data(), scalar.data(), count);
+			REQUIRE(scalar == expected);
+			REQUIRE(decimal::sumAvx2(b.data(), count) == decimal::sumScalar(b.data(), count));
+			REQUIRE(decimal::sumAvx2(prices.data(), count) == total);
+			if(count > 0)
+			{
+				REQUIRE(decimal::extremeAvx2<false>(a.data(), count) == decimal::minScalar(a.data(), count));
+				REQUIRE(decimal::extremeAvx2<true>(a.data(), count) == decimal::maxScalar(a.data(), count));
+			}
+		}
+#endif
+	}
+}
@@ -0,0 +1,144 @@
+
+#include "catch/catch.hpp"
+#include "qsh/follow.h"
+#include "qsh/synthetic.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace qsh;
+
+namespace
+{
+	class CollectingSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			entries.push_back(entry);
+		}
+
+		std::vector<OrderLogEntry> entries;
+	};
+
+	std::string temporaryPath()
+	{
+		char path[] = "/tmp/libqsh-follow-XXXXXX";
+		int fd = mkstemp(path);
+		REQUIRE(fd >= 0);
+		close(fd);
+		return path;
+	}
+
+	void append(const std::string& path, const std::string& data)
+	{
+		std::ofstream out(path, std::ios_base::binary | std::ios_base::app);
+		out.write(data.data(), data.size());
+	}
+
+	bool sameEntries(const std::vector<OrderLogEntry>& a, const std::vector<OrderLogEntry>& b)
+	{
+		if(a.size() != b.size())
+			return false;
+		for(size_t i = 0; i < a.size(); i++)
+		{
+			if(a[i].frameTimestamp != b[i].frameTimestamp || a[i].timestamp != b[i].timestamp ||
+					a[i].orderId != b[i].orderId || !(a[i].orderPrice == b[i].orderPrice) ||
+					a[i].volume != b[i].volume || a[i].remain != b[i].remain || a[i].flags != b[i].flags ||
+					a[i].streamNumber != b[i].streamNumber)
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE("QshFollower", "")
+{
+	std::ostringstream out;
+	testing::SyntheticOrdLog generator(11, 2);
+	generator.write(out, 5000);
+	const std::string data = out.str();
+
+	CollectingSink reference;
+	{
+		std::istringstream stream(data);
+		QshFile<CollectingSink> file(stream, reference);
+		file.readAllFrames();
+	}
+
+	// Header of a two-stream synthetic file: magic, version, two strings,
+	// start time, stream count and two stream headers
+	std::istringstream headerStream(data);
+	CollectingSink unused;
+	QshFile<CollectingSink> headerFile(headerStream, unused);
+	const size_t headerSize = headerStream.tellg();
+
+	auto path = temporaryPath();
+	append(path, data.substr(0, headerSize));
+
+	SECTION("Truncated frames are rewound")
+	{
+		CollectingSink sink;
+		QshFollower<CollectingSink> follower(path, sink);
+		REQUIRE(follower.poll() == 0);
+
+		// Chunk sizes that are not multiples of any frame size
+		size_t offset = headerSize;
+		size_t chunk = 1;
+		size_t frames = 0;
+		while(offset < data.size())
+		{
+			size_t size = std::min(chunk, data.size() - offset);
+			append(path, data.substr(offset, size));
+			offset += size;
+			chunk = chunk * 3 % 97 + 1;
+			frames += follower.poll();
+			REQUIRE(frames == sink.entries.size());
+		}
+		REQUIRE(sameEntries(sink.entries, reference.entries));
+	}
+
+	SECTION("Follow with a concurrent writer")
+	{
+		CollectingSink sink;
+		QshFollower<CollectingSink> follower(path, sink, std::chrono::milliseconds(20));
+
+		std::thread writer([&]()
+				{
+					size_t offset = headerSize;
+					while(offset < data.size())
+					{
+						size_t size = std::min<size_t>(4000, data.size() - offset);
+						append(path, data.substr(offset, size));
+						offset += size;
+						std::this_thread::sleep_for(std::chrono::milliseconds(2));
+					}
+				});
+
+		size_t frames = follower.follow(std::chrono::milliseconds(500));
+		writer.join();
+		frames += follower.poll();
+
+		REQUIRE(frames == reference.entries.size());
+		REQUIRE(sameEntries(sink.entries, reference.entries));
+	}
+
+	SECTION("Stop from another thread")
+	{
+		CollectingSink sink;
+		QshFollower<CollectingSink> follower(path, sink, std::chrono::milliseconds(10));
+		std::thread stopper([&]()
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+					follower.stop();
+				});
+		REQUIRE(follower.follow() == 0);
+		stopper.join();
+	}
+
+	std::remove(path.c_str());
+}
@@ -0,0 +1,122 @@
+#include "catch/catch.hpp"
+#include "qsh/latency.h"
+#include "qsh/qshfile.h"
+
+#include <fstream>
+
+using namespace qsh;
+
+namespace
+{
+	OrderLogEntry entry(int stream, datetime_t exchangeTime, datetime_t frameTime)
+	{
+		OrderLogEntry result = {};
+		result.streamNumber = stream;
+		result.timestamp = exchangeTime;
+		result.frameTimestamp = frameTime;
+		return result;
+	}
+}
+
+TEST_CASE("LogHistogram", "")
+{
+	typedef LogHistogram<4> Histogram;
+
+	SECTION("Buckets are contiguous")
+	{
+		REQUIRE(Histogram::lowerBound(0) == 0);
+		for(int i = 1; i < Histogram::Buckets; i++)
+		{
+			REQUIRE(Histogram::lowerBound(i) == Histogram::upperBound(i - 1) + 1);
+			REQUIRE(Histogram::index(Histogram::lowerBound(i)) == i);
+			REQUIRE(Histogram::index(Histogram::upperBound(i - 1)) == i - 1);
+		}
+		REQUIRE(Histogram::index(std::numeric_limits<int64_t>::max()) == Histogram::Buckets - 1);
+	}
+
+	SECTION("Relative error")
+	{
+		for(uint64_t value = 1; value < (1ull << 40); value = value * 3 + 1)
+		{
+			int i = Histogram::index(value);
+			REQUIRE(Histogram::lowerBound(i) <= value);
+			REQUIRE(Histogram::upperBound(i) >= value);
+			REQUIRE(Histogram::upperBound(i) - Histogram::lowerBound(i) <= value / Histogram::SubBuckets);
+		}
+	}
+
+	SECTION("Quantiles")
+	{
+		Histogram h;
+		REQUIRE(h.quantile(0.5) == 0);
+		for(int i = 1; i <= 100; i++)
+			h.record(i);
+		h.record(-5);
+		REQUIRE(h.count() == 101);
+		REQUIRE(h.negative() == 1);
+		REQUIRE(h.min() == -5);
+		REQUIRE(h.max() == 100);
+		REQUIRE(h.quantile(0) == -5);
+		REQUIRE(h.quantile(1) == 100);
+		// Exact below 16, within one bucket above
+		REQUIRE(h.quantile(0.1) == 9);
+		REQUIRE(h.quantile(0.5) >= 50);
+		REQUIRE(h.quantile(0.5) <= 51);
+		REQUIRE(h.quantile(0.99) >= 99);
+
+		h.reset();
+		REQUIRE(h.count() == 0);
+		REQUIRE(h.max() == 0);
+	}
+}
+
+TEST_CASE("LatencySink", "")
+{
+	SECTION("Windows and streams")
+	{
+		LatencySink sink(1000, 4);
+		sink.orderLogFrame(entry(0, 100, 110));
+		sink.orderLogFrame(entry(0, 1100, 1120));
+		sink.orderLogFrame(entry(1, 1100, 1090));
+		// Reuses the ring slot of the first window
+		sink.orderLogFrame(entry(0, 4100, 4130));
+
+		REQUIRE(sink.streams() == 2);
+		REQUIRE(sink.total(0).count() == 3);
+		REQUIRE(sink.total(0).min() == 10);
+		REQUIRE(sink.total(0).max() == 30);
+		REQUIRE(sink.total(1).negative() == 1);
+
+		auto windows = sink.windows(0);
+		REQUIRE(windows.size() == 2);
+		REQUIRE(windows[0].first == 1000);
+		REQUIRE(windows[0].second->max() == 20);
+		REQUIRE(windows[1].first == 4000);
+		REQUIRE(windows[1].second->count() == 1);
+
+		std::string json = sink.toJson();
+		REQUIRE(json.find("{\"windowMs\":1000,\"streams\":[{\"stream\":0,\"total\":{\"count\":3,") == 0);
+		REQUIRE(json.find("\"negative\":1") != std::string::npos);
+		std::string text = sink.toText();
+		REQUIRE(std::count(text.begin(), text.end(), '\n') == 1 + 3 + 2);
+	}
+
+	SECTION("Sample file")
+	{
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		LatencySink sink;
+		QshFile<LatencySink> file(stream, sink);
+		file.readAllFrames();
+
+		REQUIRE(sink.streams() == 1);
+		const auto& total = sink.total(0);
+		REQUIRE(total.count() == 159036);
+		REQUIRE(total.quantile(0.5) <= total.quantile(0.99));
+		REQUIRE(total.quantile(0.99) <= total.max());
+
+		uint64_t windowed = 0;
+		for(const auto& window : sink.windows(0))
+			windowed += window.second->count();
+		REQUIRE(windowed == total.count());
+	}
+}
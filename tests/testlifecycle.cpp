@@ -0,0 +1,166 @@
+#include "catch/catch.hpp"
+#include "qsh/lifecycle.h"
+#include "qsh/qshfile.h"
+#include "entries.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace qsh;
+using namespace qsh::testing;
+
+namespace
+{
+	const uint16_t Fill = OrderLogEntry::Quote | OrderLogEntry::Fill;
+	const uint16_t Cancel = OrderLogEntry::Quote | OrderLogEntry::Cancelled;
+	const uint16_t Move = OrderLogEntry::Quote | OrderLogEntry::Moved;
+
+	struct Counting
+	{
+		Counting() : adds(0), fillVolume(0), peakLive(0)
+		{
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			tracker.orderLogFrame(entry);
+			uint16_t flags = entry.flags;
+			if((flags & OrderLogEntry::Quote) && !(flags & OrderLogEntry::Counter))
+			{
+				if((flags & OrderLogEntry::Add) && !(flags & OrderLogEntry::Moved))
+					adds++;
+				if(flags & OrderLogEntry::Fill)
+					fillVolume += entry.volume;
+			}
+			peakLive = std::max(peakLive, tracker.liveOrders());
+		}
+
+		LifecycleTracker tracker;
+		size_t adds;
+		int64_t fillVolume;
+		size_t peakLive;
+	};
+}
+
+TEST_CASE("LifecycleTracker", "[lifecycle]")
+{
+	SECTION("Fills, cancels and moves")
+	{
+		LifecycleTracker tracker;
+		auto& rows = tracker.completed();
+		tracker.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 1, 100, 5, 10));
+		tracker.orderLogFrame(entry(OrderLogEntry::Add | SellQuote, 2, 105, 3, 11));
+		tracker.orderLogFrame(entry(Fill | OrderLogEntry::Buy, 1, 100, 2, 20));
+		tracker.orderLogFrame(entry(Fill | OrderLogEntry::Buy, 1, 100, 3, 30));
+		REQUIRE(rows.size() == 1);
+		REQUIRE(rows.orderId[0] == 1);
+		REQUIRE(rows.lastOrderId[0] == 1);
+		REQUIRE(rows.side[0] == book::Bid);
+		REQUIRE(rows.end[0] == LifecycleColumns::Filled);
+		REQUIRE(rows.price[0] == fixed_nanos(decimal_fixed(100, 0)));
+		REQUIRE(rows.addTime[0] == 10);
+		REQUIRE(rows.firstFillTime[0] == 20);
+		REQUIRE(rows.endTime[0] == 30);
+		REQUIRE(rows.lifetime(0) == 20);
+		REQUIRE(rows.volume[0] == 5);
+		REQUIRE(rows.filled[0] == 5);
+		REQUIRE(rows.fills[0] == 2);
+		REQUIRE(rows.moves[0] == 0);
+
+		// Order 2 moves twice, trades once and is cancelled
+		tracker.orderLogFrame(entry(Move | OrderLogEntry::Sell, 2, 105, 3, 40));
+		tracker.orderLogFrame(entry(OrderLogEntry::Moved | OrderLogEntry::Add | SellQuote, 7, 104, 4, 40));
+		tracker.orderLogFrame(entry(Fill | OrderLogEntry::Sell, 7, 104, 1, 45));
+		tracker.orderLogFrame(entry(Move | OrderLogEntry::Sell, 7, 104, 3, 50));
+		tracker.orderLogFrame(entry(OrderLogEntry::Moved | OrderLogEntry::Add | SellQuote, 8, 103, 3, 50));
+		REQUIRE(rows.size() == 1);
+		REQUIRE(tracker.liveOrders() == 1);
+		tracker.orderLogFrame(entry(Cancel | OrderLogEntry::Sell, 8, 103, 3, 60));
+		REQUIRE(rows.size() == 2);
+		REQUIRE(rows.orderId[1] == 2);
+		REQUIRE(rows.lastOrderId[1] == 8);
+		REQUIRE(rows.side[1] == book::Ask);
+		REQUIRE(rows.end[1] == LifecycleColumns::Cancelled);
+		REQUIRE(rows.price[1] == fixed_nanos(decimal_fixed(103, 0)));
+		REQUIRE(rows.addTime[1] == 11);
+		REQUIRE(rows.firstFillTime[1] == 45);
+		REQUIRE(rows.endTime[1] == 60);
+		REQUIRE(rows.volume[1] == 3);
+		REQUIRE(rows.filled[1] == 1);
+		REQUIRE(rows.fills[1] == 1);
+		REQUIRE(rows.moves[1] == 2);
+		REQUIRE(tracker.liveOrders() == 0);
+		REQUIRE(tracker.capacity() == 2);
+
+		// A move that is not followed by its replacement is a cancel
+		tracker.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 9, 99, 1, 70));
+		tracker.orderLogFrame(entry(Move | OrderLogEntry::Buy, 9, 99, 1, 80));
+		tracker.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 10, 98, 1, 90));
+		REQUIRE(rows.size() == 3);
+		REQUIRE(rows.end[2] == LifecycleColumns::Cancelled);
+		REQUIRE(rows.endTime[2] == 80);
+		REQUIRE(rows.moves[2] == 0);
+		REQUIRE(tracker.capacity() == 2);
+	}
+
+	SECTION("Skipped and unknown entries")
+	{
+		LifecycleTracker tracker;
+		tracker.orderLogFrame(entry(OrderLogEntry::Counter | OrderLogEntry::Add, 1, 100, 5, 10));
+		tracker.orderLogFrame(entry(OrderLogEntry::FillOrKill | OrderLogEntry::Add, 2, 100, 5, 10));
+		REQUIRE(tracker.liveOrders() == 0);
+		tracker.orderLogFrame(entry(Fill, 3, 100, 5, 10));
+		tracker.orderLogFrame(entry(Cancel, 4, 100, 5, 10));
+		REQUIRE(tracker.unknown() == 2);
+		REQUIRE(tracker.completed().size() == 0);
+	}
+
+	SECTION("Session change and end of data")
+	{
+		LifecycleTracker tracker;
+		auto& rows = tracker.completed();
+		tracker.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 1, 100, 5, 10));
+		tracker.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 2, 100, 5, 10));
+		tracker.orderLogFrame(entry(OrderLogEntry::SessIdChanged | OrderLogEntry::Add | BuyQuote, 3, 100, 5, 20));
+		REQUIRE(rows.size() == 2);
+		REQUIRE(rows.end[0] == LifecycleColumns::SessionEnd);
+		REQUIRE(rows.endTime[1] == 20);
+		REQUIRE(tracker.liveOrders() == 1);
+		tracker.closeAll(LifecycleColumns::Open, 30);
+		REQUIRE(rows.size() == 3);
+		REQUIRE(rows.orderId[2] == 3);
+		REQUIRE(rows.end[2] == LifecycleColumns::Open);
+		rows.clear();
+		REQUIRE(rows.size() == 0);
+		REQUIRE(rows.moves.empty());
+	}
+
+	SECTION("A day of data")
+	{
+		Counting counting;
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		QshFile<Counting> file(stream, counting);
+		file.readAllFrames();
+		auto& tracker = counting.tracker;
+		REQUIRE(tracker.unknown() == 0);
+		REQUIRE(tracker.capacity() == counting.peakLive);
+		REQUIRE(tracker.capacity() * 10 < counting.adds);
+
+		tracker.closeAll(LifecycleColumns::Open, 0);
+		auto& rows = tracker.completed();
+		REQUIRE(rows.size() == counting.adds);
+		int64_t filled = 0;
+		for(size_t i = 0; i < rows.size(); i++)
+		{
+			filled += rows.filled[i];
+			if(rows.moves[i] == 0)
+				REQUIRE(rows.filled[i] <= rows.volume[i]);
+			if(rows.end[i] == LifecycleColumns::Filled)
+				REQUIRE(rows.fills[i] > 0);
+			if(rows.end[i] != LifecycleColumns::Open)
+				REQUIRE(rows.lifetime(i) >= 0);
+		}
+		REQUIRE(filled == counting.fillVolume);
+		REQUIRE(std::count(rows.end.begin(), rows.end.end(), LifecycleColumns::Open) > 0);
+	}
+}
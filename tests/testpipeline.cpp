@@ -0,0 +1,129 @@
+
+#include "catch/catch.hpp"
+#include "qsh/pipeline.h"
+#include "qsh/synthetic.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace qsh;
+
+namespace
+{
+	class ChecksumSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			count++;
+			checksum = checksum * 31 + entry.frameTimestamp + entry.timestamp + entry.orderId + entry.volume + entry.remain +
+				entry.flags + entry.orderPrice.value + entry.tradePrice.value + entry.openInterest + entry.streamNumber;
+			if(throwAt != 0 && count == throwAt)
+				throw std::runtime_error("Sink failure");
+		}
+
+		size_t count = 0;
+		uint64_t checksum = 0;
+		size_t throwAt = 0;
+	};
+
+	template <typename F>
+	std::string errorMessage(F f)
+	{
+		try
+		{
+			f();
+		}
+		catch(const std::runtime_error& e)
+		{
+			return e.what();
+		}
+		return std::string();
+	}
+}
+
+TEST_CASE("PipelinedReader", "")
+{
+	std::ostringstream out;
+	testing::SyntheticOrdLog generator(5, 2);
+	generator.write(out, 30000);
+	const std::string data = out.str();
+
+	ChecksumSink expected;
+	{
+		std::istringstream stream(data);
+		QshFile<ChecksumSink> file(stream, expected);
+		file.readAllFrames();
+	}
+
+	SECTION("Same entries for every backpressure mode")
+	{
+		for(auto backpressure : { Backpressure::Spin, Backpressure::Yield, Backpressure::Block })
+		{
+			std::istringstream stream(data);
+			ChecksumSink sink;
+			PipelinedReader<ChecksumSink> reader(stream, sink, backpressure, 100, 4);
+			REQUIRE(reader.file().streams().size() == 2);
+			reader.readAllFrames();
+			REQUIRE(sink.count == expected.count);
+			REQUIRE(sink.checksum == expected.checksum);
+		}
+	}
+
+	SECTION("Sample file")
+	{
+		ChecksumSink direct;
+		{
+			std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+			QshFile<ChecksumSink> file(stream, direct);
+			file.readAllFrames();
+		}
+
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		ChecksumSink sink;
+		PipelinedReader<ChecksumSink> reader(stream, sink, Backpressure::Block);
+		reader.readAllFrames();
+		REQUIRE(sink.count == direct.count);
+		REQUIRE(sink.checksum == direct.checksum);
+	}
+
+	SECTION("Sink exception stops the decoder")
+	{
+		std::istringstream stream(data);
+		ChecksumSink sink;
+		sink.throwAt = 1000;
+		PipelinedReader<ChecksumSink> reader(stream, sink, Backpressure::Block, 64, 2);
+		REQUIRE(errorMessage([&]() { reader.readAllFrames(); }) == "Sink failure");
+		REQUIRE(sink.count == 1000);
+	}
+
+	SECTION("Decoder exception is rethrown")
+	{
+		const std::string truncated = data.substr(0, data.size() - 3);
+		ChecksumSink direct;
+		{
+			std::istringstream stream(truncated);
+			QshFile<ChecksumSink> file(stream, direct);
+			REQUIRE(errorMessage([&]() { file.readAllFrames(); }) == "Truncated frame");
+		}
+
+		// Every entry decoded before the error, including the partial batch
+		std::istringstream stream(truncated);
+		ChecksumSink sink;
+		PipelinedReader<ChecksumSink> reader(stream, sink, Backpressure::Yield, 64, 2);
+		REQUIRE(errorMessage([&]() { reader.readAllFrames(); }) == "Truncated frame");
+		REQUIRE(direct.count % 64 != 0);
+		REQUIRE(sink.count == direct.count);
+		REQUIRE(sink.checksum == direct.checksum);
+	}
+
+	SECTION("Only one pass")
+	{
+		std::istringstream stream(data);
+		ChecksumSink sink;
+		PipelinedReader<ChecksumSink> reader(stream, sink);
+		reader.readAllFrames();
+		REQUIRE_THROWS(reader.readAllFrames());
+		REQUIRE(sink.count == expected.count);
+	}
+}
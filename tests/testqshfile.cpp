@@ -5,6 +5,8 @@
 #include <iostream>
 #include <fstream>
 #include <ctime>
+#include <set>
+#include <sstream>
 
 using namespace std;
 using namespace qsh;
@@ -189,6 +191,157 @@ TEST_CASE("QshFile", "")
 	{
 		file.readAllFrames();
 
+		// Order ids of Add frames only grow, and the fill entries of a trade
+		// refer to orders that were added before
+		long long lastAdd = 0;
+		std::set<long long> added;
+		size_t fills = 0;
+		size_t known = 0;
+		for(const auto& entry : sink.orderLog)
+		{
+			if(entry.flags & OrderLogEntry::Add)
+			{
+				REQUIRE(entry.orderId > lastAdd);
+				lastAdd = entry.orderId;
+				added.insert(entry.orderId);
+			}
+			else if(entry.flags & OrderLogEntry::Fill)
+			{
+				fills++;
+				known += added.count(entry.orderId);
+			}
+		}
+		REQUIRE(fills > 0);
+		REQUIRE(known > fills * 9 / 10);
+	}
+}
+
+
+TEST_CASE("QshFile saved state", "")
+{
+	using OrderLogEntry = QshFile<Sink>::OrderLogEntry;
+	auto sameEntries = [](const std::vector<OrderLogEntry>& a, const std::vector<OrderLogEntry>& b)
+	{
+		if(a.size() != b.size())
+			return false;
+		for(size_t i = 0; i < a.size(); i++)
+		{
+			if(a[i].frameTimestamp != b[i].frameTimestamp || a[i].timestamp != b[i].timestamp ||
+					a[i].orderId != b[i].orderId || a[i].flags != b[i].flags || a[i].orderPrice != b[i].orderPrice ||
+					a[i].volume != b[i].volume || a[i].remain != b[i].remain || a[i].tradePrice != b[i].tradePrice)
+				return false;
+		}
+		return true;
+	};
+
+	ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", ios_base::binary | ios_base::in);
+	REQUIRE(stream.good());
+	Sink sink;
+	QshFile<Sink> file(stream, sink);
+	for(int i = 0; i < 5000; i++)
+		file.readOneFrame();
+	std::string state = file.saveState();
+	REQUIRE(state.size() < 256);
+	file.readAllFrames();
+	std::vector<OrderLogEntry> rest(sink.orderLog.begin() + 5000, sink.orderLog.end());
+	REQUIRE(rest.size() > 0);
+
+	SECTION("Restoring constructor")
+	{
+		ifstream resumed("data/OrdLog.VTBR-6.16.2016-04-26.qsh", ios_base::binary | ios_base::in);
+		Sink resumedSink;
+		QshFile<Sink> resumedFile(resumed, resumedSink, state);
+		REQUIRE(resumedFile.getMetadata().comment == file.getMetadata().comment);
+		REQUIRE(resumedFile.streams().size() == 1);
+		REQUIRE(resumedFile.streams()[0].ticker == "VTBR-6.16");
+		REQUIRE(resumedFile.streams()[0].step == file.streams()[0].step);
+		resumedFile.readAllFrames();
+		REQUIRE(sameEntries(resumedSink.orderLog, rest));
+		REQUIRE(resumedFile.saveState() == file.saveState());
+	}
+
+	SECTION("Restore into an open file")
+	{
+		ifstream resumed("data/OrdLog.VTBR-6.16.2016-04-26.qsh", ios_base::binary | ios_base::in);
+		Sink resumedSink;
+		QshFile<Sink> resumedFile(resumed, resumedSink);
+		resumedFile.readOneFrame();
+		resumedSink.orderLog.clear();
+		resumedFile.restoreState(state);
+		resumedFile.readAllFrames();
+		REQUIRE(sameEntries(resumedSink.orderLog, rest));
+	}
+
+	SECTION("Invalid states")
+	{
+		ifstream resumed("data/OrdLog.VTBR-6.16.2016-04-26.qsh", ios_base::binary | ios_base::in);
+		Sink resumedSink;
+		QshFile<Sink> resumedFile(resumed, resumedSink);
+		REQUIRE_THROWS(resumedFile.restoreState(""));
+		REQUIRE_THROWS(resumedFile.restoreState("QSHSTATX" + state.substr(8)));
+		REQUIRE_THROWS(resumedFile.restoreState(state.substr(0, state.size() - 1)));
+		REQUIRE_THROWS(resumedFile.restoreState(state + '\0'));
+
+		std::string other = state;
+		size_t ticker = other.find("VTBR");
+		REQUIRE(ticker != std::string::npos);
+		other[ticker] = 'X';
+		REQUIRE_THROWS(resumedFile.restoreState(other));
+		REQUIRE_THROWS(QshFile<Sink>(resumed, resumedSink, state.substr(0, 20)));
 	}
 }
 
+TEST_CASE("QshFile reopen", "")
+{
+	using OrderLogEntry = QshFile<Sink>::OrderLogEntry;
+	const char* path = "data/OrdLog.VTBR-6.16.2016-04-26.qsh";
+
+	ifstream first(path, ios_base::binary | ios_base::in);
+	Sink sink;
+	QshFile<Sink> file(first, sink);
+	for(int i = 0; i < 1000; i++)
+		file.readOneFrame();
+	std::vector<OrderLogEntry> expected = sink.orderLog;
+	std::string state = file.saveState();
+
+	SECTION("Same results as a new instance")
+	{
+		ifstream second(path, ios_base::binary | ios_base::in);
+		sink.orderLog.clear();
+		file.open(second);
+		REQUIRE(file.streams().size() == 1);
+		REQUIRE(file.streams()[0].ticker == "VTBR-6.16");
+		REQUIRE(file.streams()[0].numId == 813877);
+		REQUIRE(file.getMetadata().applicationName == "QshWriter.5904");
+		for(int i = 0; i < 1000; i++)
+			file.readOneFrame();
+		REQUIRE(sink.orderLog.size() == expected.size());
+		for(size_t i = 0; i < expected.size(); i++)
+		{
+			REQUIRE(sink.orderLog[i].orderId == expected[i].orderId);
+			REQUIRE(sink.orderLog[i].frameTimestamp == expected[i].frameTimestamp);
+			REQUIRE(sink.orderLog[i].orderPrice == expected[i].orderPrice);
+		}
+	}
+
+	SECTION("From a saved state")
+	{
+		ifstream second(path, ios_base::binary | ios_base::in);
+		file.open(second, state);
+		REQUIRE(file.saveState() == state);
+	}
+
+	SECTION("After a failed open")
+	{
+		std::istringstream invalid("QScalp History Dat!");
+		REQUIRE_THROWS(file.open(invalid));
+		std::istringstream empty("");
+		REQUIRE_THROWS(file.open(empty));
+
+		ifstream second(path, ios_base::binary | ios_base::in);
+		sink.orderLog.clear();
+		file.open(second);
+		file.readOneFrame();
+		REQUIRE(sink.orderLog.front().orderId == expected.front().orderId);
+	}
+}
@@ -0,0 +1,229 @@
+
+#include "catch/catch.hpp"
+#include "qsh/qshfile.h"
+#include "qsh/qshwriter.h"
+#include "qsh/synthetic.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace qsh;
+
+namespace
+{
+	class EntrySink
+	{
+	public:
+		template <typename Entry>
+		void orderLogFrame(const Entry& entry)
+		{
+			entries.push_back(entry);
+		}
+
+		std::vector<QshFile<EntrySink>::OrderLogEntry> entries;
+	};
+}
+
+TEST_CASE("QshWriter", "")
+{
+	using OrderLogEntry = QshFile<EntrySink>::OrderLogEntry;
+
+	SECTION("Varints round trip")
+	{
+		std::stringstream stream;
+		const int64_t values[] = { 0, 1, -1, 63, 64, -64, -65, 268435454, 268435455, -(1ll << 34), (1ll << 40), -(1ll << 62) };
+		for(auto value : values)
+		{
+			helpers::writeLeb128(stream, value);
+			helpers::writeGrowing(stream, value);
+		}
+		for(auto value : values)
+		{
+			REQUIRE(helpers::readLeb128(stream) == value);
+			REQUIRE(helpers::readGrowing(stream) == value);
+		}
+	}
+
+	SECTION("Frames round trip")
+	{
+		std::stringstream stream;
+		QshWriter writer(stream, "writer", "comment", testing::SyntheticOrdLog::startTime(), { "Plaza2:TEST::1:0.01", "Plaza2:OTHER::2:1" });
+
+		OrdLogState state = {};
+		state.exchangeTime = 63596930400000ll;
+		state.orderId = 100;
+		state.orderPrice = 12345;
+		state.volume = 7;
+		writer.writeOrdLogFrame(1, 63596930401000ll, OrderLogEntry::Add | OrderLogEntry::Sell | OrderLogEntry::Quote, state);
+
+		state.orderId = 50;
+		state.volume = 3;
+		state.volumeLeft = 4;
+		state.tradeId = 9;
+		state.tradePrice = 12345;
+		state.openInterest = -20;
+		writer.writeOrdLogFrame(0, 63596930400990ll, OrderLogEntry::Fill | OrderLogEntry::Sell, state);
+
+		EntrySink sink;
+		QshFile<EntrySink> file(stream, sink);
+		auto meta = file.getMetadata();
+		REQUIRE(meta.applicationName == "writer");
+		REQUIRE(meta.comment == "comment");
+		REQUIRE(meta.startTime == testing::SyntheticOrdLog::startTime());
+
+		auto streams = file.streams();
+		REQUIRE(streams.size() == 2);
+		REQUIRE(streams[0].ticker == "TEST");
+		REQUIRE(streams[0].step == Approx(0.01));
+		REQUIRE(streams[1].numId == 2);
+
+		file.readAllFrames();
+		REQUIRE(sink.entries.size() == 2);
+		REQUIRE(sink.entries[0].frameTimestamp == 63596930401000ll);
+		REQUIRE(sink.entries[0].timestamp == 63596930400000ll);
+		REQUIRE(sink.entries[0].orderId == 100);
+		REQUIRE(sink.entries[0].orderPrice == decimal_fixed(12345, 0));
+		REQUIRE(sink.entries[0].remain == 7);
+
+		REQUIRE(sink.entries[1].frameTimestamp == 63596930400990ll);
+		REQUIRE(sink.entries[1].orderId == 50);
+		REQUIRE(sink.entries[1].volume == 3);
+		REQUIRE(sink.entries[1].remain == 4);
+		REQUIRE(sink.entries[1].matchingOrderId == 9);
+		REQUIRE(sink.entries[1].tradePrice.toDouble() == Approx(123.45));
+		REQUIRE(sink.entries[1].openInterest == -20);
+	}
+}
+
+TEST_CASE("Parts decoding", "")
+{
+	auto decodeAll = [](std::istream& stream, ordlog::PartsDecoding decoding)
+	{
+		EntrySink sink;
+		QshFile<EntrySink> file(stream, sink);
+		file.setPartsDecoding(decoding);
+		file.readAllFrames();
+		return sink.entries;
+	};
+
+	auto requireSame = [](const std::vector<QshFile<EntrySink>::OrderLogEntry>& a, const std::vector<QshFile<EntrySink>::OrderLogEntry>& b)
+	{
+		REQUIRE(a.size() == b.size());
+		size_t mismatch = 0;
+		while(mismatch < a.size() &&
+				a[mismatch].frameTimestamp == b[mismatch].frameTimestamp &&
+				a[mismatch].flags == b[mismatch].flags &&
+				a[mismatch].timestamp == b[mismatch].timestamp &&
+				a[mismatch].orderId == b[mismatch].orderId &&
+				a[mismatch].orderPrice == b[mismatch].orderPrice &&
+				a[mismatch].volume == b[mismatch].volume &&
+				a[mismatch].remain == b[mismatch].remain &&
+				a[mismatch].matchingOrderId == b[mismatch].matchingOrderId &&
+				a[mismatch].tradePrice == b[mismatch].tradePrice &&
+				a[mismatch].openInterest == b[mismatch].openInterest)
+		{
+			mismatch++;
+		}
+		REQUIRE(mismatch == a.size());
+	};
+
+	SECTION("Sample file")
+	{
+		std::ifstream sequential("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		std::ifstream table("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		requireSame(decodeAll(sequential, ordlog::PartsDecoding::Sequential), decodeAll(table, ordlog::PartsDecoding::Table));
+	}
+
+	SECTION("Order ids relative to the last Add")
+	{
+		// Frames encoded by hand: only Add frames move the base of the
+		// order ids, other frames are a signed delta from it and a frame
+		// without the OrderId part refers to the last added order
+		std::stringstream stream;
+		QshWriter writer(stream, "writer", "comment", testing::SyntheticOrdLog::startTime(), { "Plaza2:TEST::1:1" });
+		auto frame = [&](uint16_t flags, int parts, int64_t delta)
+		{
+			helpers::writeGrowing(stream, 0);
+			stream.put(parts);
+			stream.put(flags & 0xff);
+			stream.put(flags >> 8);
+			if(parts & ordlog::OrderId)
+			{
+				if(flags & ordlog::AddFlag)
+					helpers::writeGrowing(stream, delta);
+				else
+					helpers::writeLeb128(stream, delta);
+			}
+		};
+		const uint16_t add = OrderLogEntry::Add | OrderLogEntry::Quote;
+		const uint16_t cancel = OrderLogEntry::Cancelled | OrderLogEntry::Quote;
+		frame(add, ordlog::OrderId, 100);
+		frame(add, ordlog::OrderId, 5);
+		frame(cancel, ordlog::OrderId, -3);
+		frame(cancel, ordlog::OrderId, -5);
+		frame(cancel, 0, 0);
+		frame(add, ordlog::OrderId, 1);
+		const int64_t expected[] = { 100, 105, 102, 100, 105, 106 };
+
+		std::string data = stream.str();
+		for(auto decoding : { ordlog::PartsDecoding::Sequential, ordlog::PartsDecoding::Table })
+		{
+			std::istringstream in(data);
+			auto entries = decodeAll(in, decoding);
+			REQUIRE(entries.size() == 6);
+			for(size_t i = 0; i < entries.size(); i++)
+				REQUIRE(entries[i].orderId == expected[i]);
+		}
+	}
+
+	SECTION("Random parts")
+	{
+		std::ostringstream out;
+		testing::SyntheticOrdLog generator(42, 3, true);
+		generator.write(out, 20000);
+
+		std::istringstream sequential(out.str());
+		std::istringstream table(out.str());
+		requireSame(decodeAll(sequential, ordlog::PartsDecoding::Sequential), decodeAll(table, ordlog::PartsDecoding::Table));
+	}
+
+	SECTION("Security ids")
+	{
+		auto header = [](const std::vector<std::string>& codes)
+		{
+			std::ostringstream out;
+			QshWriter writer(out, "writer", "comment", testing::SyntheticOrdLog::startTime(), codes);
+			return out.str();
+		};
+
+		std::istringstream first(header({ "Plaza2:TEST:aux:123:0.05", "MICEX:SBER::-7:1e-3" }));
+		EntrySink sink;
+		QshFile<EntrySink> file(first, sink);
+		const auto& streams = file.streams();
+		REQUIRE(streams.size() == 2);
+		REQUIRE(streams[0].code == "Plaza2:TEST:aux:123:0.05");
+		REQUIRE(streams[0].connector == "Plaza2");
+		REQUIRE(streams[0].ticker == "TEST");
+		REQUIRE(streams[0].auxcode == "aux");
+		REQUIRE(streams[0].numId == 123);
+		REQUIRE(streams[0].step == 0.05);
+		REQUIRE(streams[1].connector == "MICEX");
+		REQUIRE(streams[1].auxcode.empty());
+		REQUIRE(streams[1].numId == -7);
+		REQUIRE(streams[1].step == 0.001);
+
+		// The same vector, now describing the other file
+		std::istringstream second(header({ "Plaza2:SI-6.16::42:1" }));
+		file.open(second);
+		REQUIRE(&file.streams() == &streams);
+		REQUIRE(streams.size() == 1);
+		REQUIRE(streams[0].ticker == "SI-6.16");
+		REQUIRE(streams[0].numId == 42);
+
+		for(auto code : { "Plaza2:TEST::1", "Plaza2:TEST::x1:1", "Plaza2:TEST:::1", "Plaza2:TEST::1:0.01 ", "Plaza2:TEST::1:" })
+		{
+			std::istringstream invalid(header({ code }));
+			REQUIRE_THROWS(file.open(invalid));
+		}
+	}
+}
@@ -0,0 +1,120 @@
+
+#include "catch/catch.hpp"
+#include "qsh/qshfile.h"
+#include "qsh/readahead.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace qsh;
+
+namespace
+{
+	const char* samplePath = "data/OrdLog.VTBR-6.16.2016-04-26.qsh";
+
+	class ChecksumSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			count++;
+			checksum = checksum * 31 + entry.frameTimestamp + entry.timestamp + entry.orderId + entry.volume + entry.remain +
+				entry.flags + entry.orderPrice.value + entry.tradePrice.value + entry.openInterest;
+		}
+
+		size_t count = 0;
+		uint64_t checksum = 0;
+	};
+
+	ChecksumSink decode(std::streambuf* buffer)
+	{
+		std::istream stream(buffer);
+		ChecksumSink sink;
+		QshFile<ChecksumSink> file(stream, sink);
+		file.readAllFrames();
+		return sink;
+	}
+
+	std::string readAll(std::streambuf* buffer)
+	{
+		std::istream stream(buffer);
+		std::ostringstream out;
+		out << stream.rdbuf();
+		return out.str();
+	}
+}
+
+TEST_CASE("Read-ahead input", "")
+{
+	std::ifstream reference(samplePath, std::ios_base::binary | std::ios_base::in);
+	auto expected = decode(reference.rdbuf());
+	std::ifstream raw(samplePath, std::ios_base::binary | std::ios_base::in);
+	const std::string bytes = readAll(raw.rdbuf());
+	REQUIRE(expected.count > 0);
+
+	SECTION("Thread backend")
+	{
+		// Small blocks so that frames straddle block boundaries
+		ReadAheadStreambuf buffer(samplePath, 4096, 3, ReadAheadStreambuf::Backend::Thread);
+		REQUIRE(std::string(buffer.backendName()) == "thread");
+		auto result = decode(&buffer);
+		REQUIRE(result.count == expected.count);
+		REQUIRE(result.checksum == expected.checksum);
+	}
+
+	SECTION("Default backend")
+	{
+		ReadAheadStreambuf buffer(samplePath, 65536, 4);
+		auto result = decode(&buffer);
+		REQUIRE(result.count == expected.count);
+		REQUIRE(result.checksum == expected.checksum);
+	}
+
+	SECTION("Block size dividing the file")
+	{
+		// The sample is 1261003 bytes = 647 * 1949, so the last read is empty
+		for(auto backend : { ReadAheadStreambuf::Backend::Auto, ReadAheadStreambuf::Backend::Thread })
+		{
+			ReadAheadStreambuf buffer(samplePath, 1949, 2, backend);
+			REQUIRE(readAll(&buffer) == bytes);
+		}
+	}
+
+	SECTION("Seeking")
+	{
+		for(auto backend : { ReadAheadStreambuf::Backend::Auto, ReadAheadStreambuf::Backend::Thread })
+		{
+			ReadAheadStreambuf buffer(samplePath, 1000, 3, backend);
+			std::istream stream(&buffer);
+			char c;
+			stream.seekg(123456);
+			REQUIRE(stream.tellg() == 123456);
+			stream.get(c);
+			REQUIRE(c == bytes[123456]);
+			stream.seekg(-10, std::ios_base::cur);
+			stream.get(c);
+			REQUIRE(c == bytes[123447]);
+			stream.seekg(5);
+			stream.get(c);
+			REQUIRE(c == bytes[5]);
+			stream.seekg(-1, std::ios_base::end);
+			stream.get(c);
+			REQUIRE(c == bytes.back());
+			REQUIRE(stream.get() == std::char_traits<char>::eof());
+		}
+	}
+
+	SECTION("Mapped file")
+	{
+		MmapStreambuf buffer(samplePath);
+		auto result = decode(&buffer);
+		REQUIRE(result.count == expected.count);
+		REQUIRE(result.checksum == expected.checksum);
+	}
+
+	SECTION("Missing file")
+	{
+		REQUIRE_THROWS(ReadAheadStreambuf("data/missing.qsh"));
+		REQUIRE_THROWS(MmapStreambuf("data/missing.qsh"));
+	}
+}
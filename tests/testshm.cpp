@@ -0,0 +1,211 @@
+
+#include "catch/catch.hpp"
+#include "qsh/qshfile.h"
+#include "qsh/shm.h"
+#include "qsh/synthetic.h"
+
+#include <sstream>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace qsh;
+
+namespace
+{
+	class ChecksumSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			count++;
+			checksum = checksum * 31 + entry.frameTimestamp + entry.timestamp + entry.orderId + entry.volume + entry.remain +
+				entry.flags + entry.orderPrice.value + entry.orderPrice.fractional + entry.tradePrice.value +
+				entry.matchingOrderId + entry.openInterest + entry.streamNumber;
+		}
+
+		size_t count = 0;
+		uint64_t checksum = 0;
+	};
+
+	std::string shmName()
+	{
+		return "/libqsh-test-" + std::to_string(getpid());
+	}
+}
+
+TEST_CASE("Shared memory fan-out", "")
+{
+	std::ostringstream out;
+	testing::SyntheticOrdLog generator(9, 2);
+	generator.write(out, 20000);
+	const std::string data = out.str();
+	const std::string name = shmName();
+
+	ChecksumSink expected;
+	{
+		std::istringstream stream(data);
+		QshFile<ChecksumSink> file(stream, expected);
+		file.readAllFrames();
+	}
+
+	SECTION("Price conversion")
+	{
+		for(auto value : { decimal_fixed(0, 0), decimal_fixed(7000, 1), decimal_fixed(-3, 999999999), decimal_fixed(123, 450000000) })
+		{
+			auto converted = decimal_fixed::fromNanos(value.toNanos());
+			REQUIRE(converted == value);
+		}
+	}
+
+	SECTION("Every reader thread sees every event")
+	{
+		ShmPublisher::Options options;
+		options.capacity = 1024;
+		options.maxLag = 512;
+		ShmPublisher publisher(name, options);
+
+		const int readers = 3;
+		std::vector<ChecksumSink> sinks(readers);
+		std::vector<std::thread> threads;
+		for(int i = 0; i < readers; i++)
+		{
+			threads.emplace_back([&, i]()
+					{
+						ShmSubscriber<ChecksumSink> subscriber(name, sinks[i]);
+						subscriber.readAllFrames();
+					});
+		}
+		REQUIRE(publisher.waitForReaders(readers, std::chrono::milliseconds(5000)));
+
+		std::istringstream stream(data);
+		QshFile<ShmPublisher> file(stream, publisher);
+		file.readAllFrames();
+		publisher.finish();
+		for(auto& thread : threads)
+			thread.join();
+
+		REQUIRE(publisher.published() == expected.count);
+		for(const auto& sink : sinks)
+		{
+			REQUIRE(sink.count == expected.count);
+			REQUIRE(sink.checksum == expected.checksum);
+		}
+	}
+
+	SECTION("Reader process")
+	{
+		ShmPublisher publisher(name);
+		int fds[2];
+		REQUIRE(pipe(fds) == 0);
+		pid_t child = fork();
+		REQUIRE(child >= 0);
+		if(child == 0)
+		{
+			ChecksumSink sink;
+			uint64_t result[2] = { 0, 0 };
+			try
+			{
+				ShmSubscriber<ChecksumSink> subscriber(name, sink);
+				subscriber.readAllFrames();
+				result[0] = sink.count;
+				result[1] = sink.checksum;
+			}
+			catch(...)
+			{
+			}
+			if(write(fds[1], result, sizeof(result)) != sizeof(result))
+				_exit(1);
+			_exit(0);
+		}
+
+		REQUIRE(publisher.waitForReaders(1, std::chrono::milliseconds(5000)));
+		std::istringstream stream(data);
+		QshFile<ShmPublisher> file(stream, publisher);
+		file.readAllFrames();
+		publisher.finish();
+
+		uint64_t result[2];
+		REQUIRE(read(fds[0], result, sizeof(result)) == sizeof(result));
+		int status = 0;
+		waitpid(child, &status, 0);
+		close(fds[0]);
+		close(fds[1]);
+		REQUIRE(result[0] == expected.count);
+		REQUIRE(result[1] == expected.checksum);
+	}
+
+	SECTION("Live segment is not replaced")
+	{
+		ShmPublisher publisher(name);
+		ChecksumSink sink;
+		ShmSubscriber<ChecksumSink> subscriber(name, sink);
+		REQUIRE_THROWS(ShmPublisher{ name });
+		REQUIRE(publisher.activeReaders() == 1);
+
+		// A segment left behind, e.g. by a crashed publisher, is only
+		// replaced on request
+		ShmPublisher::Options options;
+		options.replaceExisting = true;
+		ShmPublisher replacement(name, options);
+		REQUIRE(replacement.activeReaders() == 0);
+	}
+
+	SECTION("Slots of exited readers are reclaimed")
+	{
+		ShmPublisher::Options options;
+		options.maxReaders = 1;
+		ShmPublisher publisher(name, options);
+
+		// A reader that exits without detaching
+		pid_t child = fork();
+		REQUIRE(child >= 0);
+		if(child == 0)
+		{
+			ChecksumSink sink;
+			new ShmSubscriber<ChecksumSink>(name, sink);
+			_exit(0);
+		}
+		int status = 0;
+		waitpid(child, &status, 0);
+		REQUIRE(publisher.activeReaders() == 1);
+
+		ChecksumSink sink;
+		ShmSubscriber<ChecksumSink> subscriber(name, sink);
+		REQUIRE(publisher.activeReaders() == 1);
+		// The slot of a live reader is not taken
+		REQUIRE_THROWS(ShmSubscriber<ChecksumSink>(name, sink));
+	}
+
+	SECTION("Stalled reader is evicted")
+	{
+		ShmPublisher::Options options;
+		options.capacity = 256;
+		options.maxLag = 256;
+		options.stallTimeout = std::chrono::milliseconds(20);
+		ShmPublisher publisher(name, options);
+
+		ChecksumSink fast;
+		ChecksumSink stalled;
+		ShmSubscriber<ChecksumSink> stalledSubscriber(name, stalled);
+		std::thread fastThread([&]()
+				{
+					ShmSubscriber<ChecksumSink> subscriber(name, fast);
+					subscriber.readAllFrames();
+				});
+		REQUIRE(publisher.waitForReaders(2, std::chrono::milliseconds(5000)));
+
+		std::istringstream stream(data);
+		QshFile<ShmPublisher> file(stream, publisher);
+		file.readAllFrames();
+		publisher.finish();
+		fastThread.join();
+
+		REQUIRE(fast.count == expected.count);
+		REQUIRE(fast.checksum == expected.checksum);
+		REQUIRE(publisher.activeReaders() == 0);
+		REQUIRE_THROWS(stalledSubscriber.readAvailableFrames());
+		REQUIRE(stalled.count == 0);
+	}
+}
@@ -0,0 +1,100 @@
+
+#include "catch/catch.hpp"
+#include "qsh/qshfile.h"
+#include "qsh/sinks.h"
+#include "qsh/synthetic.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace qsh;
+
+namespace
+{
+	class CountingSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			count++;
+			volume += entry.volume;
+		}
+
+		size_t count = 0;
+		int64_t volume = 0;
+	};
+
+	class ReferenceSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			all++;
+			if(entry.flags & OrderLogEntry::Fill)
+				fills++;
+			if((entry.flags & (OrderLogEntry::Add | OrderLogEntry::Buy)) == (OrderLogEntry::Add | OrderLogEntry::Buy))
+				buyAdds++;
+			if(!(entry.flags & OrderLogEntry::Quote))
+				nonQuotes++;
+			if(entry.streamNumber == 1)
+			{
+				streamOne++;
+				streamOneVolume += 2 * entry.volume;
+			}
+		}
+
+		size_t all = 0;
+		size_t fills = 0;
+		size_t buyAdds = 0;
+		size_t nonQuotes = 0;
+		size_t streamOne = 0;
+		int64_t streamOneVolume = 0;
+	};
+}
+
+TEST_CASE("Sink composition", "")
+{
+	std::ostringstream out;
+	testing::SyntheticOrdLog generator(13, 2);
+	generator.write(out, 20000);
+	const std::string data = out.str();
+
+	ReferenceSink reference;
+	{
+		std::istringstream stream(data);
+		QshFile<ReferenceSink> file(stream, reference);
+		file.readAllFrames();
+	}
+
+	CountingSink all;
+	CountingSink fills;
+	CountingSink buyAdds;
+	CountingSink nonQuotes;
+	CountingSink streamOne;
+
+	auto doubleVolume = [](const OrderLogEntry& entry)
+	{
+		OrderLogEntry result = entry;
+		result.volume *= 2;
+		return result;
+	};
+
+	auto sink = sinks::fanOut(all,
+			sinks::filter(sinks::FlagsAny<OrderLogEntry::Fill>(), fills),
+			sinks::filter(sinks::FlagsAll<OrderLogEntry::Add | OrderLogEntry::Buy>(), buyAdds),
+			sinks::filter(sinks::FlagsNone<OrderLogEntry::Quote>(), nonQuotes),
+			sinks::filter(sinks::Stream(1), sinks::map(doubleVolume, streamOne)));
+
+	std::istringstream stream(data);
+	QshFile<decltype(sink)> file(stream, sink);
+	file.readAllFrames();
+
+	REQUIRE(all.count == reference.all);
+	REQUIRE(fills.count == reference.fills);
+	REQUIRE(fills.count > 0);
+	REQUIRE(buyAdds.count == reference.buyAdds);
+	REQUIRE(nonQuotes.count == reference.nonQuotes);
+	REQUIRE(streamOne.count == reference.streamOne);
+	REQUIRE(streamOne.volume == reference.streamOneVolume);
+	REQUIRE(&sink.get<0>() == &all);
+}
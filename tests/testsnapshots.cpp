@@ -0,0 +1,124 @@
+#include "catch/catch.hpp"
+#include "qsh/snapshots.h"
+#include "qsh/qshfile.h"
+#include "entries.h"
+
+#include <fstream>
+
+using namespace qsh;
+using namespace qsh::testing;
+
+namespace
+{
+	const uint16_t End = OrderLogEntry::EndOfTransaction;
+}
+
+TEST_CASE("SnapshotSampler", "[snapshots]")
+{
+	SECTION("Levels")
+	{
+		SnapshotSampler<> sampler(1, 3, SnapshotCadence { SnapshotCadence::Events, 1 });
+		sampler.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 1, 100, 5, 0));
+		sampler.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote, 2, 100, 2, 0));
+		sampler.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote | End, 3, 98, 1, 0));
+		sampler.orderLogFrame(entry(OrderLogEntry::Add | SellQuote | End, 4, 103, 7, 0));
+
+		auto& snapshots = sampler.snapshots();
+		REQUIRE(snapshots.depth() == 3);
+		REQUIRE(snapshots.size() == 2);
+		REQUIRE(snapshots.events[0] == 3);
+		REQUIRE(snapshots.events[1] == 4);
+
+		REQUIRE(snapshots.bidPrice[0][0] == 100);
+		REQUIRE(snapshots.bidVolume[0][0] == 7);
+		REQUIRE(snapshots.bidPrice[1][0] == 98);
+		REQUIRE(snapshots.bidVolume[1][0] == 1);
+		REQUIRE(snapshots.bidPrice[2][0] == 0);
+		REQUIRE(snapshots.bidVolume[2][0] == 0);
+		REQUIRE(snapshots.askPrice[0][0] == 0);
+
+		REQUIRE(snapshots.askPrice[0][1] == 103);
+		REQUIRE(snapshots.askVolume[0][1] == 7);
+		REQUIRE(snapshots.askPrice[1][1] == 0);
+
+		snapshots.clear();
+		REQUIRE(snapshots.size() == 0);
+		REQUIRE(snapshots.bidPrice[0].empty());
+	}
+
+	SECTION("Events cadence")
+	{
+		SnapshotSampler<> sampler(1, 1, SnapshotCadence { SnapshotCadence::Events, 3 });
+		for(int i = 0; i < 10; i++)
+			sampler.orderLogFrame(entry(OrderLogEntry::Add | BuyQuote | (i % 2 ? End : 0), i + 1, 100, 1, i));
+
+		// Boundaries at 2, 4, ..., 10 entries; due after 3 since the last
+		auto& snapshots = sampler.snapshots();
+		REQUIRE(snapshots.size() == 2);
+		REQUIRE(snapshots.events[0] == 4);
+		REQUIRE(snapshots.events[1] == 8);
+		REQUIRE(snapshots.bidVolume[0][1] == 8);
+	}
+
+	SECTION("Time cadence")
+	{
+		SnapshotSampler<> sampler(1, 1, SnapshotCadence { SnapshotCadence::Time, 100 });
+		datetime_t times[] = { 1005, 1010, 1090, 1150, 1160, 1420 };
+		for(size_t i = 0; i < 6; i++)
+			sampler.orderLogFrame(entry(OrderLogEntry::Add | SellQuote | End, i + 1, 100, 1, times[i]));
+
+		auto& snapshots = sampler.snapshots();
+		REQUIRE(snapshots.size() == 3);
+		REQUIRE(snapshots.time[0] == 1005);
+		REQUIRE(snapshots.time[1] == 1150);
+		REQUIRE(snapshots.time[2] == 1420);
+		REQUIRE(snapshots.askVolume[0][2] == 6);
+	}
+
+	SECTION("Frame clock")
+	{
+		SnapshotSampler<BarClock::Frame> sampler(1, 1, SnapshotCadence { SnapshotCadence::Time, 100 });
+		auto e = entry(OrderLogEntry::Add | SellQuote | End, 1, 100, 1, 0);
+		e.frameTimestamp = 777;
+		sampler.orderLogFrame(e);
+		REQUIRE(sampler.snapshots().time[0] == 777);
+	}
+
+	SECTION("Invalid parameters")
+	{
+		REQUIRE_THROWS(SnapshotSampler<>(1, 0, SnapshotCadence { SnapshotCadence::Events, 1 }));
+		REQUIRE_THROWS(SnapshotSampler<>(1, 5, SnapshotCadence { SnapshotCadence::Time, 0 }));
+	}
+}
+
+TEST_CASE("SnapshotSampler on sample file", "[snapshots]")
+{
+	const size_t depth = 5;
+	std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+	SnapshotSampler<> sampler(1, depth, SnapshotCadence { SnapshotCadence::Time, 100 });
+	QshFile<SnapshotSampler<>> file(stream, sampler);
+	file.readAllFrames();
+
+	auto& snapshots = sampler.snapshots();
+	REQUIRE(snapshots.size() > 1000);
+	for(size_t row = 0; row < snapshots.size(); row++)
+	{
+		if(row > 0)
+		{
+			REQUIRE(snapshots.time[row] / 100 > snapshots.time[row - 1] / 100);
+			REQUIRE(snapshots.events[row] > snapshots.events[row - 1]);
+		}
+		for(size_t level = 0; level < depth; level++)
+		{
+			REQUIRE((snapshots.bidPrice[level][row] == 0) == (snapshots.bidVolume[level][row] == 0));
+			REQUIRE((snapshots.askPrice[level][row] == 0) == (snapshots.askVolume[level][row] == 0));
+			if(level > 0 && snapshots.bidPrice[level][row])
+				REQUIRE(snapshots.bidPrice[level][row] < snapshots.bidPrice[level - 1][row]);
+			if(level > 0 && snapshots.askPrice[level][row])
+				REQUIRE(snapshots.askPrice[level][row] > snapshots.askPrice[level - 1][row]);
+		}
+		if(snapshots.bidPrice[0][row] && snapshots.askPrice[0][row])
+			REQUIRE(snapshots.bidPrice[0][row] < snapshots.askPrice[0][row]);
+	}
+	REQUIRE(snapshots.bidPrice[0].capacity() == snapshots.time.capacity());
+}
@@ -0,0 +1,134 @@
+#include "catch/catch.hpp"
+#include "qsh/qshfile.h"
+#include "qsh/stats.h"
+#include "qsh/synthetic.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace qsh;
+
+namespace
+{
+	class CountingSink
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry&)
+		{
+			count++;
+		}
+
+		uint64_t count = 0;
+	};
+
+	// Every encoded byte after the headers is accounted for
+	void requireConsistent(const DecoderStats::Snapshot& snapshot, uint64_t frames, uint64_t frameBytes)
+	{
+		REQUIRE(snapshot.totalFrames() == frames);
+		REQUIRE(snapshot.totalBytes() == frameBytes);
+
+		uint64_t parts = 0;
+		for(auto count : snapshot.parts)
+			parts += count;
+		REQUIRE(parts == frames);
+
+		uint64_t fields = 0;
+		for(auto count : snapshot.varintSize)
+			fields += count;
+		REQUIRE(snapshot.varintSize[0] == 0);
+		REQUIRE(fields >= frames);
+
+		REQUIRE(snapshot.sampledFrames == (frames + 63) / 64);
+	}
+}
+
+TEST_CASE("Encoded sizes", "")
+{
+	std::ostringstream out;
+	for(int64_t value : { 0ll, 1ll, -1ll, 63ll, 64ll, -64ll, -65ll, 8191ll, 8192ll, -8193ll, (long long)INT64_MAX, (long long)INT64_MIN })
+	{
+		out.str("");
+		helpers::writeLeb128(out, value);
+		REQUIRE(stats::leb128Size(value) == out.str().size());
+
+		out.str("");
+		helpers::writeGrowing(out, value);
+		REQUIRE(stats::growingSize(value) == out.str().size());
+
+		if(value >= 0 && value <= UINT32_MAX)
+		{
+			out.str("");
+			helpers::writeULeb128(out, value);
+			REQUIRE(stats::uleb128Size(value) == out.str().size());
+		}
+	}
+}
+
+TEST_CASE("DecoderStats", "")
+{
+	SECTION("Sample file")
+	{
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		CountingSink sink;
+		QshFile<CountingSink, DecoderStats> file(stream, sink);
+		uint64_t headerBytes = stream.tellg();
+		file.readAllFrames();
+
+		auto snapshot = file.stats().snapshot();
+		requireConsistent(snapshot, sink.count, 1261003 - headerBytes);
+		REQUIRE(snapshot.frames[0] == 159036);
+		REQUIRE(snapshot.decodeTicks > 0);
+		REQUIRE(snapshot.sinkShare() < 1.0);
+		REQUIRE(snapshot.eventsPerSecond() > 0);
+	}
+
+	SECTION("Synthetic streams with all parts patterns")
+	{
+		std::ostringstream out;
+		testing::SyntheticOrdLog generator(7, 3, true);
+		generator.write(out, 20000);
+		std::string data = out.str();
+
+		std::istringstream stream(data);
+		CountingSink sink;
+		QshFile<CountingSink, DecoderStats> file(stream, sink);
+		uint64_t headerBytes = stream.tellg();
+		file.readAllFrames();
+
+		auto snapshot = file.stats().snapshot();
+		requireConsistent(snapshot, 20000, data.size() - headerBytes);
+		REQUIRE(snapshot.frames[0] > 0);
+		REQUIRE(snapshot.frames[1] > 0);
+		REQUIRE(snapshot.frames[2] > 0);
+		REQUIRE(snapshot.frames[3] == 0);
+	}
+
+	SECTION("Polling from another thread")
+	{
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		CountingSink sink;
+		QshFile<CountingSink, DecoderStats> file(stream, sink);
+
+		std::atomic<bool> done(false);
+		bool monotonic = true;
+		std::thread poller([&]()
+				{
+					uint64_t last = 0;
+					while(!done.load())
+					{
+						uint64_t frames = file.stats().snapshot().totalFrames();
+						monotonic = monotonic && frames >= last;
+						last = frames;
+						std::this_thread::yield();
+					}
+				});
+		file.readAllFrames();
+		done.store(true);
+		poller.join();
+
+		REQUIRE(monotonic);
+		REQUIRE(file.stats().snapshot().totalFrames() == sink.count);
+	}
+}
@@ -0,0 +1,163 @@
+#include "catch/catch.hpp"
+#include "qsh/trades.h"
+#include "qsh/qshfile.h"
+
+#include <fstream>
+#include <unordered_map>
+
+using namespace qsh;
+
+namespace
+{
+	OrderLogEntry entry(uint16_t flags, long long orderId, long long tradeId, int volume, int stream = 0)
+	{
+		OrderLogEntry result = {};
+		result.flags = flags;
+		result.streamNumber = stream;
+		result.orderId = orderId;
+		result.matchingOrderId = tradeId;
+		result.orderPrice = decimal_fixed(100, 0);
+		result.tradePrice = (flags & OrderLogEntry::Fill) ? decimal_fixed(100, 500000000) : decimal_fixed();
+		result.volume = volume;
+		result.timestamp = tradeId * 10;
+		result.frameTimestamp = tradeId * 10 + 1;
+		result.openInterest = 1000 + tradeId;
+		return result;
+	}
+
+	const uint16_t Buy = OrderLogEntry::Buy;
+	const uint16_t Sell = OrderLogEntry::Sell;
+	const uint16_t Quote = OrderLogEntry::Quote;
+	const uint16_t Fill = OrderLogEntry::Fill;
+	const uint16_t Add = OrderLogEntry::Add;
+	const uint16_t Counter = OrderLogEntry::Counter;
+	const uint16_t End = OrderLogEntry::EndOfTransaction;
+
+	struct Tape
+	{
+		void dealFrame(const Deal& deal)
+		{
+			deals.push_back(deal);
+		}
+
+		std::vector<Deal> deals;
+	};
+}
+
+TEST_CASE("TradeReconstructor", "[trades]")
+{
+	Tape tape;
+	TradeReconstructor<Tape> trades(tape);
+	auto& deals = tape.deals;
+
+	SECTION("Counter aggressor")
+	{
+		trades.orderLogFrame(entry(Counter | Add | Buy, 20, 0, 3));
+		trades.orderLogFrame(entry(Counter | Fill | Buy, 20, 1, 3));
+		REQUIRE(deals.empty());
+		trades.orderLogFrame(entry(Quote | Fill | Sell | End, 10, 1, 3));
+		REQUIRE(deals.size() == 1);
+		const Deal& deal = deals[0];
+		REQUIRE(deal.type == Deal::Buy);
+		REQUIRE(deal.id == 1);
+		REQUIRE(deal.buyOrderId == 20);
+		REQUIRE(deal.sellOrderId == 10);
+		REQUIRE(deal.price == decimal_fixed(100, 500000000));
+		REQUIRE(deal.volume == 3);
+		REQUIRE(deal.timestamp == 10);
+		REQUIRE(deal.frameTimestamp == 11);
+		REQUIRE(deal.openInterest == 1001);
+		REQUIRE(trades.deals() == 1);
+		REQUIRE(trades.unpaired() == 0);
+	}
+
+	SECTION("Quote aggressor added in the transaction")
+	{
+		// The resting buyer has the larger id
+		trades.orderLogFrame(entry(Quote | Add | Sell, 25, 0, 4));
+		trades.orderLogFrame(entry(Quote | Fill | Buy, 30, 2, 1));
+		trades.orderLogFrame(entry(Quote | Fill | Sell | End, 25, 2, 1));
+		REQUIRE(deals.size() == 1);
+		REQUIRE(deals[0].type == Deal::Sell);
+
+		// Without an Add the newer order is the aggressor
+		trades.orderLogFrame(entry(Quote | Fill | Sell, 40, 3, 1));
+		trades.orderLogFrame(entry(Quote | Fill | Buy | End, 35, 3, 1));
+		REQUIRE(deals.size() == 2);
+		REQUIRE(deals[1].type == Deal::Sell);
+		REQUIRE(deals[1].buyOrderId == 35);
+	}
+
+	SECTION("Pairs apart, several per transaction, several streams")
+	{
+		trades.orderLogFrame(entry(OrderLogEntry::FillOrKill | Fill | Sell, 50, 4, 2));
+		trades.orderLogFrame(entry(Quote | Fill | Buy, 41, 5, 1, 1));
+		trades.orderLogFrame(entry(Quote | Fill | Buy, 42, 6, 1));
+		REQUIRE(deals.empty());
+		trades.orderLogFrame(entry(Quote | Fill | Buy, 43, 4, 2));
+		REQUIRE(deals.size() == 1);
+		REQUIRE(deals[0].id == 4);
+		REQUIRE(deals[0].buyOrderId == 43);
+		REQUIRE(deals[0].sellOrderId == 50);
+		REQUIRE(deals[0].type == Deal::Sell);
+		trades.orderLogFrame(entry(OrderLogEntry::FillOrKill | Fill | Sell, 50, 6, 1));
+		REQUIRE(deals.size() == 2);
+		REQUIRE(deals[1].id == 6);
+		trades.orderLogFrame(entry(OrderLogEntry::FillOrKill | Sell | End, 50, 0, 0));
+		trades.orderLogFrame(entry(Counter | Fill | Sell | End, 60, 5, 1, 1));
+		REQUIRE(deals.size() == 3);
+		REQUIRE(deals[2].streamNumber == 1);
+		REQUIRE(deals[2].type == Deal::Sell);
+		REQUIRE(trades.unpaired() == 0);
+	}
+
+	SECTION("Unpaired fills")
+	{
+		trades.orderLogFrame(entry(Quote | Fill | Buy | End, 10, 7, 1));
+		trades.orderLogFrame(entry(Counter | Fill | Sell, 11, 8, 1));
+		REQUIRE(deals.size() == 1);
+		trades.flush();
+		REQUIRE(deals.size() == 2);
+		REQUIRE(trades.unpaired() == 2);
+		REQUIRE(deals[0].type == Deal::Unknown);
+		REQUIRE(deals[0].buyOrderId == 10);
+		REQUIRE(deals[0].sellOrderId == 0);
+		REQUIRE(deals[1].type == Deal::Sell);
+	}
+
+	SECTION("A day of data matches a group-by")
+	{
+		struct Fills
+		{
+			void orderLogFrame(const OrderLogEntry& entry)
+			{
+				trades->orderLogFrame(entry);
+				if(entry.flags & OrderLogEntry::Fill)
+					byTrade[entry.matchingOrderId].push_back(entry);
+			}
+
+			TradeReconstructor<Tape>* trades;
+			std::unordered_map<long long, std::vector<OrderLogEntry>> byTrade;
+		} fills;
+		fills.trades = &trades;
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		QshFile<Fills> file(stream, fills);
+		file.readAllFrames();
+		trades.flush();
+
+		REQUIRE(trades.unpaired() == 0);
+		REQUIRE(deals.size() == fills.byTrade.size());
+		for(const auto& deal : deals)
+		{
+			const auto& pair = fills.byTrade[deal.id];
+			REQUIRE(pair.size() == 2);
+			// In Plaza2 data the aggressor's fill comes first
+			Deal::Type expected = (pair[0].flags & OrderLogEntry::Buy) ? Deal::Buy : Deal::Sell;
+			REQUIRE(deal.type == expected);
+			REQUIRE(deal.price == pair[0].tradePrice);
+			REQUIRE(deal.volume == pair[0].volume);
+			REQUIRE(deal.buyOrderId != 0);
+			REQUIRE(deal.sellOrderId != 0);
+		}
+	}
+}
@@ -0,0 +1,100 @@
+
+#include "catch/catch.hpp"
+#include "qsh/qshfile.h"
+#include "qsh/transactionsink.h"
+#include "qsh/synthetic.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace qsh;
+
+namespace
+{
+	class TransactionCollector
+	{
+	public:
+		void orderLogTransaction(OrderLogSpan transaction)
+		{
+			transactions++;
+			entries += transaction.size();
+			maxSize = std::max(maxSize, transaction.size());
+			for(size_t i = 0; i + 1 < transaction.size(); i++)
+			{
+				if(transaction[i].flags & OrderLogEntry::EndOfTransaction)
+					splitInside++;
+				if(transaction[i].streamNumber != transaction.back().streamNumber)
+					mixedStreams++;
+			}
+			if(!(transaction.back().flags & OrderLogEntry::EndOfTransaction))
+				unterminated++;
+		}
+
+		size_t transactions = 0;
+		size_t entries = 0;
+		size_t maxSize = 0;
+		size_t splitInside = 0;
+		size_t mixedStreams = 0;
+		size_t unterminated = 0;
+	};
+
+	class EndCounter
+	{
+	public:
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			entries++;
+			if(entry.flags & OrderLogEntry::EndOfTransaction)
+				ends++;
+		}
+
+		size_t entries = 0;
+		size_t ends = 0;
+	};
+}
+
+TEST_CASE("TransactionSink", "")
+{
+	SECTION("Sample file")
+	{
+		EndCounter reference;
+		{
+			std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+			QshFile<EndCounter> file(stream, reference);
+			file.readAllFrames();
+		}
+
+		std::ifstream stream("data/OrdLog.VTBR-6.16.2016-04-26.qsh", std::ios_base::binary | std::ios_base::in);
+		TransactionCollector collector;
+		TransactionSink<TransactionCollector> sink(collector);
+		QshFile<TransactionSink<TransactionCollector>> file(stream, sink);
+		file.readAllFrames();
+		sink.flush();
+
+		REQUIRE(collector.entries == reference.entries);
+		REQUIRE(collector.transactions == reference.ends + collector.unterminated);
+		REQUIRE(collector.unterminated <= 1);
+		REQUIRE(collector.splitInside == 0);
+		REQUIRE(collector.maxSize > 1);
+		REQUIRE(sink.pending() == 0);
+	}
+
+	SECTION("Interleaved streams")
+	{
+		std::ostringstream out;
+		testing::SyntheticOrdLog generator(7, 3);
+		generator.write(out, 50000);
+
+		std::istringstream stream(out.str());
+		TransactionCollector collector;
+		TransactionSink<TransactionCollector> sink(collector);
+		QshFile<TransactionSink<TransactionCollector>> file(stream, sink);
+		file.readAllFrames();
+
+		REQUIRE(sink.pending() == 0);
+		REQUIRE(collector.entries >= 50000);
+		REQUIRE(collector.mixedStreams == 0);
+		REQUIRE(collector.unterminated == 0);
+		REQUIRE(collector.splitInside == 0);
+	}
+}
@@ -0,0 +1,145 @@
+#include "catch/catch.hpp"
+#include "qsh/verify.h"
+#include "qsh/synthetic.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <unistd.h>
+
+using namespace qsh;
+
+namespace
+{
+	const char* SampleFile = "data/OrdLog.VTBR-6.16.2016-04-26.qsh";
+
+	// Passes entries on, altering or dropping the one with index 'frame'
+	class Corrupter
+	{
+	public:
+		Corrupter(verify::Recorder& next, uint64_t frame, bool drop) : next_(next),
+			frame_(frame),
+			drop_(drop),
+			count_(0)
+		{
+		}
+
+		void orderLogFrame(const OrderLogEntry& entry)
+		{
+			if(count_++ != frame_)
+			{
+				next_.orderLogFrame(entry);
+			}
+			else if(!drop_)
+			{
+				OrderLogEntry changed = entry;
+				changed.volume++;
+				next_.orderLogFrame(changed);
+			}
+		}
+
+	private:
+		verify::Recorder& next_;
+		uint64_t frame_;
+		bool drop_;
+		uint64_t count_;
+	};
+
+	verify::Engine corrupting(uint64_t frame, bool drop)
+	{
+		return { "corrupt", [frame, drop](const std::string& path, verify::Recorder& recorder)
+			{
+				std::ifstream stream(path, std::ios_base::binary | std::ios_base::in);
+				Corrupter corrupter(recorder, frame, drop);
+				QshFile<Corrupter> file(stream, corrupter);
+				file.readAllFrames();
+			} };
+	}
+}
+
+TEST_CASE("Differential verification", "")
+{
+	SECTION("All engines agree on the sample file")
+	{
+		auto report = verify::compare(SampleFile);
+		INFO(report.toString());
+		REQUIRE(report.ok());
+		REQUIRE(report.results.size() == verify::engines().size());
+		for(const auto& result : report.results)
+			REQUIRE(result.frames == 159036);
+	}
+
+	SECTION("All engines agree on a generated file")
+	{
+		char path[] = "/tmp/libqsh-verify-XXXXXX";
+		int fd = mkstemp(path);
+		REQUIRE(fd >= 0);
+		close(fd);
+		{
+			std::ofstream out(path, std::ios_base::binary | std::ios_base::out);
+			testing::SyntheticOrdLog generator(11, 4, false);
+			generator.write(out, 300000);
+		}
+
+		auto report = verify::compare(path);
+		unlink(path);
+		INFO(report.toString());
+		REQUIRE(report.ok());
+		REQUIRE(report.results[0].frames >= 300000);
+	}
+
+	SECTION("Entries are compared field by field")
+	{
+		OrderLogEntry a = {};
+		a.orderId = 5;
+		a.orderPrice = decimal_fixed(100, 250000000);
+		OrderLogEntry b = a;
+		REQUIRE(verify::sameEntry(a, b));
+		REQUIRE(verify::differingField(a, b) == nullptr);
+
+		b.orderPrice = decimal_fixed(100, 250000001);
+		REQUIRE(!verify::sameEntry(a, b));
+		REQUIRE(std::string(verify::differingField(a, b)) == "orderPrice");
+		b = a;
+		b.openInterest = 1;
+		REQUIRE(std::string(verify::differingField(a, b)) == "openInterest");
+	}
+
+	SECTION("A changed entry is located")
+	{
+		auto engines = verify::engines();
+		engines.resize(1);
+		engines.push_back(corrupting(12345, false));
+		auto report = verify::compare(SampleFile, engines, 1000);
+
+		REQUIRE(!report.ok());
+		REQUIRE(report.results[0].matches);
+		REQUIRE(!report.results[1].matches);
+		REQUIRE(report.divergences.size() == 1);
+		const auto& divergence = report.divergences[0];
+		REQUIRE(divergence.engine == "corrupt");
+		REQUIRE(divergence.frame == 12345);
+		REQUIRE(divergence.actual.volume == divergence.expected.volume + 1);
+		REQUIRE(divergence.field == "volume");
+		REQUIRE(divergence.offset == verify::frameOffsets(SampleFile, 12345, 1)[0]);
+		REQUIRE(divergence.offset > verify::frameOffsets(SampleFile, 12344, 1)[0]);
+		REQUIRE(report.toString().find("first divergent frame 12345") != std::string::npos);
+		REQUIRE(report.toString().find("field volume") != std::string::npos);
+	}
+
+	SECTION("A missing entry is located")
+	{
+		auto engines = verify::engines();
+		engines.resize(1);
+		engines.push_back(corrupting(159035, true));
+		auto report = verify::compare(SampleFile, engines);
+
+		REQUIRE(report.divergences.size() == 1);
+		const auto& divergence = report.divergences[0];
+		REQUIRE(divergence.frame == 159035);
+		REQUIRE(divergence.hasExpected);
+		REQUIRE(!divergence.hasActual);
+		REQUIRE(divergence.field.empty());
+		REQUIRE(report.results[1].frames == 159035);
+	}
+}
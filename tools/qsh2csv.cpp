@@ -0,0 +1,121 @@
+#include "qsh/csv.h"
+#include "qsh/qshfile.h"
+#include "qsh/readahead.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+using namespace qsh;
+
+static void usage()
+{
+	fprintf(stderr,
+			"usage: qsh2csv [-t] [-j threads] [-o directory] file...\n"
+			"\n"
+			"Converts each OrdLog file to file.csv (file.tsv with -t), next to\n"
+			"it or in 'directory'. Files are converted in parallel, by default\n"
+			"on every hardware thread.\n");
+}
+
+static std::string outputPath(const std::string& path, const std::string& directory, bool tsv)
+{
+	std::string name = path;
+	if(!directory.empty())
+	{
+		auto slash = path.rfind('/');
+		name = directory + "/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+	}
+	return name + (tsv ? ".tsv" : ".csv");
+}
+
+int main(int argc, char** argv)
+{
+	bool tsv = false;
+	unsigned threads = std::thread::hardware_concurrency();
+	std::string directory;
+	std::vector<std::string> paths;
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-t"))
+			tsv = true;
+		else if(!strcmp(argv[i], "-j") && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-o") && i + 1 < argc)
+			directory = argv[++i];
+		else if(argv[i][0] == '-')
+		{
+			usage();
+			return 2;
+		}
+		else
+			paths.push_back(argv[i]);
+	}
+	if(paths.empty())
+	{
+		usage();
+		return 2;
+	}
+	if(threads == 0)
+		threads = 1;
+	if(threads > paths.size())
+		threads = paths.size();
+
+	std::atomic<size_t> next(0);
+	std::atomic<uint64_t> bytes(0);
+	std::atomic<size_t> converted(0);
+	std::atomic<bool> failed(false);
+	std::mutex errors;
+	auto start = std::chrono::steady_clock::now();
+	auto worker = [&]()
+	{
+		std::vector<char> outputBuffer(1 << 20);
+		for(size_t i = next++; i < paths.size(); i = next++)
+		{
+			try
+			{
+				MmapStreambuf input(paths[i]);
+				std::istream stream(&input);
+				std::ofstream output;
+				output.rdbuf()->pubsetbuf(outputBuffer.data(), outputBuffer.size());
+				auto path = outputPath(paths[i], directory, tsv);
+				output.open(path, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+				if(!output.good())
+					throw std::runtime_error("Unable to open " + path);
+
+				CsvExporter exporter(output, tsv ? '\t' : ',');
+				QshFile<CsvExporter> file(stream, exporter);
+				file.readAllFrames();
+				exporter.flush();
+				// The last block is written, and may fail, only on close
+				output.close();
+				if(output.fail())
+					throw std::runtime_error("Unable to write " + path);
+				bytes += exporter.bytes();
+				converted++;
+			}
+			catch(const std::exception& e)
+			{
+				std::lock_guard<std::mutex> lock(errors);
+				fprintf(stderr, "qsh2csv: %s: %s\n", paths[i].c_str(), e.what());
+				failed = true;
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(unsigned i = 0; i < threads; i++)
+		workers.emplace_back(worker);
+	for(auto& thread : workers)
+		thread.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "%zu of %zu files, %.1f MB of text in %.3f s, %.1f MB/s\n", converted.load(), paths.size(),
+			bytes / 1e6, seconds, bytes / 1e6 / seconds);
+	return failed ? 1 : 0;
+}
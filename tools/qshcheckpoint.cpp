@@ -0,0 +1,71 @@
+#include "qsh/checkpoint.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace qsh;
+
+static void usage()
+{
+	fprintf(stderr,
+			"usage: qshcheckpoint [-i minutes] [-s stream] file...\n"
+			"\n"
+			"Writes book checkpoints of each file every 'minutes' (default 15)\n"
+			"of frame time into file.ckpt, then restores the last one and\n"
+			"reports how long that took.\n");
+}
+
+int main(int argc, char** argv)
+{
+	int64_t minutes = 15;
+	int stream = 0;
+	std::vector<std::string> paths;
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-i") && i + 1 < argc)
+			minutes = strtoll(argv[++i], nullptr, 10);
+		else if(!strcmp(argv[i], "-s") && i + 1 < argc)
+			stream = atoi(argv[++i]);
+		else if(argv[i][0] == '-')
+		{
+			usage();
+			return 2;
+		}
+		else
+			paths.push_back(argv[i]);
+	}
+	if(paths.empty() || minutes <= 0)
+	{
+		usage();
+		return 2;
+	}
+
+	try
+	{
+		for(const auto& path : paths)
+		{
+			auto sidecar = checkpoint::sidecarPath(path);
+			size_t count = buildCheckpoints(path, sidecar, minutes * 60 * 1000, stream);
+
+			auto start = std::chrono::steady_clock::now();
+			CheckpointFile checkpoints(sidecar);
+			std::ifstream input(path, std::ios_base::binary | std::ios_base::in);
+			checkpoint::BookFeeder feeder(stream);
+			QshFile<checkpoint::BookFeeder> file(input, feeder);
+			feeder.book.reset(new L3Book(file.streams()[stream].step));
+			checkpoints.restore(checkpoints.entries().back(), file, *feeder.book);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			printf("%s: %zu checkpoints, last at frame %lu with %zu orders, restored in %.3f ms\n", sidecar.c_str(),
+					count, (unsigned long)checkpoints.entries().back().frame, feeder.book->orders(), ms);
+		}
+		return 0;
+	}
+	catch(const std::exception& e)
+	{
+		fprintf(stderr, "qshcheckpoint: %s\n", e.what());
+		return 2;
+	}
+}
@@ -0,0 +1,79 @@
+#include "qsh/verify.h"
+#include "qsh/synthetic.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+using namespace qsh;
+
+static void usage()
+{
+	fprintf(stderr,
+			"usage: qshverify [-i interval] file...\n"
+			"       qshverify [-i interval] -g frames [-s streams] [-S seed] output\n"
+			"\n"
+			"Decodes each file with every engine and compares the results with\n"
+			"the reference decoder. With -g, first generates a synthetic OrdLog\n"
+			"file of about 'frames' frames into 'output'.\n"
+			"Exits with 1 if any engine diverges.\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t interval = 4096;
+	size_t generate = 0;
+	int streams = 4;
+	uint64_t seed = 1;
+	std::vector<std::string> paths;
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-i") && i + 1 < argc)
+			interval = strtoull(argv[++i], nullptr, 10);
+		else if(!strcmp(argv[i], "-g") && i + 1 < argc)
+			generate = strtoull(argv[++i], nullptr, 10);
+		else if(!strcmp(argv[i], "-s") && i + 1 < argc)
+			streams = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-S") && i + 1 < argc)
+			seed = strtoull(argv[++i], nullptr, 10);
+		else if(argv[i][0] == '-')
+		{
+			usage();
+			return 2;
+		}
+		else
+			paths.push_back(argv[i]);
+	}
+	if(paths.empty() || (generate > 0 && paths.size() != 1))
+	{
+		usage();
+		return 2;
+	}
+
+	try
+	{
+		if(generate > 0)
+		{
+			std::ofstream out(paths[0], std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+			testing::SyntheticOrdLog generator(seed, streams, false);
+			generator.write(out, generate);
+			if(!out.good())
+				throw std::runtime_error("Unable to write " + paths[0]);
+		}
+
+		bool ok = true;
+		for(const auto& path : paths)
+		{
+			auto report = verify::compare(path, interval);
+			printf("%s", report.toString().c_str());
+			ok = ok && report.ok();
+		}
+		return ok ? 0 : 1;
+	}
+	catch(const std::exception& e)
+	{
+		fprintf(stderr, "qshverify: %s\n", e.what());
+		return 2;
+	}
+}